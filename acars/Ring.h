@@ -0,0 +1,218 @@
+/* -*- c++ -*- */
+
+/*
+ * Copyright 2016 Dennis Glatting
+ *
+ *
+ * A bounded, lock-free, single-producer/single-consumer ring of
+ * pre-allocated slots.
+ *
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ *
+ */
+
+#ifndef __ACARS_RING_H__
+#define __ACARS_RING_H__
+
+#include <atomic>
+#include <cassert>
+#include <vector>
+
+extern "C" {
+
+#include <stddef.h>
+
+}
+
+
+namespace gr {
+  namespace acars {
+
+    // The slots are allocated once, when the ring is built, and are
+    // then reused forever. The producer asks for the next free slot,
+    // fills it in place, and publishes it with push(). The consumer
+    // asks for the oldest published slot, processes it in place, and
+    // returns it with pop(). Nothing is copied and nothing is locked;
+    // the only shared state is the pair of counters.
+    //
+    // Exactly one thread may call write_slot()/push() and exactly one
+    // (other) thread may call read_slot()/pop().
+
+    template<typename T>
+    class RingSPSC {
+
+    private:
+
+      // The slots and the mask used to turn a counter into an
+      // index. The number of slots is always a power of two.
+
+      std::vector<T> my_slots;
+      size_t         my_mask;
+
+      // Monotonic counters of slots written and slots read. Each is
+      // written by one side only and is kept on its own cache line
+      // so the two sides don't fight over it.
+
+      char                my_pad0[64];
+      std::atomic<size_t> my_head;
+      char                my_pad1[64 - sizeof( std::atomic<size_t> )];
+      std::atomic<size_t> my_tail;
+      char                my_pad2[64 - sizeof( std::atomic<size_t> )];
+
+      static size_t _round_up( size_t n ) noexcept;
+
+    public:
+
+      RingSPSC( size_t the_size );
+
+      RingSPSC( const RingSPSC& ) = delete;
+      RingSPSC& operator=( const RingSPSC& ) = delete;
+
+      // Producer side. write_slot() returns nullptr if the ring is
+      // full.
+
+      T*   write_slot( void ) noexcept;
+      void push( void ) noexcept;
+
+      // Consumer side. read_slot() returns nullptr if the ring is
+      // empty.
+
+      T*   read_slot( void ) noexcept;
+      void pop( void ) noexcept;
+
+      // Return things about the ring. These are snapshots and are
+      // only exact when called from one of the two sides.
+
+      size_t size( void ) const noexcept;
+      size_t capacity( void ) const noexcept;
+      bool   empty( void ) const noexcept;
+
+      // Direct access to a slot, for setting up the slots before
+      // either side starts running.
+
+      T& operator[]( size_t x ) noexcept;
+
+    };
+
+    template<typename T>
+    size_t
+    RingSPSC<T>::_round_up( size_t n ) noexcept {
+
+      size_t p = 1;
+
+      while( p < n )
+	p <<= 1;
+
+      return p;
+    }
+
+    template<typename T>
+    RingSPSC<T>::RingSPSC( size_t the_size )
+      : my_slots( _round_up( the_size )),
+	my_mask( _round_up( the_size ) - 1 ),
+	my_head( 0 ), my_tail( 0 ) {
+
+      assert( the_size );
+
+    }
+
+    template<typename T>
+    inline T*
+    RingSPSC<T>::write_slot( void ) noexcept {
+
+      const size_t head = my_head.load( std::memory_order_relaxed );
+
+      if(( head - my_tail.load( std::memory_order_acquire )) >
+	 my_mask )
+	return nullptr;
+
+      return &my_slots[ head & my_mask ];
+    }
+
+    template<typename T>
+    inline void
+    RingSPSC<T>::push( void ) noexcept {
+
+      my_head.store( my_head.load( std::memory_order_relaxed ) + 1,
+		     std::memory_order_release );
+
+    }
+
+    template<typename T>
+    inline T*
+    RingSPSC<T>::read_slot( void ) noexcept {
+
+      const size_t tail = my_tail.load( std::memory_order_relaxed );
+
+      if( tail == my_head.load( std::memory_order_acquire ))
+	return nullptr;
+
+      return &my_slots[ tail & my_mask ];
+    }
+
+    template<typename T>
+    inline void
+    RingSPSC<T>::pop( void ) noexcept {
+
+      my_tail.store( my_tail.load( std::memory_order_relaxed ) + 1,
+		     std::memory_order_release );
+
+    }
+
+    template<typename T>
+    inline size_t
+    RingSPSC<T>::size( void ) const noexcept {
+
+      // Read the tail first. The head never falls behind it so the
+      // difference cannot go negative.
+
+      const size_t tail = my_tail.load( std::memory_order_acquire );
+
+      return my_head.load( std::memory_order_acquire ) - tail;
+    }
+
+    template<typename T>
+    inline size_t
+    RingSPSC<T>::capacity( void ) const noexcept {
+
+      return my_mask + 1;
+    }
+
+    template<typename T>
+    inline bool
+    RingSPSC<T>::empty( void ) const noexcept {
+
+      return size() == 0;
+    }
+
+    template<typename T>
+    inline T&
+    RingSPSC<T>::operator[]( size_t x ) noexcept {
+
+      assert( x <= my_mask );
+
+      return my_slots[x];
+    }
+
+  }
+}
+
+
+#endif
+
+
+//  LocalWords:  SPSC
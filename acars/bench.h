@@ -0,0 +1,103 @@
+/* -*- c++ -*- */
+
+/*
+ * Copyright 2016 Dennis Glatting
+ *
+ *
+ * Built in benchmarks and equivalence checks.
+ *
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ *
+ */
+
+#ifndef __ACARS_BENCH_H__
+#define __ACARS_BENCH_H__
+
+#include <functional>
+#include <string>
+#include <vector>
+
+extern "C" {
+
+#include <stddef.h>
+#include <stdint.h>
+
+}
+
+#include <acars/message.h>
+
+
+namespace gr {
+  namespace acars {
+
+    // The program's receive chain, for the benchmarks that need it.
+    // decode() runs IQ (unsigned 8 bit pairs at rate, tuned as
+    // optimal_settings() tunes) through a front end and decoder of
+    // its own, as a replay would, and appends every message that
+    // passed its CRC to msgs; gated puts the squelch gate (-q) in
+    // front of the decoder, as the program does. envelope() runs
+    // only the front end and appends what the decoder would get, from
+    // the separate passes (rotate_90(), low_pass(), am_demod()) or
+    // from am_front_end(). taps are the polyphase FIR's per phase
+    // (-T). wideband() is decode() for IQ at wb_rate through a
+    // channelizer, as -W does it.
+
+    struct Receiver {
+
+      double rate;
+      int    taps;
+      std::function<void( const std::vector<uint8_t>& iq, bool gated,
+			  std::vector<msg_t>& msgs )> decode;
+      double wb_rate;
+      std::function<void( const std::vector<uint8_t>& iq, bool gated,
+			  std::vector<msg_t>& msgs )> wideband;
+      std::function<void( const std::vector<uint8_t>& iq, bool fused,
+			  std::vector<int16_t>& out )> envelope;
+
+    };
+
+    // Run the named benchmark and print what it found to stdout. A
+    // benchmark that also checks one implementation against another
+    // returns non-zero if they disagree; an unknown name lists the
+    // benchmarks and returns non-zero.
+
+    int run_bench( const std::string& name, int verbose,
+		   const Receiver& rx );
+
+    // Write a recording (cu8, at rate) of n_msgs random messages from
+    // the Modulator at snr_db, with random carrier offsets and clock
+    // errors. Returns false, with errno set, if it couldn't be
+    // written.
+
+    bool synth_recording( const char* path, double rate, double snr_db,
+			  int n_msgs, uint32_t seed );
+
+    // Synthesize n_bits of random ACARS MSK as the bit former sees
+    // it: the AM envelope at Fe, non-negative, with Gaussian noise
+    // at snr_db. The same seed makes the same signal.
+
+    std::vector<int16_t> synth_msk( size_t n_bits, double snr_db,
+				    uint32_t seed );
+
+  }
+}
+
+
+#endif
+
+
+//  LocalWords:  MSK
@@ -0,0 +1,161 @@
+/* -*- c++ -*- */
+
+/*
+ * Copyright 2016 Dennis Glatting
+ *
+ *
+ * A fast convolution (FFT) channelizer: one wideband IQ stream in,
+ * the AM envelope of several narrow channels out.
+ *
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ *
+ */
+
+#ifndef __ACARS_CHANNELIZER_H__
+#define __ACARS_CHANNELIZER_H__
+
+#include <vector>
+
+extern "C" {
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <fftw3.h>
+
+}
+
+#include <acars/Buffer.h>
+
+
+namespace gr {
+  namespace acars {
+
+    // The channelizer works by overlap-save. Each step takes the
+    // newest N/2 input samples plus the N/2 before them, where N is
+    // the decimation times the output FFT length, and does one N
+    // point forward FFT. For each channel it then picks out the
+    // ifft_len bins around the channel's centre, weights them with
+    // the channel filter, and does one small inverse FFT. The inverse
+    // FFT is already at the output rate (the decimation is free) and
+    // the second half of it is N/2 samples' worth of clean output.
+    //
+    // Only the envelope is kept, so the bin rounding of a channel's
+    // centre and the block to block phase steps don't matter.
+    //
+    // The cost per input sample is one share of the big FFT, which is
+    // paid once no matter how many channels there are, plus a small
+    // amount per channel.
+
+    class Channelizer {
+
+    private:
+
+      const size_t my_decimation;
+      const size_t my_ifft_len;
+      const size_t my_fft_len;
+      const size_t my_hop;
+
+      // The input history (the time domain side of the big FFT), how
+      // much of it is filled, and the spectrum it turns into.
+
+      BufferFFT my_in;
+      size_t    my_fill;
+      BufferFFT my_spectrum;
+
+      // Each channel's first bin and the channel filter, already in
+      // the order the inverse FFT wants.
+
+      std::vector<size_t> my_bins;
+      BufferFFT           my_filter;
+
+      // The inverse FFT's workspace.
+
+      BufferFFT my_narrow;
+
+      fftw_plan my_forward;
+      fftw_plan my_inverse;
+
+      // Output, one buffer per channel, all the same length.
+
+      std::vector<Buffer<int16_t>> my_out;
+      size_t                       my_out_len;
+
+      double my_scale;
+
+      void _design_filter( double the_rate, double the_cutoff );
+      void _step( void );
+
+    public:
+
+      // the_rate is the input sample rate, the_offsets are the
+      // channels' centres relative to the tuned frequency (Hz), and
+      // the_max_block is the most bytes that will be handed to push()
+      // at once. The output rate is the_rate / the_decimation.
+
+      Channelizer( double the_rate, size_t the_decimation,
+		   const std::vector<double>& the_offsets,
+		   size_t the_max_block,
+		   size_t the_ifft_len = 64,
+		   double the_cutoff   = 12000.0 );
+
+      ~Channelizer( void );
+
+      Channelizer( const Channelizer& ) = delete;
+      Channelizer& operator=( const Channelizer& ) = delete;
+
+      // Channelize a block of interleaved unsigned 8 bit IQ, as it
+      // comes from the dongle. The previous block's output is
+      // replaced.
+
+      void push( const uint8_t* iq, size_t len );
+
+      // Return things about the channelizer and the output of the
+      // last push().
+
+      size_t         channels( void ) const noexcept;
+      size_t         output_len( void ) const noexcept;
+      const int16_t* output( size_t ch ) const noexcept;
+
+    };
+
+    inline size_t
+    Channelizer::channels( void ) const noexcept {
+
+      return my_bins.size();
+    }
+
+    inline size_t
+    Channelizer::output_len( void ) const noexcept {
+
+      return my_out_len;
+    }
+
+    inline const int16_t*
+    Channelizer::output( size_t ch ) const noexcept {
+
+      return my_out[ch].get();
+    }
+
+  }
+}
+
+
+#endif
+
+
+//  LocalWords:  IQ FFT
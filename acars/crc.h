@@ -49,14 +49,18 @@
 #ifndef __ACARS_CRC_H__
 #define __ACARS_CRC_H__
 
+#include <array>
 #include <vector>
 
 extern "C" {
 
+#include <stddef.h>
 #include <stdint.h>
 
 }
 
+#include <acars/utility.h>
+
 
 uint16_t
 gen_crc( std::vector<uint8_t>::const_iterator s,
@@ -65,8 +69,116 @@ gen_crc( std::vector<uint8_t>::const_iterator s,
 bool
 check_crc( std::vector<uint8_t>::const_iterator s,
 	   std::vector<uint8_t>::const_iterator e );
+
+// Reflecting every byte going in and the register coming out, as
+// gen_crc() does, is the same as running the register least
+// significant bit first with the polynomial reflected (0x8408), so
+// that is how the faster engines and crc_fold() run it and they need
+// no reverse_bits[] at all.
+//
+// Entry c of that table for c under 256 and, past that, of the
+// tables for c folded with c / 256 zero bytes after it.
+
+template<uint16_t poly>
+constexpr uint16_t
+_crc_entry_rev( size_t c ) {
+
+  uint16_t crc = uint16_t( c & 0xff );
+
+  for( size_t k = 0; k <= c / 256; ++k ) {
+
+    if( k )
+      crc = uint16_t(( crc >> 8 ) ^ _crc_entry_rev<poly>( crc & 0xff ));
+    else
+      for( int b = 0; b < 8; ++b )
+	crc = ( crc & 1 ) ? uint16_t(( crc >> 1 ) ^ poly ) : uint16_t( crc >> 1 );
+  }
+
+  return crc;
+}
+
+constexpr std::array<uint16_t, 256> crc_ccitt_rev =
+  make_table<uint16_t, 256, _crc_entry_rev<0x8408>>();
+
+// Fold one byte into crc, as gen_crc() returns it (zero to start), for
+// a CRC kept up as the bytes come in. Folding a message's own CRC
+// bytes in after it leaves zero.
+
+constexpr uint16_t
+crc_fold( uint16_t crc, uint8_t c ) {
+
+  return uint16_t(( crc >> 8 ) ^ crc_ccitt_rev[( crc ^ c ) & 0xff ]);
+}
+
+// The ways gen_crc() can compute the CRC, all giving the same
+// answer: a byte at a time through one table (as it always did),
+// eight bytes at a time through eight tables (slice-by-8), and
+// folding sixteen bytes at a time with carry-less multiplies
+// (PCLMULQDQ on x86-64, PMULL on ARMv8), which only some CPUs have.
+
+enum class CrcEngine { TABLE, SLICE8, CLMUL };
+
+// Whether this CPU (and build) has the engine. TABLE and SLICE8
+// always are.
+
+bool
+crc_engine_supported( CrcEngine the_engine );
+
+// Make gen_crc() use the engine from now on; false, and nothing
+// changes, if it isn't supported. It starts out with the fastest one
+// there is. Set it before the decoders run, not while they do.
+
+bool
+crc_engine( CrcEngine the_engine );
+
+CrcEngine
+crc_engine( void );
+
+const char*
+crc_engine_name( CrcEngine the_engine );
+
+// Fold n bytes into crc, as gen_crc() returns it (zero to start),
+// with the given engine, which has to be supported.
+
+uint16_t
+crc_update( CrcEngine the_engine, uint16_t crc, const uint8_t* p, size_t n );
+
+// The CRC is linear and starts from zero, so the CRC of a damaged
+// message (its syndrome) is the CRC of the error pattern alone and
+// depends only on how far each flipped bit is from the end, not on
+// the message or its length. A bit's distance is eight times the
+// number of bytes after its byte plus the bit's number within the
+// byte (bit j is 1 << j).
+//
+// Single bit errors up to this far from the end can be located. The
+// polynomial's period is 32767 bits, so all of their syndromes are
+// different.
+
+#define CRC_SYNDROME_BITS ( 8 * 512 )
+
+// The syndrome of a single bit error the given distance from the end.
+
+uint16_t
+crc_syndrome( size_t distance );
+
+// The distance from the end of the single bit error that gives the
+// syndrome, or -1 if no single bit error within CRC_SYNDROME_BITS
+// does.
+
+int
+crc_locate( uint16_t syndrome );
+
+// The message in raw (n bytes, SOH through the CRC) failed its CRC
+// with the given syndrome. Correct up to max_bits (0, 1, or 2) bit
+// errors in place and return how many were corrected, or -1 if it
+// couldn't be. The SOH isn't touched and a correction is only taken
+// if it leaves every character between the SOH and the CRC with odd
+// parity.
+
+int
+crc_correct( uint8_t* raw, size_t n, uint16_t syndrome, int max_bits );
   
 #endif
 
 
-//  LocalWords:  CRC
+//  LocalWords:  CRC PCLMULQDQ PMULL ARMv
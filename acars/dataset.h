@@ -0,0 +1,219 @@
+/* -*- c++ -*- */
+
+/*
+ * Copyright 2016 Dennis Glatting
+ *
+ *
+ * The aircraft, airport, flight, and message label datasets and their
+ * indexes.
+ *
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ *
+ */
+
+#ifndef __ACARS_DATASET_H__
+#define __ACARS_DATASET_H__
+
+#include <string>
+#include <vector>
+
+extern "C" {
+
+#include <stddef.h>
+#include <stdint.h>
+
+}
+
+
+namespace gr {
+  namespace acars {
+
+    // The longest flight number prefix a route can be looked up by.
+
+#define DATASET_NUMBER_MAX 5
+
+    struct acars_flight {
+      const char* flightid;
+      const char* from;
+      const char* to;
+      const char* airline;
+    };
+
+    struct acars_aircraft {
+      const char* registration;
+      const char* modes;
+      const char* manufacturer;
+      const char* model;
+    };
+
+    struct acars_airport {
+      const char* name;
+      const char* city;
+      const char* country;
+      const char* code;
+    };
+
+    struct acars_ml {
+      const char* ml_code;
+      const char* ml_label;
+    };
+
+    // The datasets and hash indexes over them, so looking something
+    // up for a message is a probe or two rather than a scan of the
+    // whole table. Every lookup answers what a scan in file order
+    // would: where several entries match, the first in the file wins.
+    //
+    // Everything (the rows, a string pool, and the indexes) lives in
+    // one flat image of offsets, no pointers. Loading the tab
+    // separated files builds the image in memory and save() writes it
+    // out; map() maps a saved image read only, which takes next to no
+    // time and shares its pages between every process that maps it.
+    //
+    // Lookups return a row's index, -1 for none, and the *_at()
+    // functions turn an index into the row. A dataset being loaded
+    // isn't safe to read from another thread.
+
+    class Dataset {
+
+    public:
+
+      Dataset( void );
+      ~Dataset( void );
+
+      Dataset( const Dataset& ) = delete;
+      Dataset& operator=( const Dataset& ) = delete;
+
+      // Load aircrafts.txt, airports.txt, flightroute2.txt, and
+      // acars_mls.txt from dir and print how many entries each had.
+      // A file that can't be opened leaves its table empty and warns.
+
+      void load_text( const std::string& dir );
+
+      // Write the image to path, or map the image at path in place of
+      // whatever was loaded. Both return false on failure, with errno
+      // set; a failed map() leaves the dataset as it was and sets
+      // errno to EINVAL if the file isn't an image this build can
+      // read.
+
+      bool save( const char* path ) const;
+      bool map( const char* path );
+
+      // True if there's no image at path or a text file in dir has
+      // changed since it was saved.
+
+      static bool newer_text( const char* image, const std::string& dir );
+
+      // The first aircraft whose registration starts with reg (which
+      // isn't empty). A reg that is a whole registration, the usual
+      // case, is one probe. Otherwise it is a binary search of the
+      // sorted registrations and a walk over those it starts.
+
+      long aircraft( const char* reg ) const;
+
+      // The airports with the given code, in file order: the first,
+      // then each one after.
+
+      long airport( const char* code ) const;
+      long next_airport( long i ) const;
+
+      // The same for message labels.
+
+      long label( const char* code ) const;
+      long next_label( long i ) const;
+
+      // The first flight whose ID starts with the airline's two
+      // characters (fid's first two).
+
+      long airline( const char* fid ) const;
+
+      // A leg of a route: the first flight (in file order) that
+      // matches and whose airport is known, and the airport. Both are
+      // -1 if none is.
+
+      struct leg_s {
+	long flight;
+	long airport;
+      };
+
+      // Flights match when the first two characters of their ID are
+      // the airline's (fid's first two) and the ID from its fourth
+      // character on starts with number, which is one to
+      // DATASET_NUMBER_MAX characters. Each is one probe.
+
+      leg_s departure( const char* fid, const char* number ) const;
+      leg_s arrival(   const char* fid, const char* number ) const;
+
+      acars_aircraft aircraft_at( long i ) const;
+      acars_airport  airport_at(  long i ) const;
+      acars_flight   flight_at(   long i ) const;
+      acars_ml       label_at(    long i ) const;
+
+      // The number of rows in each table.
+
+      size_t aircrafts( void ) const;
+      size_t airports( void ) const;
+      size_t flights( void ) const;
+      size_t labels( void ) const;
+
+    private:
+
+      // The image's layout, in dataset.cc.
+
+      struct header_s;
+      struct section_s;
+      struct row_s;
+      struct sslot_s;
+      struct kslot_s;
+      struct staging_s;
+
+      // The image: built in memory (8 byte aligned) or mapped.
+
+      std::vector<uint64_t> my_own;
+      void*                 my_map;
+      size_t                my_map_size;
+
+      const char*     my_base;
+      size_t          my_size;
+      const header_s* my_hdr;
+
+      long _load( const std::string& path, int table, int n_fields,
+		  staging_s& st );
+      void _build( const staging_s& st );
+      bool _attach( const char* base, size_t size );
+      void _unmap( void );
+
+      template< typename T >
+      const T* _at( const section_s& s ) const;
+
+      const char*    _str( uint32_t off ) const;
+      const row_s*   _row( int table, long i ) const;
+      long           _find( const section_s& s, const char* key ) const;
+      const kslot_s* _find( const section_s& s, uint64_t key ) const;
+      long           _next( const section_s& s, long i ) const;
+      leg_s          _leg( const char* fid, const char* number,
+			   bool from ) const;
+
+    };
+
+  }
+}
+
+
+#endif
+
+
+//  LocalWords:  ID IDs
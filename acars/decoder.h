@@ -0,0 +1,402 @@
+/* -*- c++ -*- */
+
+/*
+ * Copyright 2016 Dennis Glatting
+ *
+ *
+ * The ACARS bit and message decoder: audio samples in, messages out.
+ *
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ *
+ */
+
+#ifndef __ACARS_DECODER_H__
+#define __ACARS_DECODER_H__
+
+#include <atomic>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <vector>
+
+extern "C" {
+
+#include <stddef.h>
+#include <stdint.h>
+
+}
+
+#include <acars/Buffer.h>
+#include <acars/message.h>
+
+
+namespace gr {
+  namespace acars {
+
+    // Constants.
+
+    static constexpr double halfPI = ( M_PI / 2.0 );
+    static constexpr double twoPI  = ( M_PI * 2.0 );
+    static constexpr double fourPI = ( M_PI * 4.0 );
+
+    // After down sampling (i.e., applying a low pass filter and
+    // decimating), the sample rate into the bit former is 48k/bps.
+
+#define Fe       48000.0
+#define Freqh    (4800.0/Fe*twoPI)
+#define Freql    (2400.0/Fe*twoPI)
+#define BITLEN   int(Fe/1200.0)
+
+    /* ACARS defines */
+
+#define VFOPLL 0.7e-3
+#define BITPLL 0.2
+
+    // The block bit former works in chunks of up to this many
+    // samples. The VFOs' PLL correction is updated once per chunk,
+    // and held much longer than half a bit the loop no longer
+    // tracks; a full bit loses a quarter of the messages.
+
+#define DEMOD_CHUNK ( BITLEN / 2 )
+
+    // Message state machine state.
+
+    enum class STATE {
+      HEADL, HEADF,    // Header (PRE-KEY) lost, Header found. The
+		       // transition from lost to found is at least eight
+		       // bits are found to be a logical 1. When "found,"
+		       // the state machine will consume PRE-KEY bits
+		       // until at least two bits in eight are not a
+		       // logical 1, at which time the state machine
+		       // starts to look for BIT-SYNC. If there are more
+		       // that two bits that are not a logical one then
+		       // the state machine transitions back to lost.
+      SYNC,            // Looking for the bit pattern matching the
+		       // BIT-SYNC, CHAR-SYNC, and SOH.
+      TXT,             // Collecting the text segment of a message by
+		       // passing the SOH1 state and terminated by a ETX
+		       // or ETB (or buffer overflow).
+      CRC1, CRC2,      // Looking for the first and second CRC byte.
+      END              // Process the message, if any.
+    };
+    std::ostream& operator<<( std::ostream&, const STATE& ) ;
+
+    // What the bit clock reads when it ticks: which integrator (the Q
+    // at a minimum of the clock filter, the I at a maximum) and its
+    // sign. A bit is the sign times the integrator's polarity, which
+    // is its sign at the first bit since the message state machine
+    // last reset it, so a symbol can be turned into a bit later, by
+    // whoever runs the message state machine.
+
+#define SYM_POS 0x01
+#define SYM_NEG 0x02
+#define SYM_I   0x04
+
+    // Where the block bit former puts the bits it forms, one call per
+    // bit, as it forms them. A bit is 0 or 1.
+
+    class BitSink {
+
+    public:
+
+      virtual ~BitSink( void ) {};
+
+      virtual void bit( uint8_t b ) = 0;
+
+    };
+
+    // One ACARS decoder. Everything the bit former and the message
+    // state machine remember between samples lives in the object, so
+    // any number of decoders can run in one process (e.g., one per
+    // channel), each fed by its own stream of audio samples.
+
+    class AcarsDecoder {
+
+    public:
+
+      // Called once for each message that passes (or was corrected
+      // to pass) the CRC.
+
+      typedef std::function<void( msg_t& )> MessageCallback;
+
+      // Where the VFOs get their sines and cosines: the C library,
+      // as the decoder always did, or a phase accumulator and a
+      // lookup table (the default), which is much cheaper and forms
+      // the same bits.
+
+      enum class Oscillator { LIBM, LUT };
+
+      AcarsDecoder( MessageCallback the_callback, int the_verbose = 0 );
+
+      // Feed the decoder n demodulated (AM) samples at Fe. Decoded
+      // messages are handed to the callback before push() returns.
+
+      void push( const int16_t* samples, size_t n );
+
+      // Split the decoder in two, so the bit former and the message
+      // state machine can run on different threads. While symbols
+      // isn't nullptr push() only runs the bit former and appends a
+      // symbol (SYM_*) to symbols for each bit it forms; frame() runs
+      // the message state machine over them, in the order they were
+      // formed. The halves share nothing, so one thread may push()
+      // while another frame()s. Handing each push()'s symbols to one
+      // frame() decodes what push() alone would.
+
+      void split( std::vector<uint8_t>* the_symbols ) noexcept;
+      void frame( const uint8_t* symbols, size_t n );
+
+      // Run only the bit former over n samples and hand each bit it
+      // forms to the sink. Messages aren't looked for.
+      //
+      // The normalization, the VFOs, and the mixer products are done
+      // a chunk at a time with VOLK and only the bit clock runs a
+      // sample at a time. This is what push() uses.
+
+      void demod_block( const int16_t* samples, size_t n, BitSink& sink );
+
+      // The same, a sample at a time, appending each bit to bits.
+      // This is the reference the block version is checked against.
+      // Don't use both on one decoder without a reset() between.
+
+      void demod( const int16_t* samples, size_t n,
+		  std::vector<uint8_t>& bits );
+
+      // Select the VFOs' oscillator. Takes effect on the next sample.
+
+      void oscillator( Oscillator the_osc ) noexcept;
+
+      // Correct up to the_bits (0, 1, or 2) bit errors in a message
+      // that fails its CRC. The default is 1. A corrected message's
+      // crc is the number of bits corrected.
+
+      void crc_correct( int the_bits ) noexcept;
+
+      // Forget everything, as though the decoder were new, except
+      // the number of messages decoded.
+
+      void reset( void );
+
+      // The number of messages decoded so far.
+
+      long messages( void ) const noexcept;
+
+      // True from when the message state machine has seen enough of a
+      // PRE-KEY until it's done with the message (or given up on it).
+      // It may be asked from another thread than frame()'s, and then
+      // it's as of the last symbols framed.
+
+      bool in_message( void ) const noexcept;
+
+      // Dump the bit former's registers to stderr. Useful when
+      // debugging.
+
+      void dump_bit_state_machine( void ) const;
+
+    private:
+
+      // Bit state machine.
+
+      struct bstat_s {
+
+	BufferVOLK<float>
+	  hsample = BufferVOLK<float>( BITLEN ),
+	  lsample = BufferVOLK<float>( BITLEN ),
+	  isample = BufferVOLK<float>( BITLEN ),
+	  qsample = BufferVOLK<float>( BITLEN ),
+	  csample = BufferVOLK<float>( 2 * BITLEN );   // Doubled ring.
+
+	// Running sums of the newest BITLEN/2 h and l samples (the VFO
+	// phase detectors) and the newest BITLEN i and q samples (the
+	// integrators). Double so the updates don't lose much between
+	// resyncs.
+
+	double hsum, lsum, isum, qsum;
+
+	// The block bit former's history. Each holds the previous
+	// BITLEN samples, oldest first, followed by the chunk being
+	// worked on, so every window is a straight run.
+
+	BufferVOLK<float>
+	  hlin = BufferVOLK<float>( BITLEN + DEMOD_CHUNK ),
+	  llin = BufferVOLK<float>( BITLEN + DEMOD_CHUNK ),
+	  ilin = BufferVOLK<float>( BITLEN + DEMOD_CHUNK ),
+	  qlin = BufferVOLK<float>( BITLEN + DEMOD_CHUNK ),
+	  clin = BufferVOLK<float>( BITLEN + DEMOD_CHUNK );
+
+	// And its per chunk scratch: the samples, their levels, the
+	// normalized samples and their squares, and the VFOs' cosines
+	// (half phase) and sines.
+
+	BufferVOLK<float>
+	  x    = BufferVOLK<float>( DEMOD_CHUNK ),
+	  lv   = BufferVOLK<float>( DEMOD_CHUNK ),
+	  s    = BufferVOLK<float>( DEMOD_CHUNK ),
+	  s2   = BufferVOLK<float>( DEMOD_CHUNK ),
+	  osch = BufferVOLK<float>( DEMOD_CHUNK ),
+	  snh  = BufferVOLK<float>( DEMOD_CHUNK ),
+	  oscl = BufferVOLK<float>( DEMOD_CHUNK ),
+	  snl  = BufferVOLK<float>( DEMOD_CHUNK ),
+	  tmp  = BufferVOLK<float>( DEMOD_CHUNK );
+
+	int is;
+	int clock;
+	float lin;
+	float phih,phil;
+	uint32_t uphih, uphil;  // The same phases for Oscillator::LUT,
+				// where 2^32 is 4 pi.
+	float dfh,dfl;
+	float pC,ppC;
+	int sgI, sgQ;           // The polarities. These belong to the
+				// message state machine's side.
+	float ea;
+
+      } bstat;
+
+      // Message state machine state.
+
+      struct m_state_s {
+
+	// The state machine's state.
+
+	STATE state;
+
+	// After PRE-KEY characters have been found then the search is
+	// on for the SYNC words and SOH. We collect those bits and at
+	// a certain point (i.e., when enough bits has been collected
+	// for the words) the check is on to declare sync.
+	//
+	// There has to be a permissible number of errors in the words
+	// and there has to be a stopping point to declare no-SYNC.
+
+	uint64_t syncForming;
+	int      syncBitsHave;
+
+	const int errLim = 3;
+	const int syncBitsLim = ( 40 + 15 ); // 5 words * 8 bits plus extra.
+
+	// The number of consecutive PRE-KEY bits I have seen and the
+	// number I want to see before advancing the state machine.
+	//
+	//  (10ms represents 24 bits of PRE-KEY. PRE_KEY is 208 bits,
+	//   which is 86ms.)
+
+	      int consecutivePreKey;
+	const int consecutivePreKeyLim = ( 0.010 * 2400 ); /* 10ms */
+
+	// The raw message bytes with parity and framing bytes, the SOH
+	// through the CRC, and the CRC of them so far, kept up as each
+	// one comes in. Once the message's own CRC is in, that's the
+	// syndrome.
+
+	uint8_t  rawText[ MAX_MBLOCK_BYTES ];
+	size_t   rawLen;
+	uint16_t rawCrc;
+
+	// This was previously used for CRC but doubled as a flag. Now
+	// it is a flag where non-zero indicates uncorrected CRC
+	// errors.
+
+	uint16_t crc;
+
+      } m_state;
+
+      // The clock filter, and the same reversed for the block bit
+      // former, whose history runs oldest first.
+
+      BufferVOLK<float> h  = BufferVOLK<float>( BITLEN );
+      BufferVOLK<float> hr = BufferVOLK<float>( BITLEN );
+
+      // The sample at a time bit former's register.
+
+      uint8_t rl;
+
+      // The bits formed but not yet consumed by the message state
+      // machine, the oldest in bit 0, and how many there are.
+
+      uint64_t fbits;
+      int      nfbits;
+
+      // The number of messages decoded.
+
+      long rx_idx;
+
+      // Where push() puts the symbols when the decoder is split.
+
+      std::vector<uint8_t>* my_symbols;
+      std::atomic<bool>     my_in_message;
+
+      MessageCallback my_callback;
+      int             my_verbose;
+      Oscillator      my_osc;
+      int             my_correct;
+
+      void _init_bits( void );
+      void _reset_message_state_machine( void );
+      void _reset_bit_state_machine( void );
+      void _dump_sync( const uint64_t, const uint64_t ) const;
+      void _save( const uint8_t c ) noexcept;
+
+      bool _getbit( const float sample, uint8_t& outbits );
+      bool _bit_clock( const float C, uint8_t& sym ) noexcept;
+      uint8_t _polarize( const uint8_t sym ) noexcept;
+      void _vfo_chunk( size_t n );
+      template<typename F> void _form( const int16_t* sample, size_t n,
+				       F emit );
+      void _take_bit( const uint8_t b );
+      int  _getmesg( const uint64_t w, const int n, msg_t* msg ) noexcept;
+      void _frame( void );
+
+    };
+
+    inline long
+    AcarsDecoder::messages( void ) const noexcept {
+
+      return rx_idx;
+    }
+
+    inline bool
+    AcarsDecoder::in_message( void ) const noexcept {
+
+      return my_in_message.load( std::memory_order_relaxed );
+    }
+
+    inline void
+    AcarsDecoder::oscillator( Oscillator the_osc ) noexcept {
+
+      my_osc = the_osc;
+    }
+
+    inline void
+    AcarsDecoder::crc_correct( int the_bits ) noexcept {
+
+      my_correct = the_bits;
+    }
+
+    inline void
+    AcarsDecoder::split( std::vector<uint8_t>* the_symbols ) noexcept {
+
+      my_symbols = the_symbols;
+    }
+
+  }
+}
+
+
+#endif
+
+
+//  LocalWords:  ACARS PRE SOH ETX ETB CRC
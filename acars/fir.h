@@ -0,0 +1,128 @@
+/* -*- c++ -*- */
+
+/*
+ * Copyright 2016 Dennis Glatting
+ *
+ *
+ * A polyphase decimating FIR for the narrowband front end.
+ *
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ *
+ */
+
+#ifndef __ACARS_FIR_H__
+#define __ACARS_FIR_H__
+
+#include <vector>
+
+extern "C" {
+
+#include <stddef.h>
+#include <stdint.h>
+
+}
+
+
+namespace gr {
+  namespace acars {
+
+    // The defaults: taps per phase (the filter is this many times the
+    // decimation long) and the cutoff (Hz, where the response is down
+    // 6 dB). An ACARS channel is the carrier plus and minus 2400 Hz
+    // and its harmonics, give or take a couple of kHz of carrier
+    // offset, and the next channel is 25 kHz away.
+
+#define FIR_TAPS   24
+#define FIR_CUTOFF 12000.0
+
+    // The input pairs that are filtered at a time.
+
+#define FIR_CHUNK  4096
+
+    // A low pass FIR that decimates as it goes, computing only the
+    // outputs that are kept: each is the sum of the decimation's
+    // phases of the filter, taps per phase long each, over the
+    // samples since the last output and the ones before. The taps are
+    // a Blackman windowed sinc, designed when it's built, scaled so
+    // the gain at DC is the decimation (as low_pass()'s sums are) and
+    // held as Q14 int16_t.
+    //
+    // The dot products are 16 bit multiplies into 32 bit sums, eight
+    // at a time with SSE2 or NEON where the compiler has them.
+
+    class Decimator {
+
+    public:
+
+      // rate is the input rate (Hz).
+
+      Decimator( int the_decimation, int the_taps, double the_rate,
+		 double the_cutoff = FIR_CUTOFF );
+
+      // Filter len bytes of IQ (unsigned 8 bit pairs, turned so the
+      // channel is at DC, as rotate_90() leaves them) and write the
+      // outputs to out as int I and Q pairs. The filter's history
+      // carries from one call to the next. Returns the number of
+      // pairs written.
+
+      size_t push( const uint8_t* iq, size_t len, int* out );
+
+      // The response at hz from DC (dB, relative to DC) of the taps as
+      // they're used, rounding and all.
+
+      double response( double the_hz ) const;
+
+      int    decimation( void ) const noexcept;
+      size_t taps( void ) const noexcept;
+
+    private:
+
+      int    my_decimation;
+      double my_rate;
+      size_t my_n;        // Taps, padded to a multiple of 8.
+      int    my_phase;    // Samples since the last output.
+
+      std::vector<int16_t> my_h;    // Oldest sample's tap first.
+
+      // The last my_n - 1 samples followed by the chunk being
+      // filtered.
+
+      std::vector<int16_t> my_r;
+      std::vector<int16_t> my_j;
+
+    };
+
+    inline int
+    Decimator::decimation( void ) const noexcept {
+
+      return my_decimation;
+    }
+
+    inline size_t
+    Decimator::taps( void ) const noexcept {
+
+      return my_n;
+    }
+
+  }
+}
+
+
+#endif
+
+
+//  LocalWords:  FIR Blackman sinc IQ NEON SSE
@@ -0,0 +1,77 @@
+/* -*- c++ -*- */
+
+/*
+ * Copyright 2016 Dennis Glatting
+ *
+ *
+ * The narrowband front end in one pass: IQ bytes in, the AM envelope
+ * at Fe out.
+ *
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ *
+ */
+
+#ifndef __ACARS_FRONTEND_H__
+#define __ACARS_FRONTEND_H__
+
+extern "C" {
+
+#include <stddef.h>
+#include <stdint.h>
+
+}
+
+
+namespace gr {
+  namespace acars {
+
+    // The IQ pairs the front end turns over at a time. Their 16 bit
+    // rotated samples (16 KB) stay in L1.
+
+#define FRONT_END_CHUNK 4096
+
+    // What rotate_90(), low_pass(), and am_demod() do, in one pass
+    // over buf and without their int array: turn the IQ by a quarter
+    // of the rate, sum each downsample pairs (every second sum scaled
+    // by 5/8, counting from the start of buf, as low_pass() does),
+    // and write the magnitude of each sum, times scale and 8, to out.
+    //
+    // len is in bytes and a multiple of 8. The partial sum and how
+    // many pairs are in it carry from one call to the next in now_r,
+    // now_j, and prev_index, so a sum can straddle two buffers. buf
+    // isn't changed. Returns the number of samples written.
+    //
+    // The answers are the same as the three passes' except where
+    // am_demod() overflows int16_t and wraps, often to something
+    // negative: here they saturate at INT16_MAX.
+    //
+    // The turn is done 16 bytes at a time with SSE2 or NEON, where
+    // the compiler has them.
+
+    size_t am_front_end( const uint8_t* buf, size_t len,
+			 int downsample, int scale,
+			 int& now_r, int& now_j, int& prev_index,
+			 int16_t* out ) noexcept;
+
+  }
+}
+
+
+#endif
+
+
+//  LocalWords:  IQ NEON SSE
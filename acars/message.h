@@ -162,6 +162,23 @@ namespace gr {
 #define BIT_SYNC_2   uint8_t('*')
 #define CHAR_SYNC_1  uint8_t(SYN)
 #define CHAR_SYNC_2  uint8_t(SYN)
+
+    // A decoded message, with the framing, parity, and CRC stripped
+    // and each field NUL terminated.
+
+    typedef struct {
+      unsigned char mode;
+      unsigned char addr[8];
+      unsigned char ack;
+      unsigned char label[3];
+      unsigned char bid;
+      unsigned char no[5];
+      unsigned char fid[7];
+      char txt[256];
+      int crc;
+      long rx_idx;        // The message's sequence number from its decoder.
+      uint32_t freq;      // The channel it was heard on (Hz), 0 if unknown.
+    } msg_t;
     
   } // namespace acars
 } // namespace gr
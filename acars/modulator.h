@@ -0,0 +1,130 @@
+/* -*- c++ -*- */
+
+/*
+ * Copyright 2016 Dennis Glatting
+ *
+ *
+ * A synthetic ACARS transmitter, for testing the receiver.
+ *
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ *
+ */
+
+#ifndef __ACARS_MODULATOR_H__
+#define __ACARS_MODULATOR_H__
+
+#include <random>
+#include <vector>
+
+extern "C" {
+
+#include <stddef.h>
+#include <stdint.h>
+
+}
+
+#include <acars/Buffer.h>
+#include <acars/message.h>
+
+
+namespace gr {
+  namespace acars {
+
+    // The pre-key the modulator sends. Appendix B of 618-7 defines
+    // it as 16 bytes; see message.h for the longest that's searched
+    // for.
+
+#define MOD_PREKEY_BYTES 16
+
+    // Makes ACARS transmissions as the dongle would hear them: the
+    // MSK, built from the sin.cc half wave templates, amplitude
+    // modulates a carrier, which is offset from the channel, gets
+    // Gaussian noise, and is sampled as unsigned 8 bit IQ pairs with
+    // the tuner a quarter of the capture rate above the channel (as
+    // optimal_settings() tunes it). Calls append to a stream, which
+    // stays continuous from one call to the next.
+
+    class Modulator {
+
+    public:
+
+      // rate is the capture rate (IQ pairs per second). The same seed
+      // makes the same noise.
+
+      Modulator( double the_rate, uint32_t the_seed = 1 );
+
+      // The carrier to noise ratio (dB), with the noise measured in
+      // Fe, what's left after the front end decimates. The default is
+      // 30.
+
+      void snr( double the_db );
+
+      // The carrier's offset from the channel (Hz) and the error of
+      // the transmitter's bit clock (parts per million, positive is
+      // fast). Both default to 0.
+
+      void offset( double the_hz ) noexcept;
+      void drift( double the_ppm ) noexcept;
+
+      // Append one transmission of msg, or seconds of noise alone.
+
+      void burst( const msg_t& msg, std::vector<uint8_t>& iq );
+      void silence( double seconds, std::vector<uint8_t>& iq );
+
+      // The characters that are sent for msg: the pre-key, the syncs,
+      // the SOH, the fields with odd parity, the ETX, the CRC, and the
+      // DEL. The fields are the widths the decoder's build_mesg()
+      // expects and the text ends at its NUL.
+
+      static std::vector<uint8_t> frame( const msg_t& msg );
+
+    private:
+
+      double my_rate;
+      double my_sigma;     // Of the noise, per I and Q.
+      double my_offset;    // Radians per sample.
+      double my_drift;
+
+      // The MSK bit shapes, one nominal bit long.
+
+      size_t                my_spb;
+      BufferVOLK<lv_32fc_t> my_l0, my_l1, my_h0, my_h1;
+
+      std::mt19937                     my_rng;
+      std::normal_distribution<double> my_noise;
+
+      double   my_phase;   // Of the carrier offset.
+      uint64_t my_n;       // Samples made, for the quarter rate turn.
+
+      void _emit( double a, std::vector<uint8_t>& iq );
+
+    };
+
+    inline void
+    Modulator::drift( double the_ppm ) noexcept {
+
+      my_drift = the_ppm;
+    }
+
+  }
+}
+
+
+#endif
+
+
+//  LocalWords:  MSK IQ SOH ETX CRC DEL
@@ -0,0 +1,154 @@
+/* -*- c++ -*- */
+
+/*
+ * Copyright 2016 Dennis Glatting
+ *
+ *
+ * A small work stealing thread pool.
+ *
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ *
+ */
+
+#ifndef __ACARS_POOL_H__
+#define __ACARS_POOL_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+extern "C" {
+
+#include <stddef.h>
+#include <stdint.h>
+
+}
+
+
+namespace gr {
+  namespace acars {
+
+    // A fixed set of worker threads, each with a queue of its own. A
+    // batch of tasks is dealt round robin onto the queues. A worker
+    // takes the newest task off its own queue and, when that's empty,
+    // steals the oldest off someone else's, so a long task (a channel
+    // in the middle of a message) doesn't hold up the tasks dealt in
+    // behind it while other workers are idle.
+    //
+    // The thread that hands a batch over works on the pool's tasks
+    // too until there are none left to take, then waits for its
+    // batch. Any number of threads may run batches at once.
+
+    class WorkPool {
+
+    public:
+
+      typedef std::function<void( void )> Task;
+
+      WorkPool( int the_workers );
+      ~WorkPool( void );
+
+      WorkPool( const WorkPool& ) = delete;
+      WorkPool& operator=( const WorkPool& ) = delete;
+
+      // Run every task and return when they are all done. The tasks
+      // mustn't throw.
+
+      void run( std::vector<Task>& the_tasks );
+
+      // Return things about the pool: the workers and the tasks that
+      // were stolen, by a worker or a caller, off a queue they weren't
+      // dealt to.
+
+      size_t   workers( void ) const noexcept;
+      uint64_t steals( void ) const noexcept;
+
+    private:
+
+      // A batch is on its caller's stack. It's finished, and its
+      // caller can return, once left is zero and nobody holds lock.
+
+      struct Batch {
+
+	size_t                  left;
+	std::mutex              lock;
+	std::condition_variable done;
+
+      };
+
+      struct Job {
+
+	Task*  task;
+	Batch* batch;
+
+      };
+
+      // Padded so two queues' locks don't share a cache line.
+
+      struct Queue {
+
+	std::mutex      lock;
+	std::deque<Job> jobs;
+	char            pad[64];
+
+      };
+
+      std::vector<std::unique_ptr<Queue>> my_queues;
+      std::vector<std::thread>            my_threads;
+
+      // Jobs queued and not yet taken, and what the idle workers wait
+      // on for it to go up.
+
+      std::mutex              my_lock;
+      std::condition_variable my_wake;
+      std::atomic<size_t>     my_pending;
+      bool                    my_stop;
+
+      std::atomic<size_t>   my_deal;    // The queue the next batch starts on.
+      std::atomic<uint64_t> my_steals;
+
+      bool _take( size_t the_home, Job& the_job );
+      void _finish( Job& the_job );
+      void _worker( size_t the_home );
+
+    };
+
+    inline size_t
+    WorkPool::workers( void ) const noexcept {
+
+      return my_threads.size();
+    }
+
+    inline uint64_t
+    WorkPool::steals( void ) const noexcept {
+
+      return my_steals.load( std::memory_order_relaxed );
+    }
+
+  }
+}
+
+
+#endif
+
+
+//  LocalWords:  WorkPool
@@ -0,0 +1,158 @@
+/* -*- c++ -*- */
+
+/*
+ * Copyright 2016 Dennis Glatting
+ *
+ *
+ * Per-stage timing of the demodulator and decoder.
+ *
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ *
+ */
+
+#ifndef __ACARS_PROFILE_H__
+#define __ACARS_PROFILE_H__
+
+#include <atomic>
+
+extern "C" {
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+}
+
+
+namespace gr {
+  namespace acars {
+
+    // The stages that are timed, in the order they run.
+
+    enum class Stage {
+      ROTATE_90, LOW_PASS, POST_SQUELCH, AM_DEMOD, FRONT_END,
+      LOW_PASS_SIMPLE, DEEMPH_FILTER, DC_BLOCK_FILTER,
+      CHANNELIZER,
+      GETBIT, GETMESG, CRC_CORRECT, PRINT_MESG,
+      COUNT
+    };
+
+    // Profiling is off until it is enabled and costs one load and
+    // branch per timed call while it is off. When it is on, every
+    // call is timed with the monotonic clock and lands in a log2
+    // histogram of nanoseconds, so a stage that is usually cheap but
+    // sometimes isn't shows up as a second hump rather than a
+    // slightly worse average.
+    //
+    // The counters are atomic so any thread may time anything.
+    //
+    // Stages nest: _getbit runs _getmesg, which runs crc_correct (on
+    // the framer's thread with -S, _getmesg isn't inside _getbit). A
+    // call that starts while another stage is being timed on the same
+    // thread is counted as nested, and its time is already in the
+    // outer stage's.
+
+    void profile_enable( bool on ) noexcept;
+    bool profile_enabled( void ) noexcept;
+
+    // Record one call of a stage that took ns and processed the given
+    // number of samples (or bytes, or bits; whatever the stage eats),
+    // and whether it ran inside another timed stage.
+
+    void profile_record( Stage s, uint64_t ns, size_t samples,
+			 bool nested = false ) noexcept;
+
+    // Print every stage that has been called: calls, samples, total
+    // time, the throughput, and the histogram. The percentages are of
+    // the time spent in stages that weren't nested, so those add up to
+    // 100; a stage that only ran nested is indented under the one it
+    // ran in, and its share is part of that one's.
+
+    void profile_dump( FILE* f );
+
+    // Time the enclosing scope.
+
+    class ProfileScope {
+
+    private:
+
+      const Stage     my_stage;
+      const size_t    my_samples;
+      const bool      my_on;
+      bool            my_nested;
+      struct timespec my_start;
+
+    public:
+
+      ProfileScope( Stage the_stage, size_t the_samples = 1 ) noexcept;
+      ~ProfileScope( void ) noexcept;
+
+      ProfileScope( const ProfileScope& ) = delete;
+      ProfileScope& operator=( const ProfileScope& ) = delete;
+
+    };
+
+    namespace detail {
+
+      extern std::atomic<bool> profile_on;
+      extern thread_local int  profile_depth;   // Scopes open on this thread.
+
+    }
+
+    inline bool
+    profile_enabled( void ) noexcept {
+
+      return detail::profile_on.load( std::memory_order_relaxed );
+    }
+
+    inline
+    ProfileScope::ProfileScope( Stage the_stage, size_t the_samples ) noexcept
+      : my_stage( the_stage ), my_samples( the_samples ),
+	my_on( profile_enabled()), my_nested( false ) {
+
+      if( my_on ) {
+	my_nested = ( detail::profile_depth++ > 0 );
+	clock_gettime( CLOCK_MONOTONIC, &my_start );
+      }
+
+    }
+
+    inline
+    ProfileScope::~ProfileScope( void ) noexcept {
+
+      if( my_on ) {
+
+	struct timespec now;
+
+	clock_gettime( CLOCK_MONOTONIC, &now );
+	--detail::profile_depth;
+	profile_record( my_stage,
+			uint64_t( now.tv_sec - my_start.tv_sec ) * 1000000000 +
+			uint64_t( now.tv_nsec ) - uint64_t( my_start.tv_nsec ),
+			my_samples, my_nested );
+      }
+    }
+
+  }
+}
+
+
+#endif
+
+
+//  LocalWords:  histogram
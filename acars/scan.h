@@ -0,0 +1,196 @@
+/* -*- c++ -*- */
+
+/*
+ * Copyright 2016 Dennis Glatting
+ *
+ *
+ * Which channel a single tuner scans next.
+ *
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ *
+ */
+
+#ifndef __ACARS_SCAN_H__
+#define __ACARS_SCAN_H__
+
+#include <vector>
+
+extern "C" {
+
+#include <stddef.h>
+#include <stdint.h>
+
+}
+
+
+namespace gr {
+  namespace acars {
+
+    // The share of the visits spread evenly over every channel, heard
+    // or not, by default; how long (s) what was heard on a channel
+    // takes to fade to a third; and how long (s) after a burst a
+    // channel counts as busy.
+
+#define SCAN_FLOOR   0.25
+#define SCAN_MEMORY  900.0
+#define SCAN_RECENT  30.0
+
+    // How often (s) the shares are worked out again when nothing new
+    // was heard. A burst has them worked out at the next pick.
+
+#define SCAN_REFRESH 1.0
+
+    // The longest (s) a channel is held for a message the decoder is
+    // in the middle of once the carrier has gone, and the shortest.
+
+#define SCAN_HOLD_MAX 2.0
+#define SCAN_HOLD_MIN 0.5
+
+    // With one tuner and a long list of channels, most of which are
+    // quiet most of the time, going round them in order spends nearly
+    // all the time on channels nobody is talking on. This keeps, for
+    // each channel, how much of it has been listened to, how many
+    // bursts (the squelch opening) were heard in that time, and how
+    // long they went on, and gives each channel a share of the visits
+    // in proportion to the bursts it's expected to have: its rate of
+    // them, more so if it had one lately (ACARS comes in exchanges).
+    // What was heard fades, so a channel that goes quiet gives its
+    // share back.
+    //
+    // A floor of the visits is spread evenly over all the channels,
+    // so every one is still visited at least that often, whatever was
+    // heard on the others. Within the shares the visits are handed
+    // out by stride scheduling: each channel is due again one over
+    // its share after it was last picked, and the channel due first
+    // is next.
+    //
+    // Time is whatever the caller counts in seconds; the sample clock
+    // makes a replay scan the same way every time.
+
+    class ScanScheduler {
+
+    public:
+
+      // What's been heard on a channel, not faded.
+
+      struct Stats {
+
+	uint64_t visits;
+	uint64_t bursts;
+	double   heard;      // s listened to.
+	double   airtime;    // s of carrier.
+	double   last;       // When the last burst started, < 0 for never.
+
+      };
+
+      ScanScheduler( size_t the_channels, double the_floor = SCAN_FLOOR,
+		     double the_memory = SCAN_MEMORY );
+
+      // The channel being listened to. The first is channel 0.
+
+      size_t current( void ) const noexcept;
+
+      // Account for the_dt just spent on the current channel, to
+      // the_now, and whether the squelch was open for it.
+
+      void observe( double the_now, double the_dt, bool the_carrier );
+
+      // Whether the current channel, its squelch closed, may be left.
+      // It's held while the decoder is in a message, for up to twice
+      // the channel's mean burst (within the SCAN_HOLD_* limits).
+
+      bool leave( double the_now, bool the_in_message );
+
+      // Pick the channel to listen to next and make it the current
+      // one. It may be the same one.
+
+      size_t next( double the_now );
+
+      size_t       channels( void ) const noexcept;
+      const Stats& stats( size_t the_channel ) const noexcept;
+
+      // The channel's share of the visits as of the last time they
+      // were worked out.
+
+      double share( size_t the_channel ) const noexcept;
+
+    private:
+
+      struct Channel {
+
+	Stats  stats;
+
+	// Faded to when: heard (s), bursts, and airtime (s).
+
+	double when;
+	double heard;
+	double bursts;
+	double airtime;
+
+	double share;
+	double due;      // Virtual time this is next due.
+
+      };
+
+      std::vector<Channel> my_channels;
+
+      double my_floor;
+      double my_memory;
+      size_t my_current;
+      bool   my_carrier;    // The current channel's squelch is open.
+      double my_hold;       // When the current hold started, < 0 if none.
+      double my_refresh;    // When the shares were worked out.
+      bool   my_heard;      // A burst since then.
+
+      void   _fade( Channel& the_channel, double the_now ) const noexcept;
+      void   _shares( double the_now );
+      double _weight( const Channel& the_channel, double the_now ) const noexcept;
+
+    };
+
+    inline size_t
+    ScanScheduler::current( void ) const noexcept {
+
+      return my_current;
+    }
+
+    inline size_t
+    ScanScheduler::channels( void ) const noexcept {
+
+      return my_channels.size();
+    }
+
+    inline const ScanScheduler::Stats&
+    ScanScheduler::stats( size_t the_channel ) const noexcept {
+
+      return my_channels[ the_channel ].stats;
+    }
+
+    inline double
+    ScanScheduler::share( size_t the_channel ) const noexcept {
+
+      return my_channels[ the_channel ].share;
+    }
+
+  }
+}
+
+
+#endif
+
+
+//  LocalWords:  ACARS
@@ -34,23 +34,55 @@
 #ifndef __INCLUDE_ACARS_UTILITY_H__
 #define __INCLUDE_ACARS_UTILITY_H__
 
-#include <vector>
+#include <array>
+#include <utility>
 
 extern "C" {
 
+#include <stddef.h>
 #include <stdint.h>
   
 }
 
 
+// A table of N entries, entry i being f(i), built by the
+// compiler. f has to be a constexpr function.
+
+template<typename T, T (*f)( size_t ), size_t... i>
+constexpr std::array<T, sizeof...( i )>
+_make_table( std::index_sequence<i...> ) {
+
+  return {{ f( i )... }};
+}
+
+template<typename T, size_t N, T (*f)( size_t )>
+constexpr std::array<T, N>
+make_table( void ) {
+
+  return _make_table<T, f>( std::make_index_sequence<N>());
+}
+
+
 // Return the value of bit 7 based on the odd parity of the index.
 
-extern const std::vector<uint8_t> parity_bit;
+constexpr uint8_t
+_parity_bit( size_t c ) {
+
+  int ones = 0;
+
+  for( size_t b = c; b; b >>= 1 )
+    ones += int( b & 1 );
+
+  return ( ones & 1 ) ? 0x00 : 0x80;
+}
+
+constexpr std::array<uint8_t, 128> parity_bit =
+  make_table<uint8_t, 128, _parity_bit>();
 
 
 // Convert the 7bit character to odd party, ignoring bit7.
 
-inline uint8_t
+constexpr uint8_t
 _to_odd( uint8_t c ) {
   
   return c | parity_bit[ c & 0x7f ];
@@ -58,7 +90,24 @@ _to_odd( uint8_t c ) {
 
 // Given a byte MSB..LSB, return the byte LSB..MSB
 
-extern const std::vector<uint8_t> reverse_bits;
+constexpr uint8_t
+_reverse_bits( size_t c ) {
+
+  uint8_t r = 0;
+
+  for( int b = 0; b < 8; ++b )
+    if( c & ( 1u << b ))
+      r |= uint8_t( 0x80 >> b );
+
+  return r;
+}
+
+constexpr std::array<uint8_t, 256> reverse_bits =
+  make_table<uint8_t, 256, _reverse_bits>();
+
+static_assert(( _to_odd( 0x00 ) == 0x80 ) && ( _to_odd( 0x01 ) == 0x01 ) &&
+	      ( reverse_bits[ 0x01 ] == 0x80 ) && ( reverse_bits[ 0x1e ] == 0x78 ),
+	      "the bit tables are wrong" );
   
 
 #endif
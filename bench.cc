@@ -0,0 +1,1178 @@
+/* -*- c++ -*- */
+
+/*
+ * Copyright 2016 Dennis Glatting
+ *
+ *
+ * Built in benchmarks and equivalence checks.
+ *
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ *
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <random>
+#include <thread>
+
+extern "C" {
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+}
+
+#include <acars/bench.h>
+#include <acars/crc.h>
+#include <acars/decoder.h>
+#include <acars/fir.h>
+#include <acars/modulator.h>
+#include <acars/pool.h>
+#include <acars/scan.h>
+#include <acars/utility.h>
+
+
+static const std::string my_ident = "$Id: bench.cc,v 1.1 2016/07/12 05:47:09 dennisg Exp $";
+
+
+namespace gr {
+  namespace acars {
+
+    static double
+    _now( void ) {
+
+      struct timespec t;
+
+      clock_gettime( CLOCK_MONOTONIC, &t );
+
+      return double( t.tv_sec ) + double( t.tv_nsec ) * 1e-9;
+    }
+
+    static double
+    _cpu( void ) {
+
+      struct timespec t;
+
+      clock_gettime( CLOCK_THREAD_CPUTIME_ID, &t );
+
+      return double( t.tv_sec ) + double( t.tv_nsec ) * 1e-9;
+    }
+
+    std::vector<int16_t>
+    synth_msk( size_t n_bits, double snr_db, uint32_t seed ) {
+
+      std::mt19937                     rng( seed );
+      std::bernoulli_distribution      coin;
+      std::normal_distribution<double> noise( 0.0,
+					      0.3 * pow( 10.0, -snr_db / 20.0 ));
+      std::vector<int16_t>             out;
+
+      const int spb   = int( Fe / 2400.0 );
+      double    phase = 0.0;
+      bool      prev  = true;
+
+      out.reserve( n_bits * spb );
+
+      // A bit the same as the last is a full cycle of 2400 Hz,
+      // otherwise half a cycle of 1200 Hz, riding on the carrier.
+
+      for( size_t b = 0; b < n_bits; ++b ) {
+
+	const bool   bit = coin( rng );
+	const double f   = ( bit == prev ) ? 2400.0 : 1200.0;
+
+	prev = bit;
+
+	for( int k = 0; k < spb; ++k ) {
+
+	  const double a =
+	    0.5 * ( 1.0 + 0.5 * sin( phase )) + noise( rng );
+
+	  phase += twoPI * f / Fe;
+	  out.push_back( int16_t( std::max( 0.0, a * 8192.0 )));
+	}
+      }
+
+      return out;
+    }
+
+    // The bit former with the library's sin() and cos() against the
+    // lookup table NCO: time both over the same signal and make sure
+    // they form the same bits.
+    //
+    // The bit former's level tracking starts at one, so a signal that
+    // starts at full strength throws both PLLs around for the first
+    // few bits and where they land isn't comparable. So the decoders
+    // first see a carrier that rises from nothing (as a transmitter
+    // keying up does) and only the bits after that are compared.
+
+    static int
+    _bench_nco( int verbose, const Receiver& ) {
+
+      const std::vector<int16_t> signal = synth_msk( 2400 * 20, 20.0, 1 );
+      const int                  rounds = 5;
+
+      std::vector<int16_t> lead( int( Fe / 10 ));
+
+      for( size_t i = 0; i < lead.size(); ++i )
+	lead[i] = int16_t( pow( 4096.0, double( i ) / lead.size()));
+
+      const std::vector<std::pair<const char*,
+				  AcarsDecoder::Oscillator>> oscs = {
+	{ "libm", AcarsDecoder::Oscillator::LIBM },
+	{ "lut",  AcarsDecoder::Oscillator::LUT  }
+      };
+
+      std::vector<std::vector<uint8_t>> bits( oscs.size());
+      std::vector<double>               secs( oscs.size());
+
+      for( size_t o = 0; o < oscs.size(); ++o ) {
+
+	double best = 1e9;
+
+	for( int r = 0; r < rounds; ++r ) {
+
+	  AcarsDecoder         d( []( msg_t& ) {}, verbose );
+	  std::vector<uint8_t> unused;
+
+	  d.oscillator( oscs[o].second );
+	  d.demod( lead.data(), lead.size(), unused );
+	  bits[o].clear();
+
+	  const double t0 = _now();
+	  d.demod( signal.data(), signal.size(), bits[o] );
+	  best = std::min( best, _now() - t0 );
+	}
+
+	secs[o] = best;
+
+	printf( "%-6s %8.1f ns/sample %8.2f Msps %8zu bits\n",
+		oscs[o].first, 1e9 * best / signal.size(),
+		signal.size() / best / 1e6, bits[o].size());
+      }
+
+      size_t diff = 0;
+
+      for( size_t i = 0; i < std::min( bits[0].size(), bits[1].size()); ++i )
+	diff += ( bits[0][i] != bits[1][i] );
+      diff += std::max( bits[0].size(), bits[1].size()) -
+	std::min( bits[0].size(), bits[1].size());
+
+      printf( "speedup %0.2fx, %zu bit(s) differ\n",
+	      secs[0] / secs[1], diff );
+
+      return diff ? 1 : 0;
+    }
+
+    // The per-sample bit former against the block one, both with
+    // the lookup table NCO. The block former holds the VFOs' PLL
+    // correction for a chunk, so a few bits may come out different;
+    // the agreement is reported rather than required to be exact.
+
+    static int
+    _bench_demod( int verbose, const Receiver& ) {
+
+      struct vector_sink : public BitSink {
+
+	std::vector<uint8_t>& bits;
+
+	vector_sink( std::vector<uint8_t>& the_bits ) : bits( the_bits ) {}
+
+	void bit( uint8_t b ) { bits.push_back( b ); }
+
+      };
+
+      const std::vector<int16_t> signal = synth_msk( 2400 * 20, 20.0, 2 );
+      const int                  rounds = 5;
+
+      std::vector<int16_t> lead( int( Fe / 10 ));
+
+      for( size_t i = 0; i < lead.size(); ++i )
+	lead[i] = int16_t( pow( 4096.0, double( i ) / lead.size()));
+
+      std::vector<uint8_t> bits[2];
+      double               secs[2] = { 1e9, 1e9 };
+
+      for( int r = 0; r < rounds; ++r ) {
+
+	AcarsDecoder         d( []( msg_t& ) {}, verbose );
+	std::vector<uint8_t> unused;
+
+	d.demod( lead.data(), lead.size(), unused );
+	bits[0].clear();
+
+	const double t0 = _now();
+	d.demod( signal.data(), signal.size(), bits[0] );
+	secs[0] = std::min( secs[0], _now() - t0 );
+      }
+
+      for( int r = 0; r < rounds; ++r ) {
+
+	AcarsDecoder         d( []( msg_t& ) {}, verbose );
+	std::vector<uint8_t> unused;
+	vector_sink          lead_sink( unused );
+	vector_sink          sink( bits[1] );
+
+	d.demod_block( lead.data(), lead.size(), lead_sink );
+	bits[1].clear();
+
+	const double t0 = _now();
+	d.demod_block( signal.data(), signal.size(), sink );
+	secs[1] = std::min( secs[1], _now() - t0 );
+      }
+
+      const char* const names[] = { "sample", "block" };
+
+      for( int i = 0; i < 2; ++i )
+	printf( "%-6s %8.1f ns/sample %8.2f Msps %8zu bits\n",
+		names[i], 1e9 * secs[i] / signal.size(),
+		signal.size() / secs[i] / 1e6, bits[i].size());
+
+      size_t same = 0;
+
+      for( size_t i = 0; i < std::min( bits[0].size(), bits[1].size()); ++i )
+	same += ( bits[0][i] == bits[1][i] );
+
+      const double agree = bits[0].empty() ? 0.0 :
+	100.0 * double( same ) / double( std::max( bits[0].size(),
+						   bits[1].size()));
+
+      printf( "speedup %0.2fx, %0.3f%% of bits agree\n",
+	      secs[0] / secs[1], agree );
+
+      return ( agree < 99.0 ) ? 1 : 0;
+    }
+
+    // CRC error correction: the old way, flipping every bit in turn
+    // and recomputing the CRC, against the syndrome table, over
+    // long messages with one and then two random bit errors. The
+    // table has to put every message back.
+
+    static int
+    _bench_ecc( int, const Receiver& ) {
+
+      std::mt19937 rng( 3 );
+      const int    trials = 200;
+      int          failed = 0;
+
+      // A message as the state machine collects it: the SOH, odd
+      // parity text, the ETX, and the CRC.
+
+      auto make = [&]( void ) {
+
+	std::vector<uint8_t> m( 1, _to_odd( SOH ));
+
+	for( int i = 0; i < 220; ++i )
+	  m.push_back( _to_odd( uint8_t( 0x20 + rng() % 0x5f )));
+	m.push_back( _to_odd( ETX ));
+
+	const uint16_t crc = gen_crc( m.begin(), m.cend());
+
+	m.push_back( uint8_t( crc ));
+	m.push_back( uint8_t( crc >> 8 ));
+
+	return m;
+      };
+
+      for( int errors = 1; errors <= 2; ++errors ) {
+
+	double brute = 0.0, table = 0.0;
+
+	for( int t = 0; t < trials; ++t ) {
+
+	  const std::vector<uint8_t> good = make();
+	  std::vector<uint8_t>       bad  = good;
+
+	  if( gen_crc( good.begin(), good.cend()) != 0 ) {
+	    fprintf( stderr, "the test message's CRC is wrong\n" );
+	    return 1;
+	  }
+
+	  // Distinct bits, clear of the SOH.
+
+	  size_t b1 = 8 + rng() % ( 8 * ( bad.size() - 1 ));
+	  size_t b2 = b1;
+
+	  while( b2 == b1 )
+	    b2 = 8 + rng() % ( 8 * ( bad.size() - 1 ));
+
+	  bad[ b1 / 8 ] ^= uint8_t( 1 << ( b1 % 8 ));
+	  if( errors == 2 )
+	    bad[ b2 / 8 ] ^= uint8_t( 1 << ( b2 % 8 ));
+
+	  double t0 = _now();
+
+	  if( errors == 1 ) {
+
+	    std::vector<uint8_t> m = bad;
+	    bool                 found = false;
+
+	    for( size_t i = 0; ( i < m.size()) && !found; ++i )
+	      for( int j = 0; ( j < 8 ) && !found; ++j ) {
+		m[i] ^= uint8_t( 1 << j );
+		found = ( gen_crc( m.begin(), m.cend()) == 0 );
+		if( !found )
+		  m[i] ^= uint8_t( 1 << j );
+	      }
+
+	    failed += ( m != good );
+	  }
+
+	  brute += _now() - t0;
+
+	  std::vector<uint8_t> m = bad;
+
+	  t0 = _now();
+
+	  const int n = crc_correct( m.data(), m.size(),
+				    gen_crc( m.begin(), m.cend()), 2 );
+
+	  table += _now() - t0;
+
+	  if(( n != errors ) || ( m != good ))
+	    ++failed;
+	}
+
+	if( errors == 1 )
+	  printf( "1 bit:  brute force %8.1f us, syndrome table %6.2f us, "
+		  "%0.0fx\n", 1e6 * brute / trials, 1e6 * table / trials,
+		  brute / table );
+	else
+	  printf( "2 bits: syndrome table %6.2f us\n", 1e6 * table / trials );
+      }
+
+      printf( "%d of %d message(s) not put back\n", failed, 3 * trials );
+
+      return failed ? 1 : 0;
+    }
+
+    // The CRC engines: each has to agree with the table engine on
+    // random bytes at every length up to 300 and from every
+    // alignment, including carrying on from a CRC part way through.
+    // Then the time each takes over the lengths the decoder hands
+    // gen_crc() (SOH through the CRC): a block with no text, short and
+    // typical ones, and one with 220 characters, the most a block
+    // holds; and to search a full block for a single bit error the
+    // old way, a CRC per bit.
+
+    static int
+    _bench_crc( int, const Receiver& ) {
+
+      const CrcEngine engines[] = {
+	CrcEngine::TABLE, CrcEngine::SLICE8, CrcEngine::CLMUL
+      };
+      const size_t    lengths[] = { 17, 40, 80, 160, 240 };
+      const int       rounds    = 5;
+
+      std::mt19937         rng( 9 );
+      std::vector<uint8_t> bytes( 300 + 8 );
+      int                  differ = 0;
+
+      for( auto& b : bytes )
+	b = uint8_t( rng());
+
+      printf( "engine  " );
+      for( size_t len : lengths )
+	printf( " %5zu B  ", len );
+      printf( "  1 bit search\n" );
+
+      for( CrcEngine e : engines ) {
+
+	if( !crc_engine_supported( e )) {
+	  printf( "%-8s not on this CPU\n", crc_engine_name( e ));
+	  continue;
+	}
+
+	for( size_t off = 0; off < 8; ++off )
+	  for( size_t n = 0; n <= 300; ++n ) {
+
+	    const uint8_t* p    = bytes.data() + off;
+	    const size_t   cut  = n / 3;
+	    const uint16_t want = crc_update( CrcEngine::TABLE, 0, p, n );
+
+	    differ += ( crc_update( e, 0, p, n ) != want );
+	    differ += ( crc_update( e, crc_update( e, 0, p, cut ),
+				    p + cut, n - cut ) != want );
+	  }
+
+	printf( "%-8s", crc_engine_name( e ));
+
+	for( size_t len : lengths ) {
+
+	  const int reps = 20000;
+	  double    best = 1e9;
+	  uint16_t  sink = 0;
+
+	  for( int r = 0; r < rounds; ++r ) {
+
+	    const double t0 = _cpu();
+
+	    for( int i = 0; i < reps; ++i )
+	      sink ^= crc_update( e, sink, bytes.data(), len );
+
+	    best = std::min( best, _cpu() - t0 );
+	  }
+
+	  bytes[0] ^= uint8_t( sink & 1 );
+	  printf( " %5.1f ns ", 1e9 * best / reps );
+	}
+
+	// As _bench_ecc()'s brute force: flip, check, flip back, over
+	// a block with one bit wrong. It should find that one bit.
+
+	std::vector<uint8_t> m( bytes.begin(), bytes.begin() + 238 );
+	const uint16_t       crc  = crc_update( e, 0, m.data(), m.size());
+	double               best = 1e9;
+	int                  hits = 0;
+
+	m.push_back( uint8_t( crc ));
+	m.push_back( uint8_t( crc >> 8 ));
+	m[100] ^= 0x04;
+
+	for( int r = 0; r < rounds; ++r ) {
+
+	  const double t0 = _cpu();
+
+	  for( size_t i = 0; i < m.size(); ++i )
+	    for( int j = 0; j < 8; ++j ) {
+	      m[i] ^= uint8_t( 1 << j );
+	      hits += ( crc_update( e, 0, m.data(), m.size()) == 0 );
+	      m[i] ^= uint8_t( 1 << j );
+	    }
+
+	  best = std::min( best, _cpu() - t0 );
+	}
+
+	differ += ( hits != rounds );
+
+	printf( " %8.1f us\n", 1e6 * best );
+      }
+
+      printf( "\n%d CRC(s) differ from the table engine's, gen_crc() uses %s\n",
+	      differ, crc_engine_name( crc_engine()));
+
+      return differ ? 1 : 0;
+    }
+
+    // A downlink as an aircraft might send it: a made up registration
+    // and flight, a common label, and up to a hundred characters of
+    // random text.
+
+    static msg_t
+    _random_mesg( std::mt19937& rng, int seq ) {
+
+      static const char* const labels[] = { "H1", "5Z", "Q0", "SA", "15", "_d" };
+
+      msg_t m;
+
+      memset( &m, 0, sizeof( m ));
+
+      m.mode = '2';
+      snprintf(( char* )m.addr, sizeof( m.addr ), ".N%05u",
+	       unsigned( rng() % 100000 ));
+      m.ack = NAK;
+      strcpy(( char* )m.label, labels[ rng() % 6 ]);
+      m.bid = uint8_t( '0' + seq % 10 );
+      snprintf(( char* )m.no, sizeof( m.no ), "M%02uA", unsigned( seq ) % 100 );
+      snprintf(( char* )m.fid, sizeof( m.fid ), "XA%04u",
+	       unsigned( rng() % 10000 ));
+
+      const size_t len = rng() % 100;
+
+      for( size_t i = 0; i < len; ++i )
+	m.txt[i] = char( ' ' + rng() % ( '~' - ' ' + 1 ));
+
+      return m;
+    }
+
+    // Whether the decoder got back what was sent. It turns the NAK
+    // into a '.', so the ACK/NAK isn't compared.
+
+    static bool
+    _same_mesg( const msg_t& a, const msg_t& b ) {
+
+      return ( a.mode == b.mode ) && ( a.bid == b.bid ) &&
+	( memcmp( a.addr,  b.addr,  sizeof( a.addr ))  == 0 ) &&
+	( memcmp( a.label, b.label, sizeof( a.label )) == 0 ) &&
+	( memcmp( a.no,    b.no,    sizeof( a.no ))    == 0 ) &&
+	( memcmp( a.fid,   b.fid,   sizeof( a.fid ))   == 0 ) &&
+	( strcmp( a.txt, b.txt ) == 0 );
+    }
+
+    // A stream of n_msgs random messages at snr_db, each with its own
+    // carrier offset (up to 2 kHz) and clock error (up to 200 ppm),
+    // with 50 ms of noise around each.
+
+    static void
+    _synth( double rate, double snr_db, int n_msgs, uint32_t seed,
+	    std::vector<uint8_t>& iq, std::vector<msg_t>& sent ) {
+
+      std::mt19937                           rng( seed );
+      std::uniform_real_distribution<double> offset( -2000.0, 2000.0 );
+      std::uniform_real_distribution<double> drift( -200.0, 200.0 );
+      Modulator                              mod( rate, seed );
+
+      mod.snr( snr_db );
+      mod.silence( 0.05, iq );
+
+      for( int i = 0; i < n_msgs; ++i ) {
+
+	sent.push_back( _random_mesg( rng, i ));
+
+	mod.offset( offset( rng ));
+	mod.drift( drift( rng ));
+	mod.burst( sent.back(), iq );
+	mod.silence( 0.05, iq );
+      }
+
+    }
+
+    bool
+    synth_recording( const char* path, double rate, double snr_db,
+		     int n_msgs, uint32_t seed ) {
+
+      std::vector<uint8_t> iq;
+      std::vector<msg_t>   sent;
+
+      _synth( rate, snr_db, n_msgs, seed, iq, sent );
+
+      FILE* f = fopen( path, "wb" );
+
+      if( !f )
+	return false;
+
+      const bool wrote = ( fwrite( iq.data(), 1, iq.size(), f ) == iq.size());
+      const int  err   = errno;
+
+      if(( fclose( f ) != 0 ) || !wrote ) {
+	errno = wrote ? errno : err;
+	return false;
+      }
+
+      return true;
+    }
+
+    // Sensitivity: the whole receive chain over messages from the
+    // Modulator at a sweep of SNRs, counting the messages that come
+    // back exactly as sent and the CPU each took. Run it before and
+    // after changing the front end or the bit former; a speed up
+    // shouldn't move the curve. Each SNR's stream is the same from
+    // run to run. It fails if any message is lost at the top of the
+    // sweep.
+
+    static int
+    _bench_snr( int verbose, const Receiver& rx ) {
+
+      const int n_msgs = 25;
+      int       lost   = 0;
+
+      // The decoder reports CRC failures on std::cerr, and at the
+      // bottom of the sweep there are plenty.
+
+      std::streambuf* const out = std::cerr.rdbuf( nullptr );
+
+      printf( "SNR dB    decoded   CPU/message  real time\n" );
+
+      // Much below the bottom of the sweep the noise overflows
+      // am_demod() and the decoder's input goes negative.
+
+      for( int snr = 6; snr <= 20; snr += 2 ) {
+
+	std::vector<uint8_t> iq;
+	std::vector<msg_t>   sent, got;
+
+	_synth( rx.rate, snr, n_msgs, uint32_t( 1 + snr ), iq, sent );
+
+	const double t0 = _cpu();
+	rx.decode( iq, true, got );
+	const double cpu = _cpu() - t0;
+
+	int ok = 0;
+
+	for( const auto& s : sent )
+	  for( const auto& m : got )
+	    if( _same_mesg( s, m )) {
+	      ++ok;
+	      break;
+	    }
+
+	printf( "%6d %6d/%-3d %8.2f ms %8.1fx\n", snr, ok, n_msgs,
+		1e3 * cpu / n_msgs, ( iq.size() / 2 / rx.rate ) / cpu );
+
+	if( verbose && ( got.size() != size_t( ok )))
+	  printf( "       %zu message(s) decoded that weren't sent\n",
+		  got.size() - ok );
+
+	lost = n_msgs - ok;
+      }
+
+      std::cerr.rdbuf( out );
+      std::cerr.clear();
+
+      return lost ? 1 : 0;
+    }
+
+    // The fused front end against the passes it replaces, over a
+    // stream from the Modulator and over random bytes, which are
+    // loud enough to overflow am_demod(). The fused one saturates
+    // where am_demod() wraps; anywhere else they have to agree.
+
+    static int
+    _bench_frontend( int verbose, const Receiver& rx ) {
+
+      std::vector<uint8_t> synth, noise( 1 << 22 );
+      std::vector<msg_t>   sent;
+      std::mt19937         rng( 4 );
+      const int            rounds = 5;
+      int                  bad    = 0;
+
+      _synth( rx.rate, 20.0, 4, 4, synth, sent );
+
+      for( auto& b : noise )
+	b = uint8_t( rng());
+
+      const std::vector<std::pair<const char*,
+				  const std::vector<uint8_t>*>> streams = {
+	{ "signal", &synth },
+	{ "noise",  &noise }
+      };
+
+      for( const auto& s : streams ) {
+
+	std::vector<int16_t> out[2];
+	double               secs[2] = { 1e9, 1e9 };
+
+	for( int f = 0; f < 2; ++f )
+	  for( int r = 0; r < rounds; ++r ) {
+
+	    out[f].clear();
+
+	    const double t0 = _cpu();
+	    rx.envelope( *s.second, f == 1, out[f] );
+	    secs[f] = std::min( secs[f], _cpu() - t0 );
+	  }
+
+	const size_t n = s.second->size() / 2;
+	size_t       differ = 0, saturated = 0;
+
+	for( size_t i = 0; i < std::min( out[0].size(), out[1].size()); ++i )
+	  if( out[0][i] != out[1][i] ) {
+	    if( out[1][i] == INT16_MAX )
+	      ++saturated;
+	    else
+	      ++differ;
+	  }
+	differ += std::max( out[0].size(), out[1].size()) -
+	  std::min( out[0].size(), out[1].size());
+
+	printf( "%-6s passes %6.2f ns/sample, fused %6.2f ns/sample, "
+		"speedup %0.2fx\n", s.first, 1e9 * secs[0] / n,
+		1e9 * secs[1] / n, secs[0] / secs[1] );
+	printf( "       %zu of %zu output(s) differ, %zu saturated where "
+		"am_demod() wrapped\n", differ, out[0].size(), saturated );
+
+	if( verbose && differ )
+	  for( size_t i = 0; i < std::min( out[0].size(), out[1].size()); ++i )
+	    if(( out[0][i] != out[1][i] ) && ( out[1][i] != INT16_MAX ))
+	      printf( "       %zu: %d %d\n", i, out[0][i], out[1][i] );
+
+	bad += ( differ != 0 );
+      }
+
+      return bad ? 1 : 0;
+    }
+
+    // The squelch gate on a channel that's idle most of the time, as
+    // they are: a few messages with seconds of noise between them,
+    // and noise alone. Then wideband mode from start up, where the
+    // first message comes 50 ms in and its decoder has never been fed
+    // before the gate opens. The gate mustn't lose anything the
+    // decoder finds without it.
+
+    static int
+    _bench_gate( int, const Receiver& rx ) {
+
+      const int n_msgs = 10;
+
+      std::vector<uint8_t> busy, idle, wide;
+      std::vector<msg_t>   sent, wide_sent;
+      std::mt19937         rng( 6 );
+      Modulator            mod( rx.rate, 6 ), quiet( rx.rate, 7 );
+
+      std::streambuf* const out = std::cerr.rdbuf( nullptr );
+
+      mod.snr( 12.0 );
+      mod.silence( 1.0, busy );
+
+      for( int i = 0; i < n_msgs; ++i ) {
+
+	sent.push_back( _random_mesg( rng, i ));
+	mod.burst( sent.back(), busy );
+	mod.silence( 2.0, busy );
+      }
+
+      quiet.silence( 10.0, idle );
+
+      _synth( rx.wb_rate, 20.0, n_msgs, 1, wide, wide_sent );
+
+      struct Stream {
+
+	const char*                 name;
+	const std::vector<uint8_t>& iq;
+	const std::vector<msg_t>&   sent;
+	double                      rate;
+	decltype( rx.decode )       decode;
+
+      };
+
+      const Stream streams[] = {
+	{ "busy", busy, sent,      rx.rate,    rx.decode   },
+	{ "idle", idle, sent,      rx.rate,    rx.decode   },
+	{ "wide", wide, wide_sent, rx.wb_rate, rx.wideband }
+      };
+
+      int lost = 0;
+
+      for( const auto& s : streams ) {
+
+	double secs[2];
+	int    ok[2];
+
+	for( int g = 0; g < 2; ++g ) {
+
+	  std::vector<msg_t> got;
+
+	  const double t0 = _cpu();
+	  s.decode( s.iq, g == 1, got );
+	  secs[g] = _cpu() - t0;
+
+	  ok[g] = 0;
+	  for( const auto& m : s.sent )
+	    for( const auto& x : got )
+	      if( _same_mesg( m, x )) {
+		++ok[g];
+		break;
+	      }
+	}
+
+	const double signal = s.iq.size() / 2 / s.rate;
+
+	printf( "%-4s %5.1fs: always %6.2f ms/s, %2d decoded; "
+		"gated %6.2f ms/s, %2d decoded\n", s.name, signal,
+		1e3 * secs[0] / signal, ok[0], 1e3 * secs[1] / signal, ok[1] );
+
+	lost += std::max( ok[0] - ok[1], 0 );
+      }
+
+      std::cerr.rdbuf( out );
+      std::cerr.clear();
+
+      return ( lost > 0 ) ? 1 : 0;
+    }
+
+    // Per channel decoding on the work pool, as wideband mode does
+    // it: a block of every channel's envelope at a time, one channel
+    // busy and the rest noise, on this thread and then on pools of
+    // more and more workers. The pool mustn't change what's decoded.
+
+    static int
+    _bench_pool( int verbose, const Receiver& rx ) {
+
+      const size_t channels = 8;
+      const size_t block    = 2048;
+      const int    n_msgs   = 10;
+
+      std::vector<std::vector<int16_t>> env( channels );
+      std::vector<msg_t>                sent;
+      std::mt19937                      rng( 8 );
+      size_t                            len = SIZE_MAX;
+
+      for( size_t ch = 0; ch < channels; ++ch ) {
+
+	Modulator            mod( rx.rate, uint32_t( 8 + ch ));
+	std::vector<uint8_t> iq;
+
+	mod.snr( 12.0 );
+	mod.silence( 0.5, iq );
+
+	for( int i = 0; i < n_msgs; ++i ) {
+	  if( ch == 0 ) {
+	    sent.push_back( _random_mesg( rng, i ));
+	    mod.burst( sent.back(), iq );
+	  }
+	  mod.silence(( ch == 0 ) ? 0.5 : 1.0, iq );
+	}
+
+	rx.envelope( iq, true, env[ch] );
+	len = std::min( len, env[ch].size());
+      }
+
+      std::streambuf* const out = std::cerr.rdbuf( nullptr );
+
+      const int           hw  = int( std::max( std::thread::hardware_concurrency(), 1u ));
+      std::vector<size_t> serial;
+      double              one = 0.0;
+      int                 bad = 0;
+
+      std::vector<int> sizes = { 0, 1, 2, 4 };
+
+      if( hw > 4 )
+	sizes.push_back( hw );
+
+      for( int workers : sizes ) {
+
+	std::vector<std::unique_ptr<AcarsDecoder>> decoders;
+	std::vector<size_t>                        got( channels, 0 );
+	std::vector<WorkPool::Task>                tasks;
+	std::unique_ptr<WorkPool>                  pool;
+	size_t                                     off = 0;
+
+	for( size_t ch = 0; ch < channels; ++ch ) {
+	  decoders.emplace_back( new AcarsDecoder( [&got, ch]( msg_t& ) {
+		++got[ch];
+	      }, verbose ));
+	  tasks.push_back( [&, ch] {
+	      decoders[ch]->push( env[ch].data() + off,
+				  std::min( block, len - off ));
+	    });
+	}
+
+	if( workers )
+	  pool.reset( new WorkPool( workers ));
+
+	const double t0 = _now();
+
+	for( off = 0; off < len; off += block )
+	  if( pool )
+	    pool->run( tasks );
+	  else
+	    for( auto& t : tasks )
+	      t();
+
+	const double secs = _now() - t0;
+
+	if( !workers ) {
+	  serial = got;
+	  one    = secs;
+	}
+
+	if( pool )
+	  printf( "%2d worker(s) %7.1f ms, %0.2fx, %6lu steal(s), "
+		  "%2zu decoded\n", workers, 1e3 * secs, one / secs,
+		  ( unsigned long )pool->steals(), got[0] );
+	else
+	  printf( "no pool      %7.1f ms, %zu channel(s) of %0.1f s, "
+		  "%2zu decoded\n", 1e3 * secs, channels, len / Fe, got[0] );
+
+	bad += ( got != serial );
+      }
+
+      std::cerr.rdbuf( out );
+      std::cerr.clear();
+
+      return bad ? 1 : 0;
+    }
+
+    // An hour of scanning a thousand channels with one tuner, a block
+    // (16 KB at the capture rate) at a time, as full_demod() hops,
+    // with a model of the traffic in place of a signal. Twenty of the
+    // channels have bursts of 0.3 to 0.6 s, half of them answered a
+    // second or so later, from one every 20 s on the busiest to one
+    // every five minutes; the rest have none. The tuner stays while
+    // there's a carrier and leaves a quiet channel after a block, and
+    // a burst is caught if the tuner was on its channel by the end of
+    // its pre-key. Going round in order (-R) is compared with the
+    // scheduler, which has to catch more.
+
+    static int
+    _bench_scan( int, const Receiver& rx ) {
+
+      struct Burst {
+
+	double start;
+	double end;
+
+      };
+
+      const size_t channels = 1000;
+      const size_t busy     = 20;
+      const double hour     = 3600.0;
+      const double prekey   = 0.04;
+      const double dt       = 8192 / rx.rate;
+
+      std::vector<std::vector<Burst>>        traffic( channels );
+      std::mt19937                           rng( 25 );
+      std::uniform_real_distribution<double> u( 0.0, 1.0 );
+      size_t                                 total = 0;
+
+      for( size_t b = 0; b < busy; ++b ) {
+
+	std::vector<Burst>& tr  = traffic[ b * ( channels / busy ) + 7 ];
+	const double        gap = 20.0 * pow( 15.0, double( b ) / ( busy - 1 ));
+
+	for( double t = -gap * log( 1.0 - u( rng )); t < hour;
+	     t += -gap * log( 1.0 - u( rng ))) {
+
+	  tr.push_back( Burst{ t, t + 0.3 + 0.3 * u( rng )});
+
+	  if( u( rng ) < 0.5 ) {
+	    t = tr.back().end + 0.5 + u( rng );
+	    tr.push_back( Burst{ t, t + 0.3 + 0.3 * u( rng )});
+	  }
+
+	  t = tr.back().end;
+	}
+
+	total += tr.size();
+      }
+
+      printf( "%zu channel(s), %zu with traffic, %zu burst(s) in %0.0f s, "
+	      "%0.1f ms blocks\n", channels, busy, total, hour, 1e3 * dt );
+
+      size_t caught[2];
+
+      for( int adaptive = 0; adaptive < 2; ++adaptive ) {
+
+	std::unique_ptr<ScanScheduler> sched;
+
+	if( adaptive )
+	  sched.reset( new ScanScheduler( channels ));
+
+	std::vector<size_t> at( channels, 0 );     // The first burst not over.
+	std::vector<size_t> got( channels, 0 );    // One past the last caught.
+	std::vector<double> left( channels, 0.0 ); // When the tuner last left.
+
+	size_t ch     = 0;
+	size_t hops   = 0;
+	int    quiet  = 0;
+	double arrive = 0.0;
+	double worst  = 0.0;
+	double useful = 0.0;
+
+	caught[ adaptive ] = 0;
+
+	const double t0 = _now();
+
+	for( double t = dt; t < hour; t += dt ) {
+
+	  const std::vector<Burst>& tr = traffic[ ch ];
+	  size_t&                   k  = at[ ch ];
+
+	  while(( k < tr.size()) && ( tr[k].end <= t - dt ))
+	    ++k;
+
+	  const bool carrier = ( k < tr.size()) && ( tr[k].start < t );
+
+	  if( carrier && ( got[ ch ] <= k ) && ( arrive <= tr[k].start + prekey )) {
+	    got[ ch ] = k + 1;
+	    ++caught[ adaptive ];
+	  }
+
+	  if( !tr.empty())
+	    useful += dt;
+
+	  if( sched )
+	    sched->observe( t, dt, carrier );
+
+	  quiet = carrier ? 0 : quiet + 1;
+
+	  if( quiet > 1 ) {
+
+	    const size_t next = sched ? sched->next( t ) : ( ch + 1 ) % channels;
+
+	    if( next != ch ) {
+	      left[ ch ] = t;
+	      ch         = next;
+	      worst      = std::max( worst, t - left[ ch ] );
+	      arrive     = t;
+	      quiet      = 1;
+	      ++hops;
+	    }
+	  }
+	}
+
+	const double secs = _now() - t0;
+
+	printf( "%-11s caught %4zu (%4.1f%%), %4.1f%% of the time on channels "
+		"with traffic, %7zu hop(s), longest away %5.1f s, %6.1f ms\n",
+		adaptive ? "scheduler" : "round robin", caught[ adaptive ],
+		100.0 * caught[ adaptive ] / total, 100.0 * useful / hour, hops,
+		worst, 1e3 * secs );
+      }
+
+      return ( caught[1] < caught[0] ) ? 1 : 0;
+    }
+
+    // low_pass()'s square window: the sum of each decimation pairs,
+    // without the 5/8 it takes off every second one.
+
+    static size_t
+    _square( const uint8_t* iq, size_t len, int d, int* out ) {
+
+      size_t n_out = 0;
+      int    r = 0, j = 0, k = 0;
+
+      for( size_t i = 0; i < len; i += 2 ) {
+
+	r += int( iq[i] )     - 127;
+	j += int( iq[i + 1] ) - 127;
+
+	if( ++k < d )
+	  continue;
+
+	out[ n_out++ ] = r;
+	out[ n_out++ ] = j;
+	r = j = k = 0;
+      }
+
+      return n_out / 2;
+    }
+
+    // The polyphase FIR against the square window: how far each
+    // takes down the edges of the channel, its neighbours, and what
+    // folds onto it, and what each costs per IQ pair, at the capture
+    // rate's decimation and at 2.4 Msps (decimation 50). The FIR has
+    // to give the same answers however the stream is cut into
+    // blocks.
+
+    static int
+    _bench_fir( int verbose, const Receiver& rx ) {
+
+      const int    d      = int( lround( rx.rate / Fe ));
+      const int    rounds = 5;
+      const double at[]   = { 2400.0, 6000.0, 12500.0, 16700.0, 25000.0,
+			      50000.0, 100000.0 };
+
+      Decimator fir( d, rx.taps, rx.rate );
+
+      printf( "decimation %d, %zu taps (%d per phase), cutoff %0.0f Hz\n\n",
+	      d, fir.taps(), rx.taps, FIR_CUTOFF );
+      printf( "      Hz     square dB   FIR dB\n" );
+
+      for( double f : at ) {
+
+	const double x  = M_PI * f / rx.rate;
+	const double sq = fabs( sin( x * d ) / ( d * sin( x )));
+
+	printf( "%8.0f %10.1f %10.1f\n", f,
+		20.0 * log10( std::max( sq, 1e-12 )), fir.response( f ));
+      }
+
+      std::vector<uint8_t> noise( 1 << 22 );
+      std::mt19937         rng( 5 );
+      std::vector<int>     out( noise.size());
+
+      for( auto& b : noise )
+	b = uint8_t( rng());
+
+      printf( "\n" );
+
+      for( int dd : { d, 50 }) {
+
+	Decimator    f( dd, rx.taps, dd * Fe );
+	double       secs[2] = { 1e9, 1e9 };
+	const size_t n       = noise.size() / 2;
+
+	for( int r = 0; r < rounds; ++r ) {
+
+	  double t0 = _cpu();
+	  _square( noise.data(), noise.size(), dd, out.data());
+	  secs[0] = std::min( secs[0], _cpu() - t0 );
+
+	  t0 = _cpu();
+	  f.push( noise.data(), noise.size(), out.data());
+	  secs[1] = std::min( secs[1], _cpu() - t0 );
+	}
+
+	printf( "%0.3f Msps: square %6.2f ns/pair, FIR %6.2f ns/pair "
+		"(%0.1f%% of real time)\n", dd * Fe / 1e6, 1e9 * secs[0] / n,
+		1e9 * secs[1] / n, 100.0 * secs[1] * dd * Fe / n );
+      }
+
+      // Once in one go and again in odd sized blocks.
+
+      Decimator        whole( d, rx.taps, rx.rate ), cut( d, rx.taps, rx.rate );
+      std::vector<int> a( noise.size()), b( noise.size());
+      size_t           n_a = whole.push( noise.data(), noise.size(), a.data());
+      size_t           n_b = 0;
+
+      for( size_t off = 0; off < noise.size(); ) {
+
+	const size_t len = std::min( noise.size() - off,
+				     size_t( 2 * ( 1 + rng() % 5000 )));
+
+	n_b += cut.push( noise.data() + off, len, b.data() + 2 * n_b );
+	off += len;
+      }
+
+      size_t differ = ( n_a > n_b ) ? n_a - n_b : n_b - n_a;
+
+      for( size_t i = 0; i < 2 * std::min( n_a, n_b ); ++i )
+	if( a[i] != b[i] ) {
+	  if( verbose && ( differ < 10 ))
+	    printf( "  %zu: %d %d\n", i / 2, a[i], b[i] );
+	  ++differ;
+	}
+
+      printf( "\n%zu of %zu output(s) differ when cut into blocks\n",
+	      differ, n_a );
+
+      return differ ? 1 : 0;
+    }
+
+    int
+    run_bench( const std::string& name, int verbose, const Receiver& rx ) {
+
+      static const std::map<std::string,
+			    std::function<int( int, const Receiver& )>> benches = {
+	{ "crc",      _bench_crc      },
+	{ "demod",    _bench_demod    },
+	{ "ecc",      _bench_ecc      },
+	{ "fir",      _bench_fir      },
+	{ "frontend", _bench_frontend },
+	{ "gate",     _bench_gate     },
+	{ "nco",      _bench_nco      },
+	{ "pool",     _bench_pool     },
+	{ "scan",     _bench_scan     },
+	{ "snr",      _bench_snr      }
+      };
+
+      const auto b = benches.find( name );
+
+      if( b == benches.end()) {
+
+	fprintf( stderr, "Unknown benchmark %s, try one of:", name.c_str());
+	for( const auto& i : benches )
+	  fprintf( stderr, " %s", i.first.c_str());
+	fprintf( stderr, "\n" );
+
+	return 1;
+      }
+
+      return b->second( verbose, rx );
+    }
+
+  }
+}
+
+
+//  LocalWords:  MSK NCO libm SOH ETX SNR SNRs FIR IQ Msps
@@ -0,0 +1,244 @@
+/* -*- c++ -*- */
+
+/*
+ * Copyright 2016 Dennis Glatting
+ *
+ *
+ * A fast convolution (FFT) channelizer: one wideband IQ stream in,
+ * the AM envelope of several narrow channels out.
+ *
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ *
+ */
+
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <string>
+
+#include <acars/channelizer.h>
+
+
+static const std::string my_ident = "$Id: channelizer.cc,v 1.1 2016/07/10 18:02:11 dennisg Exp $";
+
+
+namespace gr {
+  namespace acars {
+
+    Channelizer::Channelizer( double the_rate, size_t the_decimation,
+			      const std::vector<double>& the_offsets,
+			      size_t the_max_block,
+			      size_t the_ifft_len,
+			      double the_cutoff )
+      : my_decimation( the_decimation ),
+	my_ifft_len( the_ifft_len ),
+	my_fft_len( the_decimation * the_ifft_len ),
+	my_hop( my_fft_len / 2 ),
+	my_in( my_fft_len ), my_fill( my_hop ),
+	my_spectrum( my_fft_len ),
+	my_filter( the_ifft_len ),
+	my_narrow( the_ifft_len ),
+	my_out_len( 0 ) {
+
+      assert( the_decimation );
+      assert( the_ifft_len && (( the_ifft_len % 2 ) == 0 ));
+      assert( !the_offsets.empty());
+
+      // Plan before anything is put in the buffers; planning may
+      // scribble on them.
+
+      my_forward = fftw_plan_dft_1d( int( my_fft_len ),
+				     my_in.get(), my_spectrum.get(),
+				     FFTW_FORWARD, FFTW_MEASURE );
+      my_inverse = fftw_plan_dft_1d( int( my_ifft_len ),
+				     my_narrow.get(), my_narrow.get(),
+				     FFTW_BACKWARD, FFTW_MEASURE );
+      assert( my_forward );
+      assert( my_inverse );
+
+      // The first step sees half a buffer of silence as its history.
+
+      memset( my_in.get(), 0, my_fft_len * sizeof( fftw_complex ));
+
+      // Round each channel's centre to the nearest bin and remember
+      // the bin the inverse FFT's negative half starts at.
+
+      const double bin_width = the_rate / double( my_fft_len );
+      const long   n         = long( my_fft_len );
+
+      for( const auto& f : the_offsets ) {
+
+	long k = lround( f / bin_width ) - long( my_ifft_len / 2 );
+
+	k = (( k % n ) + n ) % n;
+	my_bins.push_back( size_t( k ));
+
+      }
+
+      _design_filter( the_rate, the_cutoff );
+
+      // Each step makes hop / decimation samples per channel.
+
+      const size_t per_step = my_hop / my_decimation;
+      const size_t steps    = ( the_max_block / 2 ) / my_hop + 1;
+
+      my_out.reserve( my_bins.size());
+      for( size_t i = 0; i < my_bins.size(); ++i )
+	my_out.emplace_back( steps * per_step );
+
+      // Undo the forward FFT's gain (the inverse FFT only sums what
+      // the filter let through, so it has none) and put a full scale
+      // (127) carrier near the top of an int16_t.
+
+      my_scale = 256.0 / double( my_fft_len );
+
+    }
+
+    Channelizer::~Channelizer( void ) {
+
+      fftw_destroy_plan( my_forward );
+      fftw_destroy_plan( my_inverse );
+
+    }
+
+    // A Hamming windowed sinc low pass, half the FFT long so the
+    // overlap-save discard covers its transient, evaluated only at
+    // the ifft_len bins either side of DC that are kept. The phase
+    // is left alone because only the envelope is used.
+
+    void
+    Channelizer::_design_filter( double the_rate, double the_cutoff ) {
+
+      const size_t taps = my_hop;
+      const double fc   = the_cutoff / the_rate;
+      const double mid  = double( taps - 1 ) / 2.0;
+
+      std::vector<double> h( taps );
+      double              sum = 0.0;
+
+      for( size_t i = 0; i < taps; ++i ) {
+
+	const double t = double( i ) - mid;
+	const double w = 0.54 - 0.46 * cos( 2.0 * M_PI * i / ( taps - 1 ));
+
+	h[i] = w * (( t == 0.0 ) ?
+		    2.0 * fc :
+		    sin( 2.0 * M_PI * fc * t ) / ( M_PI * t ));
+	sum += h[i];
+      }
+
+      // Bin m of the inverse FFT is offset (m - ifft_len/2) from the
+      // channel centre, once the inverse FFT's halves are swapped. So
+      // the filter is stored swapped to match.
+
+      for( size_t m = 0; m < my_ifft_len; ++m ) {
+
+	const double f =
+	  double( long( m ) - long( my_ifft_len / 2 )) / double( my_fft_len );
+	double re = 0.0, im = 0.0;
+
+	for( size_t i = 0; i < taps; ++i ) {
+	  re += h[i] * cos( -2.0 * M_PI * f * i );
+	  im += h[i] * sin( -2.0 * M_PI * f * i );
+	}
+
+	const size_t j = ( m + my_ifft_len / 2 ) % my_ifft_len;
+
+	my_filter[j][0] = re / sum;
+	my_filter[j][1] = im / sum;
+      }
+    }
+
+    // One overlap-save step. The history is full.
+
+    void
+    Channelizer::_step( void ) {
+
+      fftw_execute( my_forward );
+
+      // The newest half becomes the history for the next step.
+
+      memmove( my_in.get(), my_in.get() + my_hop,
+	       my_hop * sizeof( fftw_complex ));
+      my_fill = my_hop;
+
+      const fftw_complex* X    = my_spectrum.get();
+      fftw_complex*       Y    = my_narrow.get();
+      const fftw_complex* H    = my_filter.get();
+      const size_t        half = my_ifft_len / 2;
+
+      for( size_t ch = 0; ch < my_bins.size(); ++ch ) {
+
+	// Gather the channel's bins, negative frequencies first, into
+	// the inverse FFT's order (DC at zero).
+
+	for( size_t m = 0; m < my_ifft_len; ++m ) {
+
+	  const size_t j = ( m + half ) % my_ifft_len;
+	  const size_t k = ( my_bins[ch] + m ) % my_fft_len;
+
+	  Y[j][0] = X[k][0] * H[j][0] - X[k][1] * H[j][1];
+	  Y[j][1] = X[k][0] * H[j][1] + X[k][1] * H[j][0];
+	}
+
+	fftw_execute( my_inverse );
+
+	// The first half is wrapped around garbage; keep the second.
+
+	int16_t* out = my_out[ch].get() + my_out_len;
+
+	for( size_t i = half; i < my_ifft_len; ++i ) {
+
+	  const double a =
+	    sqrt( Y[i][0] * Y[i][0] + Y[i][1] * Y[i][1] ) * my_scale;
+
+	  *out++ = ( a > 32767.0 ) ? int16_t( 32767 ) : int16_t( a );
+	}
+      }
+
+      my_out_len += ( my_ifft_len - half );
+
+    }
+
+    void
+    Channelizer::push( const uint8_t* iq, size_t len ) {
+
+      assert( len % 2 == 0 );
+
+      fftw_complex* in = my_in.get();
+
+      my_out_len = 0;
+
+      for( size_t i = 0; i < len; i += 2 ) {
+
+	in[my_fill][0] = double( iq[i]   ) - 127.5;
+	in[my_fill][1] = double( iq[i+1] ) - 127.5;
+
+	if( ++my_fill == my_fft_len )
+	  _step();
+      }
+
+      for( const auto& b : my_out )
+	b.check();
+
+    }
+
+  }
+}
+
+
+//  LocalWords:  IQ FFT FFTs
@@ -0,0 +1,959 @@
+/* -*- c++ -*- */
+
+/*
+ * Copyright 2016 Dennis Glatting
+ *
+ *
+ * The aircraft, airport, flight, and message label datasets and their
+ * indexes.
+ *
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ *
+ */
+
+#include <algorithm>
+#include <array>
+#include <string>
+#include <unordered_map>
+
+extern "C" {
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+}
+
+#include <acars/dataset.h>
+
+
+static const std::string my_ident = "$Id: dataset.cc,v 1.2 2016/07/14 02:55:10 dennisg Exp $";
+
+
+namespace gr {
+  namespace acars {
+
+    enum { AIRCRAFTS, AIRPORTS, FLIGHTS, LABELS, TABLES };
+
+    static const struct {
+      const char* file;
+      const char* what;
+      int         fields;
+    } text_files[ TABLES ] = {
+      { "aircrafts.txt",    "aircrafts",            4 },
+      { "airports.txt",     "airports",             4 },
+      { "flightroute2.txt", "flights",              4 },
+      { "acars_mls.txt",    "ACARS message labels", 2 }
+    };
+
+    // The image. It starts with the header and each section is
+    // aligned to eight bytes. It is in the byte order of the machine
+    // that wrote it and only that byte order is read back.
+
+    static const char     image_magic[8]   = "ACARSDB";
+    static const uint32_t image_version    = 1;
+    static const uint32_t image_byte_order = 0x01020304;
+
+    struct Dataset::section_s {
+      uint64_t offset;     // From the start of the image.
+      uint64_t count;      // Of elements.
+    };
+
+    struct Dataset::header_s {
+      char      magic[8];
+      uint32_t  version;
+      uint32_t  byte_order;
+      uint64_t  size;                // Of the whole image.
+      section_s rows[ TABLES ];      // row_s
+      section_s registration;        // sslot_s
+      section_s by_registration;     // int32_t
+      section_s airport_code;        // sslot_s
+      section_s airport_next;        // int32_t
+      section_s ml_code;             // sslot_s
+      section_s ml_next;             // int32_t
+      section_s airline;             // kslot_s
+      section_s route;               // kslot_s
+      section_s pool;                // char
+    };
+
+    // A row is the offsets of its fields in the string pool, in the
+    // order of the acars_* structs. A label uses two.
+
+    struct Dataset::row_s {
+      uint32_t f[4];
+    };
+
+    // The indexes are open addressing hash tables: a power of two
+    // slots, no more than 70% used, probed linearly.
+    //
+    // A string keyed slot holds the key's offset in the pool (the
+    // pool holds each string once, so equal keys have equal offsets)
+    // and the value. An integer keyed slot holds the key (never
+    // zero) and up to four values.
+
+    static const uint32_t empty_slot = 0xffffffff;
+
+    struct Dataset::sslot_s {
+      uint32_t key;
+      int32_t  value;
+    };
+
+    struct Dataset::kslot_s {
+      uint64_t key;
+      int32_t  v[4];
+    };
+
+    // The text files as they are read: the pool (offset zero is the
+    // empty string) and the rows.
+
+    struct Dataset::staging_s {
+
+      std::string                               pool;
+      std::unordered_map<std::string, uint32_t> strings;
+      std::vector<row_s>                        rows[ TABLES ];
+
+      staging_s( void ) : pool( 1, '\0' ) {
+
+	strings.emplace( "", 0 );
+
+      }
+
+      uint32_t intern( const char* s, size_t n ) {
+
+	const auto r = strings.emplace( std::string( s, n ),
+					uint32_t( pool.size()));
+
+	if( r.second ) {
+	  pool.append( s, n );
+	  pool.push_back( '\0' );
+	}
+
+	return r.first->second;
+      }
+
+      const char* str( uint32_t off ) const {
+
+	return pool.data() + off;
+      }
+    };
+
+    // Up to eight characters as one integer key. The characters are
+    // never NUL, so different lengths can't collide.
+
+    static inline uint64_t
+    _key( const char* s, size_t n ) {
+
+      uint64_t k = 0;
+
+      for( size_t i = 0; i < n; ++i )
+	k |= uint64_t( uint8_t( s[i] )) << ( 8 * i );
+
+      return k;
+    }
+
+    // FNV-1a for strings and a finalizer (MurmurHash3's) for integers.
+
+    static inline uint64_t
+    _hash( const char* s ) {
+
+      uint64_t h = 0xcbf29ce484222325ULL;
+
+      while( *s ) {
+	h ^= uint8_t( *s++ );
+	h *= 0x100000001b3ULL;
+      }
+
+      return h;
+    }
+
+    static inline uint64_t
+    _hash( uint64_t k ) {
+
+      k ^= k >> 33;
+      k *= 0xff51afd7ed558ccdULL;
+      k ^= k >> 33;
+      k *= 0xc4ceb9fe1a85ec53ULL;
+      k ^= k >> 33;
+
+      return k;
+    }
+
+    static size_t
+    _slots( size_t n ) {
+
+      size_t c = 8;
+
+      while( c * 7 < n * 10 )
+	c <<= 1;
+
+      return c;
+    }
+
+    Dataset::Dataset( void )
+      : my_map( nullptr ), my_map_size( 0 ),
+	my_base( nullptr ), my_size( 0 ), my_hdr( nullptr ) {
+
+      // An empty image, so every lookup has something to miss in.
+
+      _build( staging_s());
+
+    }
+
+    Dataset::~Dataset( void ) {
+
+      _unmap();
+
+    }
+
+    void
+    Dataset::_unmap( void ) {
+
+      if( my_map )
+	munmap( my_map, my_map_size );
+
+      my_map      = nullptr;
+      my_map_size = 0;
+
+    }
+
+    // Read a tab separated file a line at a time into the table's
+    // rows. The last field ends at a tab or the end of the line.
+    // Returns the number of rows, or -1 if the file couldn't be
+    // opened.
+
+    long
+    Dataset::_load( const std::string& path, int table, int n_fields,
+		    staging_s& st ) {
+
+      FILE* f = fopen( path.c_str(), "r" );
+
+      if( !f ) {
+	fprintf( stderr, "Warning: %s data source not found\n", path.c_str());
+	return -1;
+      }
+
+      long   n    = 0;
+      char*  line = NULL;
+      size_t len  = 0;
+
+      while( getline( &line, &len, f ) != -1 ) {
+
+	const char* item = line;
+	row_s       r    = {{ 0, 0, 0, 0 }};
+	int         i    = 0;
+
+	for( ; i < n_fields; ++i ) {
+
+	  const bool   last = ( i == n_fields - 1 );
+	  const size_t l    = strcspn( item, last ? "\t\r\n" : "\t" );
+
+	  if( !last && ( item[l] != '\t' ))
+	    break;
+
+	  r.f[i] = st.intern( item, l );
+	  item  += l + 1;
+	}
+
+	if( i < n_fields ) {
+	  fprintf( stderr, "Parse error on line: %s\n", line );
+	  continue;
+	}
+
+	st.rows[ table ].push_back( r );
+	++n;
+      }
+
+      free( line );
+      fclose( f );
+
+      return n;
+    }
+
+    void
+    Dataset::load_text( const std::string& dir ) {
+
+      staging_s st;
+
+      for( int t = 0; t < TABLES; ++t ) {
+
+	const long n = _load( dir + "/" + text_files[t].file, t,
+			      text_files[t].fields, st );
+
+	if( n >= 0 )
+	  printf( "Loaded: %li %s from dataset.....\n", n, text_files[t].what );
+      }
+
+      _build( st );
+
+    }
+
+    bool
+    Dataset::newer_text( const char* image, const std::string& dir ) {
+
+      struct stat is;
+
+      if( stat( image, &is ) != 0 )
+	return true;
+
+      for( int t = 0; t < TABLES; ++t ) {
+
+	struct stat ts;
+
+	if(( stat(( dir + "/" + text_files[t].file ).c_str(), &ts ) == 0 ) &&
+	   ( ts.st_mtime > is.st_mtime ))
+	  return true;
+      }
+
+      return false;
+    }
+
+    // Index the staged tables and lay the image out in my_own.
+
+    void
+    Dataset::_build( const staging_s& st ) {
+
+      const std::vector<row_s>& aircrafts = st.rows[ AIRCRAFTS ];
+      const std::vector<row_s>& airports  = st.rows[ AIRPORTS  ];
+      const std::vector<row_s>& flights   = st.rows[ FLIGHTS   ];
+      const std::vector<row_s>& mls       = st.rows[ LABELS    ];
+
+      // A string keyed table. The entries are in order of preference:
+      // a key already in the table keeps its value.
+
+      typedef std::vector<std::pair<uint32_t, int32_t>> entries_t;
+
+      auto string_table = [&]( const entries_t& entries ) {
+
+	std::vector<sslot_s> slots( _slots( entries.size()),
+				    sslot_s{ empty_slot, -1 } );
+	const size_t         mask = slots.size() - 1;
+
+	for( const auto& e : entries ) {
+
+	  size_t i = _hash( st.str( e.first )) & mask;
+
+	  while(( slots[i].key != empty_slot ) && ( slots[i].key != e.first ))
+	    i = ( i + 1 ) & mask;
+
+	  if( slots[i].key == empty_slot )
+	    slots[i] = sslot_s{ e.first, e.second };
+	}
+
+	return slots;
+      };
+
+      // The first row with each code and each row's next with its code.
+
+      auto chain = [&]( const std::vector<row_s>& rows, int field,
+			std::vector<sslot_s>& first,
+			std::vector<int32_t>& next ) {
+
+	std::unordered_map<uint32_t, int32_t> later;
+	entries_t                             entries;
+
+	next.assign( rows.size(), -1 );
+
+	for( size_t i = rows.size(); i-- > 0; ) {
+
+	  auto r = later.emplace( rows[i].f[ field ], int32_t( i ));
+
+	  if( !r.second ) {
+	    next[i]         = r.first->second;
+	    r.first->second = int32_t( i );
+	  }
+	}
+
+	for( size_t i = 0; i < rows.size(); ++i )
+	  entries.emplace_back( rows[i].f[ field ], int32_t( i ));
+
+	first = string_table( entries );
+      };
+
+      auto key_table = [&]( const std::unordered_map<uint64_t,
+			    std::array<int32_t, 4>>& keys ) {
+
+	std::vector<kslot_s> slots( _slots( keys.size()),
+				    kslot_s{ 0, { -1, -1, -1, -1 }} );
+	const size_t         mask = slots.size() - 1;
+
+	for( const auto& k : keys ) {
+
+	  size_t i = _hash( k.first ) & mask;
+
+	  while( slots[i].key )
+	    i = ( i + 1 ) & mask;
+
+	  slots[i].key = k.first;
+	  std::copy( k.second.begin(), k.second.end(), slots[i].v );
+	}
+
+	return slots;
+      };
+
+      /* airports and labels */
+
+      std::vector<sslot_s> airport_code, ml_code;
+      std::vector<int32_t> airport_next, ml_next;
+
+      chain( airports, 3, airport_code, airport_next );
+      chain( mls,      0, ml_code,      ml_next );
+
+      /* aircraft */
+
+      // The registrations are sorted (ties in file order) so those a
+      // prefix starts are a run. Each registration's answer is the
+      // smallest index in its run; runs are short, since few
+      // registrations start others.
+
+      std::vector<int32_t> by_registration( aircrafts.size());
+      entries_t            registrations;
+
+      for( size_t i = 0; i < aircrafts.size(); ++i )
+	by_registration[i] = int32_t( i );
+
+      std::stable_sort( by_registration.begin(), by_registration.end(),
+			[&]( int32_t a, int32_t b ) {
+			  return strcmp( st.str( aircrafts[a].f[0] ),
+					 st.str( aircrafts[b].f[0] )) < 0;
+			});
+
+      for( size_t p = 0; p < by_registration.size(); ++p ) {
+
+	const uint32_t r   = aircrafts[ by_registration[p] ].f[0];
+	const size_t   len = strlen( st.str( r ));
+
+	// A repeat was answered by its first.
+
+	if(( len == 0 ) ||
+	   (( p > 0 ) && ( aircrafts[ by_registration[p - 1] ].f[0] == r )))
+	  continue;
+
+	int32_t first = by_registration[p];
+
+	for( size_t q = p + 1;
+	     ( q < by_registration.size()) &&
+	       ( strncmp( st.str( aircrafts[ by_registration[q] ].f[0] ),
+			  st.str( r ), len ) == 0 );
+	     ++q )
+	  first = std::min( first, by_registration[q] );
+
+	registrations.emplace_back( r, first );
+      }
+
+      const std::vector<sslot_s> registration = string_table( registrations );
+
+      /* flights */
+
+      // Every flight is filed under its airline and each prefix of
+      // its number, and each key remembers the first flight whose
+      // origin (and, separately, destination) is a known airport.
+
+      std::unordered_map<uint32_t, int32_t>                first_airport;
+      std::unordered_map<uint64_t, std::array<int32_t, 4>> airlines, routes;
+
+      for( size_t i = airports.size(); i-- > 0; )
+	first_airport[ airports[i].f[3] ] = int32_t( i );
+
+      for( size_t i = 0; i < flights.size(); ++i ) {
+
+	const char* const id  = st.str( flights[i].f[0] );
+	const size_t      len = strlen( id );
+
+	if( len < 2 )
+	  continue;
+
+	airlines.emplace( _key( id, 2 ),
+			  std::array<int32_t, 4>{{ int32_t( i ), -1, -1, -1 }} );
+
+	const auto from = first_airport.find( flights[i].f[1] );
+	const auto to   = first_airport.find( flights[i].f[2] );
+
+	char k[ 2 + DATASET_NUMBER_MAX ];
+
+	k[0] = id[0];
+	k[1] = id[1];
+
+	for( size_t l = 1; ( l <= DATASET_NUMBER_MAX ) && ( 3 + l <= len ); ++l ) {
+
+	  k[ 1 + l ] = id[ 2 + l ];
+
+	  std::array<int32_t, 4>& r =
+	    routes.emplace( _key( k, 2 + l ),
+			    std::array<int32_t, 4>{{ -1, -1, -1, -1 }} ).first->second;
+
+	  if(( r[0] < 0 ) && ( from != first_airport.end())) {
+	    r[0] = int32_t( i );
+	    r[1] = from->second;
+	  }
+	  if(( r[2] < 0 ) && ( to != first_airport.end())) {
+	    r[2] = int32_t( i );
+	    r[3] = to->second;
+	  }
+	}
+      }
+
+      const std::vector<kslot_s> airline = key_table( airlines );
+      const std::vector<kslot_s> route   = key_table( routes );
+
+      /* the image */
+
+      header_s h;
+
+      memset( &h, 0, sizeof( h ));
+      memcpy( h.magic, image_magic, sizeof( h.magic ));
+      h.version    = image_version;
+      h.byte_order = image_byte_order;
+
+      size_t off = ( sizeof( header_s ) + 7 ) & ~size_t( 7 );
+
+      auto place = [&]( section_s& s, size_t count, size_t size ) {
+	s.offset = off;
+	s.count  = count;
+	off     += ( count * size + 7 ) & ~size_t( 7 );
+      };
+
+      for( int t = 0; t < TABLES; ++t )
+	place( h.rows[t], st.rows[t].size(), sizeof( row_s ));
+      place( h.registration,    registration.size(),    sizeof( sslot_s ));
+      place( h.by_registration, by_registration.size(), sizeof( int32_t ));
+      place( h.airport_code,    airport_code.size(),    sizeof( sslot_s ));
+      place( h.airport_next,    airport_next.size(),    sizeof( int32_t ));
+      place( h.ml_code,         ml_code.size(),         sizeof( sslot_s ));
+      place( h.ml_next,         ml_next.size(),         sizeof( int32_t ));
+      place( h.airline,         airline.size(),         sizeof( kslot_s ));
+      place( h.route,           route.size(),           sizeof( kslot_s ));
+      place( h.pool,            st.pool.size(),         1 );
+
+      h.size = off;
+
+      std::vector<uint64_t> image( off / 8, 0 );
+      char* const           base = reinterpret_cast<char*>( image.data());
+
+      auto put = [&]( const section_s& s, const void* p, size_t size ) {
+	if( s.count )
+	  memcpy( base + s.offset, p, s.count * size );
+      };
+
+      memcpy( base, &h, sizeof( h ));
+      for( int t = 0; t < TABLES; ++t )
+	put( h.rows[t], st.rows[t].data(), sizeof( row_s ));
+      put( h.registration,    registration.data(),    sizeof( sslot_s ));
+      put( h.by_registration, by_registration.data(), sizeof( int32_t ));
+      put( h.airport_code,    airport_code.data(),    sizeof( sslot_s ));
+      put( h.airport_next,    airport_next.data(),    sizeof( int32_t ));
+      put( h.ml_code,         ml_code.data(),         sizeof( sslot_s ));
+      put( h.ml_next,         ml_next.data(),         sizeof( int32_t ));
+      put( h.airline,         airline.data(),         sizeof( kslot_s ));
+      put( h.route,           route.data(),           sizeof( kslot_s ));
+      put( h.pool,            st.pool.data(),         1 );
+
+      // Only now let go of what was there.
+
+      _unmap();
+      my_own.swap( image );
+      _attach( reinterpret_cast<const char*>( my_own.data()), off );
+
+    }
+
+    // Check that an image is one this build can read and that every
+    // section lies inside it, and make it the dataset's. What's in
+    // the sections is checked as it's used, so a damaged image gives
+    // wrong answers rather than a crash.
+
+    bool
+    Dataset::_attach( const char* base, size_t size ) {
+
+      if( size < sizeof( header_s ))
+	return false;
+
+      const header_s* h = reinterpret_cast<const header_s*>( base );
+
+      if(( memcmp( h->magic, image_magic, sizeof( h->magic )) != 0 ) ||
+	 ( h->version != image_version ) ||
+	 ( h->byte_order != image_byte_order ) ||
+	 ( h->size != size ))
+	return false;
+
+      auto fits = [&]( const section_s& s, size_t elem ) {
+	return (( s.offset % 8 ) == 0 ) && ( s.offset <= size ) &&
+	  ( s.count <= ( size - s.offset ) / elem );
+      };
+      auto table = [&]( const section_s& s, size_t elem ) {
+	return fits( s, elem ) && s.count && (( s.count & ( s.count - 1 )) == 0 );
+      };
+
+      bool ok = true;
+
+      for( int t = 0; t < TABLES; ++t )
+	ok = ok && fits( h->rows[t], sizeof( row_s ));
+
+      ok = ok &&
+	table( h->registration, sizeof( sslot_s )) &&
+	table( h->airport_code, sizeof( sslot_s )) &&
+	table( h->ml_code,      sizeof( sslot_s )) &&
+	table( h->airline,      sizeof( kslot_s )) &&
+	table( h->route,        sizeof( kslot_s )) &&
+	fits( h->by_registration, sizeof( int32_t )) &&
+	fits( h->airport_next,    sizeof( int32_t )) &&
+	fits( h->ml_next,         sizeof( int32_t )) &&
+	( h->by_registration.count == h->rows[ AIRCRAFTS ].count ) &&
+	( h->airport_next.count    == h->rows[ AIRPORTS  ].count ) &&
+	( h->ml_next.count         == h->rows[ LABELS    ].count ) &&
+	fits( h->pool, 1 ) && h->pool.count &&
+	( base[ h->pool.offset + h->pool.count - 1 ] == '\0' );
+
+      if( !ok )
+	return false;
+
+      my_base = base;
+      my_size = size;
+      my_hdr  = h;
+
+      return true;
+    }
+
+    bool
+    Dataset::save( const char* path ) const {
+
+      // Write beside it and rename over it, so a process that has the
+      // old image mapped keeps seeing the old image.
+
+      const std::string tmp = std::string( path ) + ".tmp";
+      FILE*             f   = fopen( tmp.c_str(), "wb" );
+
+      if( !f )
+	return false;
+
+      const bool wrote = ( fwrite( my_base, 1, my_size, f ) == my_size );
+      const int  err   = errno;
+
+      if(( fclose( f ) != 0 ) || !wrote ) {
+	unlink( tmp.c_str());
+	errno = wrote ? errno : err;
+	return false;
+      }
+
+      return rename( tmp.c_str(), path ) == 0;
+    }
+
+    bool
+    Dataset::map( const char* path ) {
+
+      const int fd = open( path, O_RDONLY );
+
+      if( fd < 0 )
+	return false;
+
+      struct stat s;
+
+      if( fstat( fd, &s ) != 0 ) {
+	const int err = errno;
+	close( fd );
+	errno = err;
+	return false;
+      }
+
+      const size_t size = size_t( s.st_size );
+      void* const  p    = size ?
+	mmap( NULL, size, PROT_READ, MAP_SHARED, fd, 0 ) : MAP_FAILED;
+      const int    err  = errno;
+
+      close( fd );
+
+      if( p == MAP_FAILED ) {
+	errno = size ? err : EINVAL;
+	return false;
+      }
+
+      // Keep the old image until the new one checks out.
+
+      void* const                 old_map  = my_map;
+      const size_t                old_size = my_map_size;
+      const char* const           old_base = my_base;
+      const size_t                old_len  = my_size;
+      const header_s* const       old_hdr  = my_hdr;
+
+      if( !_attach( static_cast<const char*>( p ), size )) {
+	munmap( p, size );
+	my_base = old_base;
+	my_size = old_len;
+	my_hdr  = old_hdr;
+	errno   = EINVAL;
+	return false;
+      }
+
+      if( old_map )
+	munmap( old_map, old_size );
+
+      my_map      = p;
+      my_map_size = size;
+      std::vector<uint64_t>().swap( my_own );
+
+      return true;
+    }
+
+    template< typename T >
+    const T*
+    Dataset::_at( const section_s& s ) const {
+
+      return reinterpret_cast<const T*>( my_base + s.offset );
+    }
+
+    const char*
+    Dataset::_str( uint32_t off ) const {
+
+      return ( off < my_hdr->pool.count ) ?
+	_at<char>( my_hdr->pool ) + off : "";
+    }
+
+    const Dataset::row_s*
+    Dataset::_row( int table, long i ) const {
+
+      const section_s& s = my_hdr->rows[ table ];
+
+      return (( i < 0 ) || ( uint64_t( i ) >= s.count )) ?
+	nullptr : _at<row_s>( s ) + i;
+    }
+
+    long
+    Dataset::_find( const section_s& s, const char* key ) const {
+
+      const sslot_s* const slots = _at<sslot_s>( s );
+      const size_t         mask  = s.count - 1;
+      size_t               i     = _hash( key ) & mask;
+
+      for( size_t n = 0; n < s.count; ++n, i = ( i + 1 ) & mask ) {
+
+	if( slots[i].key == empty_slot )
+	  break;
+	if( strcmp( _str( slots[i].key ), key ) == 0 )
+	  return slots[i].value;
+      }
+
+      return -1;
+    }
+
+    const Dataset::kslot_s*
+    Dataset::_find( const section_s& s, uint64_t key ) const {
+
+      const kslot_s* const slots = _at<kslot_s>( s );
+      const size_t         mask  = s.count - 1;
+      size_t               i     = _hash( key ) & mask;
+
+      for( size_t n = 0; key && ( n < s.count ); ++n, i = ( i + 1 ) & mask ) {
+
+	if( slots[i].key == 0 )
+	  break;
+	if( slots[i].key == key )
+	  return &slots[i];
+      }
+
+      return nullptr;
+    }
+
+    long
+    Dataset::_next( const section_s& s, long i ) const {
+
+      return (( i < 0 ) || ( uint64_t( i ) >= s.count )) ?
+	-1 : _at<int32_t>( s )[i];
+    }
+
+    long
+    Dataset::aircraft( const char* reg ) const {
+
+      const long r = _find( my_hdr->registration, reg );
+
+      if( r >= 0 )
+	return r;
+
+      const size_t len = strlen( reg );
+
+      if( len == 0 )
+	return -1;
+
+      const int32_t* const sorted = _at<int32_t>( my_hdr->by_registration );
+      const int32_t* const end    = sorted + my_hdr->by_registration.count;
+
+      auto name = [this]( int32_t i ) {
+	const row_s* r = _row( AIRCRAFTS, i );
+	return r ? _str( r->f[0] ) : "";
+      };
+
+      const int32_t* p =
+	std::lower_bound( sorted, end, reg, [&]( int32_t a, const char* k ) {
+	    return strcmp( name( a ), k ) < 0;
+	  });
+      long first = -1;
+
+      for( ; ( p != end ) && ( strncmp( name( *p ), reg, len ) == 0 ); ++p )
+	if(( first < 0 ) || ( *p < first ))
+	  first = *p;
+
+      return first;
+    }
+
+    long
+    Dataset::airport( const char* code ) const {
+
+      return _find( my_hdr->airport_code, code );
+    }
+
+    long
+    Dataset::next_airport( long i ) const {
+
+      return _next( my_hdr->airport_next, i );
+    }
+
+    long
+    Dataset::label( const char* code ) const {
+
+      return _find( my_hdr->ml_code, code );
+    }
+
+    long
+    Dataset::next_label( long i ) const {
+
+      return _next( my_hdr->ml_next, i );
+    }
+
+    long
+    Dataset::airline( const char* fid ) const {
+
+      if( strnlen( fid, 2 ) < 2 )
+	return -1;
+
+      const kslot_s* k = _find( my_hdr->airline, _key( fid, 2 ));
+
+      return k ? k->v[0] : -1;
+    }
+
+    Dataset::leg_s
+    Dataset::_leg( const char* fid, const char* number, bool from ) const {
+
+      const size_t l = strlen( number );
+
+      if(( strnlen( fid, 2 ) < 2 ) || ( l == 0 ) || ( l > DATASET_NUMBER_MAX ))
+	return leg_s{ -1, -1 };
+
+      char k[ 2 + DATASET_NUMBER_MAX ];
+
+      k[0] = fid[0];
+      k[1] = fid[1];
+      memcpy( k + 2, number, l );
+
+      const kslot_s* r = _find( my_hdr->route, _key( k, 2 + l ));
+      const int      v = from ? 0 : 2;
+
+      if( !r || ( r->v[v] < 0 ))
+	return leg_s{ -1, -1 };
+
+      return leg_s{ r->v[v], r->v[v + 1] };
+    }
+
+    Dataset::leg_s
+    Dataset::departure( const char* fid, const char* number ) const {
+
+      return _leg( fid, number, true );
+    }
+
+    Dataset::leg_s
+    Dataset::arrival( const char* fid, const char* number ) const {
+
+      return _leg( fid, number, false );
+    }
+
+    acars_aircraft
+    Dataset::aircraft_at( long i ) const {
+
+      const row_s* r = _row( AIRCRAFTS, i );
+
+      if( !r )
+	return acars_aircraft{ "", "", "", "" };
+
+      return acars_aircraft{ _str( r->f[0] ), _str( r->f[1] ),
+			     _str( r->f[2] ), _str( r->f[3] ) };
+    }
+
+    acars_airport
+    Dataset::airport_at( long i ) const {
+
+      const row_s* r = _row( AIRPORTS, i );
+
+      if( !r )
+	return acars_airport{ "", "", "", "" };
+
+      return acars_airport{ _str( r->f[0] ), _str( r->f[1] ),
+			    _str( r->f[2] ), _str( r->f[3] ) };
+    }
+
+    acars_flight
+    Dataset::flight_at( long i ) const {
+
+      const row_s* r = _row( FLIGHTS, i );
+
+      if( !r )
+	return acars_flight{ "", "", "", "" };
+
+      return acars_flight{ _str( r->f[0] ), _str( r->f[1] ),
+			   _str( r->f[2] ), _str( r->f[3] ) };
+    }
+
+    acars_ml
+    Dataset::label_at( long i ) const {
+
+      const row_s* r = _row( LABELS, i );
+
+      if( !r )
+	return acars_ml{ "", "" };
+
+      return acars_ml{ _str( r->f[0] ), _str( r->f[1] ) };
+    }
+
+    size_t
+    Dataset::aircrafts( void ) const {
+
+      return my_hdr->rows[ AIRCRAFTS ].count;
+    }
+
+    size_t
+    Dataset::airports( void ) const {
+
+      return my_hdr->rows[ AIRPORTS ].count;
+    }
+
+    size_t
+    Dataset::flights( void ) const {
+
+      return my_hdr->rows[ FLIGHTS ].count;
+    }
+
+    size_t
+    Dataset::labels( void ) const {
+
+      return my_hdr->rows[ LABELS ].count;
+    }
+
+  }
+}
+
+
+//  LocalWords:  FNV MurmurHash
@@ -0,0 +1,1112 @@
+/* -*- c++ -*- */
+
+/*
+ * Copyright 2016 Dennis Glatting
+ *
+ *
+ * The ACARS bit former (getbit) and message state machine (getmesg),
+ * wrapped in an object so that more than one can run at a time.
+ *
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ *
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <acars/crc.h>
+#include <acars/decoder.h>
+#include <acars/profile.h>
+#include <acars/utility.h>
+
+
+namespace gr {
+  namespace acars {
+
+    // The number of bit errors between two words (i.e., the number
+    // of bits set to a 1 by their XOR). Where the compiler has a
+    // population count instruction this is one instruction; otherwise
+    // it's the usual shifts and masks, which beat the table lookup
+    // per byte this used to be.
+
+    static inline int
+    _count_bit_errors( uint64_t c1, uint64_t c2 ) noexcept {
+
+      const uint64_t x = c1 ^ c2;
+
+#if defined( __POPCNT__ ) || defined( __aarch64__ )
+
+      return __builtin_popcountll( x );
+
+#else
+
+      uint64_t y = x - (( x >> 1 ) & 0x5555555555555555ULL );
+
+      y = ( y & 0x3333333333333333ULL ) + (( y >> 2 ) & 0x3333333333333333ULL );
+      y = ( y + ( y >> 4 )) & 0x0f0f0f0f0f0f0f0fULL;
+
+      return int(( y * 0x0101010101010101ULL ) >> 56 );
+
+#endif
+
+    }
+
+    std::ostream&
+    operator<<( std::ostream& o, const STATE& s ) {
+
+      if( s == STATE::HEADL )
+	o << "HEADL";
+      else
+	if( s == STATE::HEADF )
+	  o << "HEADF";
+	else
+	  if( s == STATE::SYNC )
+	    o << "SYNC";
+	  else
+	    if( s == STATE::TXT )
+	      o << "TXT";
+	    else
+	      if( s == STATE::CRC1 )
+		o << "CRC1";
+	      else
+		if( s == STATE::CRC2 )
+		  o << "CRC2";
+		else
+		  if( s == STATE::END )
+		    o << "END";
+		  else
+		    o << "dunno";
+      return o;
+    }
+
+    // The numerically controlled oscillator. A phase is a uint32_t
+    // where 2^32 is a full turn, so the accumulator wraps for free,
+    // and the sine comes from a table of one turn, indexed by the top
+    // bits of the phase and linearly interpolated with the rest. The
+    // table has one extra entry so the interpolation never wraps.
+
+    static constexpr int      nco_bits  = 12;
+    static constexpr int      nco_shift = ( 32 - nco_bits );
+    static constexpr uint32_t nco_frac  = (( 1u << nco_shift ) - 1 );
+
+    static const std::vector<float> nco_table = [] {
+
+	std::vector<float> t(( 1 << nco_bits ) + 1 );
+
+	for( size_t i = 0; i < t.size(); ++i )
+	  t[i] = float( std::sin( twoPI * double( i ) / ( 1 << nco_bits )));
+
+	return t;
+      }();
+
+    static inline float
+    _nco_sin( uint32_t phase ) noexcept {
+
+      const uint32_t i = ( phase >> nco_shift );
+      const float    f =
+	float( phase & nco_frac ) * ( 1.0f / float( 1u << nco_shift ));
+
+      return nco_table[i] + f * ( nco_table[i+1] - nco_table[i] );
+    }
+
+    static inline float
+    _nco_cos( uint32_t phase ) noexcept {
+
+      return _nco_sin( phase + ( 1u << 30 ));
+    }
+
+    // Turn a phase step in radians of the VFOs' 4 pi cycle into an
+    // accumulator step. Negative steps wrap, which is what we want.
+
+    static inline uint32_t
+    _nco_step( float radians ) noexcept {
+
+      return uint32_t( int64_t( double( radians ) *
+				( 4294967296.0 / fourPI )));
+    }
+
+    AcarsDecoder::AcarsDecoder( MessageCallback the_callback, int the_verbose )
+      : rl( 0 ), fbits( 0 ), nfbits( 0 ), rx_idx( 0 ), my_symbols( nullptr ),
+	my_in_message( false ),
+	my_callback( the_callback ), my_verbose( the_verbose ),
+	my_osc( Oscillator::LUT ), my_correct( 1 ) {
+
+      reset();
+
+    }
+
+    void
+    AcarsDecoder::reset( void ) {
+
+      _init_bits();
+      _reset_bit_state_machine();
+      _reset_message_state_machine();
+
+      rl     = 0;
+      fbits  = 0;
+      nfbits = 0;
+
+    }
+
+    void
+    AcarsDecoder::_dump_sync( const uint64_t checkPhrase,
+			       const uint64_t checkWord ) const {
+
+      const uint64_t
+	w1 = (  checkWord & 0xffffffffff ),
+	w2 = ( ~checkWord & 0xffffffffff );
+      const int
+	err1 = _count_bit_errors( w1, checkPhrase ),
+	err2 = _count_bit_errors( w2, checkPhrase );
+
+      std::streamsize         width = std::cerr.width();
+      std::ios_base::fmtflags flags = std::cerr.flags();
+      char                    fill  = std::cerr.fill();
+
+      std::cerr << "Check: "
+		<< std::hex << std::showbase
+		<< std::setw(14) << checkPhrase
+		<< " ";
+      std::cerr << std::hex << std::showbase
+		<< std::setw(14) << w1
+		<< std::dec
+		<< " "
+		<< std::setw(2) << err1;
+      if( err1 < 5 )
+	std::cerr << " *** ";
+      else
+	std::cerr << "     ";
+      std::cerr << std::hex << std::showbase
+		<< std::setw(14) << w2
+		<< std::dec
+		<< " "
+		<< std::setw(2) << err2;
+      if( err2 < 5 )
+	std::cerr << " *** ";
+      else
+	std::cerr << "     ";
+      std::cerr << std::endl;
+
+      std::cerr.width( width );
+      std::cerr.setf( flags );
+      std::cerr.fill( fill );
+
+    }
+
+    void
+    AcarsDecoder::dump_bit_state_machine( void ) const {
+
+      std::cerr << "c: ";
+      for( size_t i = 0; i < size_t( BITLEN ); ++i )
+	std::cerr << bstat.csample[i] << " ";
+      std::cerr << std::endl;
+
+      std::cerr << "h: ";
+      for( size_t i = 0; i < bstat.hsample.size(); ++i )
+	std::cerr << bstat.hsample[i] << " ";
+      std::cerr << std::endl;
+
+      std::cerr << "l: ";
+      for( size_t i = 0; i < bstat.lsample.size(); ++i )
+	std::cerr << bstat.lsample[i] << " ";
+      std::cerr << std::endl;
+
+      std::cerr << "i: ";
+      for( size_t i = 0; i < bstat.isample.size(); ++i )
+	std::cerr << bstat.isample[i] << " ";
+      std::cerr << std::endl;
+
+      std::cerr << "q: ";
+      for( size_t i = 0; i < bstat.qsample.size(); ++i )
+	std::cerr << bstat.qsample[i] << " ";
+      std::cerr << std::endl;
+
+      std::cerr << "phih= " << bstat.phih
+		<< ", phil= " << bstat.phil << std::endl;
+      std::cerr << "dfh= " << bstat.dfh
+		<< ", dfl= "<< bstat.dfl << std::endl;
+      std::cerr << "pC= " << bstat.pC
+		<< ", ppC= "<< bstat.ppC << std::endl;
+      std::cerr << "sgI= " << bstat.sgI
+		<< ", sgQ= "<< bstat.sgQ << std::endl;
+
+      std::cerr << "is: " << bstat.is    << std::endl;
+      std::cerr << "cl: " << bstat.clock << std::endl;
+      std::cerr << "ln: " << bstat.lin   << std::endl;
+      std::cerr << "ea: " << bstat.ea    << std::endl;
+
+      std::cerr << std::endl;
+
+    }
+
+    bool
+    AcarsDecoder::_getbit( const float sample, uint8_t& outbits ) {
+
+      bool bt = false;
+
+      assert( sample >= 0 );
+
+      // The ring index runs backwards so [is, is + n) is always the
+      // newest n samples. The running sums pick up the new sample and
+      // drop the one leaving their window; every time the index wraps
+      // they are recomputed from the rings so rounding can't build up.
+
+      bool resync = false;
+
+      if( --bstat.is < 0 ) {
+	bstat.is = BITLEN - 1;
+	resync   = true;
+      }
+
+      const int is   = bstat.is;
+      const int half = ( is + BITLEN / 2 ) - (( is + BITLEN / 2 ) >= BITLEN ?
+					      BITLEN : 0 );
+
+      bstat.lin = ( 0.003 * std::fabs( sample )) + ( 0.997 * bstat.lin );
+
+      /* VFOs */
+
+      { float oscl, osch;
+
+	const float
+	  s  = sample / bstat.lin,
+	  s2 = s * s;
+
+	if( my_osc == Oscillator::LUT ) {
+
+	  // The accumulator's full turn is the VFO's 4 pi, so the
+	  // VFO's sine is at twice the accumulator's phase and the
+	  // half-phase cosine is at the accumulator's phase.
+
+	  bstat.uphih += _nco_step( Freqh - ( VFOPLL * bstat.dfh ));
+	  bstat.hsample[is] = s2 * _nco_sin( bstat.uphih << 1 );
+	  osch = _nco_cos( bstat.uphih );
+
+	  bstat.uphil += _nco_step( Freql - ( VFOPLL * bstat.dfl ));
+	  bstat.lsample[is] = s2 * _nco_sin( bstat.uphil << 1 );
+	  oscl = _nco_cos( bstat.uphil );
+
+	} else {
+
+	  bstat.phih += Freqh - ( VFOPLL * bstat.dfh );
+	  if( bstat.phih >= fourPI )
+	    bstat.phih -= fourPI;
+	  bstat.hsample[is] = s2 * std::sin( bstat.phih );
+	  osch = std::cos( bstat.phih / 2.0 );
+
+	  bstat.phil += Freql - ( VFOPLL * bstat.dfl );
+	  if( bstat.phil >= fourPI )
+	    bstat.phil -= fourPI;
+	  bstat.lsample[is] = s2 * std::sin( bstat.phil );
+	  oscl = std::cos( bstat.phil / 2.0 );
+
+	}
+
+	bstat.hsum += bstat.hsample[is] - bstat.hsample[half];
+	bstat.lsum += bstat.lsample[is] - bstat.lsample[half];
+
+	/* mix */
+
+	const float
+	  ni = s * ( oscl + osch ),
+	  nq = s * ( oscl - osch );
+
+	bstat.isum += ni - bstat.isample[is];
+	bstat.qsum += nq - bstat.qsample[is];
+	bstat.isample[is] = ni;
+	bstat.qsample[is] = nq;
+
+	// The clock filter's ring is written twice, BITLEN apart, so
+	// the filter is one straight dot product from is.
+
+	bstat.csample[is] = bstat.csample[is + BITLEN] = oscl * osch;
+
+	if( resync ) {
+
+	  bstat.hsum = bstat.lsum = bstat.isum = bstat.qsum = 0.0;
+
+	  for( int i = 0; i < ( BITLEN / 2 ); ++i ) {
+	    bstat.hsum += bstat.hsample[( is + i ) % BITLEN];
+	    bstat.lsum += bstat.lsample[( is + i ) % BITLEN];
+	  }
+	  for( int i = 0; i < BITLEN; ++i ) {
+	    bstat.isum += bstat.isample[i];
+	    bstat.qsum += bstat.qsample[i];
+	  }
+	}
+
+	bstat.dfh = float( bstat.hsum );
+	bstat.dfl = float( bstat.lsum );
+
+      }
+
+      /* bit clock */
+
+      if( ++bstat.clock >= ( BITLEN/4 + bstat.ea )) {
+
+	bstat.clock = 0;
+
+	/*  clock filter  */
+
+	float C;
+
+	volk_32f_x2_dot_prod_32f( &C, bstat.csample.get() + is, h.get(),
+				  BITLEN );
+
+	uint8_t sym;
+
+	if(( bt = _bit_clock( C, sym )))
+	  outbits = ( outbits >> 1 ) | uint8_t( _polarize( sym ) << 7 );
+
+      }
+
+      return bt;
+
+    }
+
+    // The bit clock has ticked and C is the clock filter's output.
+    // At a minimum of C the Q integrator holds a bit, at a maximum the
+    // I integrator does, and either way sym is set to what it read and
+    // the clock is nudged toward the extremum.
+
+    bool
+    AcarsDecoder::_bit_clock( const float C, uint8_t& sym ) noexcept {
+
+      bool bt = false;
+
+      if(( bstat.pC < C ) && ( bstat.pC < bstat.ppC )) {
+
+	const float Q = float( bstat.qsum );   /* integrator */
+
+	sym = uint8_t((( Q > 0 ) ? SYM_POS : 0 ) | (( Q < 0 ) ? SYM_NEG : 0 ));
+	bt  = true;
+
+	bstat.ea = -BITPLL * ( C - bstat.ppC );
+	if( bstat.ea > 2.0 )
+	  bstat.ea =  2.0;
+	if( bstat.ea < -2.0 )
+	  bstat.ea = -2.0;
+
+      }
+
+      if(( bstat.pC > C ) && ( bstat.pC > bstat.ppC )) {
+
+	const float I = float( bstat.isum );   /* integrator */
+
+	sym = uint8_t( SYM_I | (( I > 0 ) ? SYM_POS : 0 ) | (( I < 0 ) ? SYM_NEG : 0 ));
+	bt  = true;
+
+	bstat.ea = BITPLL * ( C - bstat.ppC );
+	if( bstat.ea > 2.0 )
+	  bstat.ea = 2.0;
+	if( bstat.ea < -2.0 )
+	  bstat.ea = -2.0;
+      }
+
+      bstat.ppC = bstat.pC;
+      bstat.pC  = C;
+
+      return bt;
+    }
+
+    // A symbol's bit. The first bit from an integrator since the
+    // polarities were reset sets its polarity, and is a 1 unless the
+    // integrator was exactly zero.
+
+    uint8_t
+    AcarsDecoder::_polarize( const uint8_t sym ) noexcept {
+
+      int& sg = ( sym & SYM_I ) ? bstat.sgI : bstat.sgQ;
+
+      if( sg == 0 )
+	sg = ( sym & SYM_NEG ) ? -1 : 1;
+
+      return ( sg > 0 ) ? ( sym & SYM_POS ) : (( sym & SYM_NEG ) >> 1 );
+    }
+
+    void
+    AcarsDecoder::_init_bits( void ) {
+
+      for( int i = 0; i < BITLEN; ++i ) 
+	h[i] = ( twoPI * float(i) / float(BITLEN));
+      volk_32f_sin_32f( h.get(), h.get(), h.size());
+      for( int i = 0; i < BITLEN; ++i )
+	hr[i] = h[ BITLEN - 1 - i ];
+
+      for( int i = 0; i < BITLEN; ++i ) {
+	bstat.hsample[i] = bstat.lsample[i] =
+	  bstat.isample[i] = bstat.qsample[i] =
+	  bstat.csample[i] = bstat.csample[i + BITLEN] = 0.0;
+	bstat.hlin[i] = bstat.llin[i] = bstat.ilin[i] = bstat.qlin[i] =
+	  bstat.clin[i] = 0.0;
+      }
+      bstat.hsum = bstat.lsum = bstat.isum = bstat.qsum = 0.0;
+
+      bstat.is = bstat.clock = 0;
+      bstat.sgI = bstat.sgQ = 0;
+
+      bstat.phih  = bstat.phil  = 0.0;
+      bstat.uphih = bstat.uphil = 0;
+      bstat.dfh  = bstat.dfl  = 0.0;
+      bstat.pC   = bstat.ppC  = 0.0;
+      bstat.ea  = 0.0;
+      bstat.lin = 1.0;
+
+    }
+
+    void
+    AcarsDecoder::_reset_message_state_machine( void ) {
+
+      m_state.state             = STATE::HEADL;
+      m_state.syncForming       = 0;
+      m_state.syncBitsHave      = 0;
+      m_state.consecutivePreKey = 0;
+      m_state.crc               = 0;
+      m_state.rawLen            = 0;
+      m_state.rawCrc            = 0;
+
+      my_in_message.store( false, std::memory_order_relaxed );
+
+    }
+
+    // Keep a message byte and fold it into the CRC.
+
+    inline void
+    AcarsDecoder::_save( const uint8_t c ) noexcept {
+
+      m_state.rawText[ m_state.rawLen++ ] = c;
+      m_state.rawCrc = crc_fold( m_state.rawCrc, c );
+
+    }
+
+    void
+    AcarsDecoder::_reset_bit_state_machine( void ) {
+
+      // Wouldn't it also make sense to clear the accumulators?
+
+      bstat.sgI = bstat.sgQ = 0;
+
+    }
+
+    // Fill msg from the n raw bytes of a message, SOH through the
+    // CRC. A block too short to have a field leaves it empty.
+
+    static int
+    build_mesg( const uint8_t* txt, size_t n, msg_t* msg ) {
+
+      assert( msg );
+      memset( msg, 0, sizeof( msg_t ));
+
+      // Leave off the framing (the SOH, and the ETX and two CRC
+      // bytes) and turn special characters into dots.
+
+      const uint8_t* m = txt + 1;
+      const size_t   m_len = ( n > 4 ) ? n - 4 : 0;
+      size_t         k = 0;
+
+      auto next = [&]( void ) -> char {
+
+	if( k >= m_len ) {
+	  ++k;
+	  return 0;
+	}
+
+	char r = char( m[k++] & 0x7f );
+
+	if( r < ' ' && r != CR && r != LF )
+	  r = '.'; // was 0xa4 AR CHANGE: Set other placeholder
+
+	return r;
+      };
+
+      /* fill msg struct */
+
+      msg->mode = next();
+
+      for( int i = 0; i < 7; ++i ) 
+	msg->addr[i] = next();
+
+      /* ACK/NAK */
+      msg->ack = next();
+
+      msg->label[0] = next();
+      msg->label[1] = next();
+
+      msg->bid = next();
+      next();
+
+      for( int i = 0; i < 4; ++i ) 
+	msg->no[i] = next();
+
+      for( int i = 0; i < 6; ++i ) 
+	msg->fid[i] = next();
+
+      for( size_t i = 0; k < m_len; ++i )
+	msg->txt[i] = next();
+
+      return 1;
+    }
+
+    // w holds n (at least 8) bits, the oldest in bit 0, and r is the
+    // first eight of them.
+
+    int
+    AcarsDecoder::_getmesg( const uint64_t w, const int n,
+			    msg_t* msg ) noexcept {
+
+      const uint8_t r = uint8_t( w );
+
+      assert( msg );
+      assert( n >= 8 );
+
+      // This is a confusing loop. The point of the loop is to allow a
+      // state change to process the word a second time. Specifically,
+      // when the state changes from PRE-KEY to BIT SYNC. In this case the
+      // code has been processing PRE KEY words but suddenly the word
+      // isn't PRE-KEY and it might be a forming BIT SYNC. In that case,
+      // loop again until some condition is met.
+
+      if( m_state.state != STATE::HEADL )
+	if( my_verbose > 3 )
+	  std::cerr << m_state.state << ": "
+		    << std::hex << unsigned(r) << std::dec
+		    << std::endl;
+
+      do {
+
+	switch( m_state.state ) {
+
+	  // PREKEY lost. Looking for PRE-KEY.
+
+	case STATE::HEADL:
+
+	  if( r == PRE_KEY_CHAR ) {
+
+	    if( ++m_state.consecutivePreKey > m_state.consecutivePreKeyLim )
+	      m_state.state = STATE::HEADF;
+
+	  } else {
+
+	    _reset_bit_state_machine();
+	    _reset_message_state_machine();
+
+	  }
+
+	  return 1;
+
+	  // PRE-KEY found. Keep looking for PRE-KEY characters. If the
+	  // character isn't a PRE-KEY then advance the state machine to
+	  // sync.
+
+	case STATE::HEADF:
+
+	  // If the character isn't a PRE-KEY then we might be seeing the
+	  // start of the SYNC characters, so advance the state
+	  // machine. If the character is a PRE-KEY then we don't want to
+	  // risk consuming the first bits of the BIT SYNC, which are 11.
+	  //
+	  // That used to be done a bit at a time. Every bit before the
+	  // first zero less seven starts a character of PRE-KEY, so
+	  // they all go at once.
+
+	  { const uint64_t zeros = ~w & (( n == 64 ) ? ~uint64_t( 0 ) :
+					 (( uint64_t( 1 ) << n ) - 1 ));
+
+	    if( zeros == 0 )
+	      return n - 7;
+
+	    const int z = __builtin_ctzll( zeros );
+
+	    if( z > 7 )
+	      return z - 7;
+
+	    m_state.state        = STATE::SYNC;
+	    m_state.syncForming  = 0;
+	    m_state.syncBitsHave = 0;
+
+	  }
+	  break;
+
+	  // Look for the BIT-SYNC, CHAR-SYNC, and SOH, allowing a few
+	  // bit errors, at every bit. The SYNC word is the last 40 bits
+	  // (the oldest in bit 0); with the next character above it
+	  // each of the eight bits it could end on is a shift away, so
+	  // all eight are checked together and the first that's good
+	  // enough wins.
+
+	case STATE::SYNC:
+
+	  if(( my_verbose > 3 ) && 0 )
+	    std::cerr << "STATE::SYNC" << std::endl;
+
+	  { static const uint64_t syncCheck =
+	      ( uint64_t( _to_odd( BIT_SYNC_1 ))  <<  0 ) |
+	      ( uint64_t( _to_odd( BIT_SYNC_2 ))  <<  8 ) |
+	      ( uint64_t( _to_odd( CHAR_SYNC_1 )) << 16 ) |
+	      ( uint64_t( _to_odd( CHAR_SYNC_2 )) << 24 ) |
+	      ( uint64_t( _to_odd( SOH ))         << 32 );
+	    static const uint64_t word = 0xffffffffff;   /* 5*8=40 */
+
+	    const uint64_t w48  = m_state.syncForming | ( uint64_t( r ) << 40 );
+	    const int      have = m_state.syncBitsHave;
+	    const int      most =
+	      std::min( 8, m_state.syncBitsLim - m_state.syncBitsHave );
+
+	    unsigned hit = 0;
+
+	    for( int k = 1; k <= 8; ++k )
+	      hit |= unsigned( _count_bit_errors(( w48 >> k ) & word, syncCheck )
+			       <= m_state.errLim ) << ( k - 1 );
+
+	    // Only where there are 40 bits and no further than the
+	    // search goes.
+
+	    const int first = std::max( 1, 40 - have );
+
+	    hit &= ( 1u << most ) - 1;
+	    hit  = ( first > 8 ) ? 0 : ( hit & ~(( 1u << ( first - 1 )) - 1 ));
+
+	    if( my_verbose > 3 )
+	      for( int k = first; k <= most; ++k ) {
+		_dump_sync( syncCheck, ( w48 >> k ) & word );
+		if( hit & ( 1u << ( k - 1 )))
+		  break;
+	      }
+
+	    if( hit ) {
+
+	      // The formed word has less than some number of errors
+	      // and that is enough to declare SYNC and collect TXT.
+
+	      m_state.state = STATE::TXT;
+
+	      m_state.rawLen = 0;
+	      m_state.rawCrc = 0;
+
+	      _save( _to_odd( SOH ));
+
+	      return __builtin_ctz( hit ) + 1;
+	    }
+
+	    m_state.syncForming   = ( w48 >> most ) & word;
+	    m_state.syncBitsHave += most;
+
+	    // If the number of bits collected to search for the SYNC
+	    // words and SOH has been exhausted then start over.
+
+	    if( m_state.syncBitsHave >= m_state.syncBitsLim )
+	      m_state.state = STATE::HEADL;
+
+	    return most;
+
+	  }
+
+	  // Collect text characters until either an ETX or ETB character
+	  // is encountered or until the buffer fills. If the buffer fills
+	  // then discard the message.
+	  //
+	  // Clearly, if there is a bit error in ETX/ETB then it cannot be
+	  // absorbed. Need to fix that.
+
+	case STATE::TXT:
+
+	  if( my_verbose > 2 )
+	    std::cerr << "STATE::TXT size= "
+		      << m_state.rawLen
+		      << " + 1"
+		      << std::endl;
+
+	  // Save the character.
+
+	  _save( r );
+
+	  // If the buffer is full then reset the state machine.
+
+#define BMAX ( MODE_BYTES + ADDRESS_BYTES + ACK_NAK_BYTES +        \
+		   LABEL_BYTES + BLOCK_ID_BYTES + STX_BYTES +          \
+		   SEQ_NUM_BYTES + FLIGHT_NUM_BYTES + MAX_TEXT_BYTES + \
+		   ETX_BYTES )
+
+	  static_assert( SOH_BYTES + BMAX + 1 + CRC_BYTES <= MAX_MBLOCK_BYTES,
+			 "the longest message doesn't fit" );
+
+	  if(  m_state.rawLen > BMAX ) {
+
+	    m_state.state = STATE::HEADL;
+	    break;
+
+	  }
+
+	  // If it's an ETX or ETB then advance the state machine to
+	  // collect the CRC.
+
+	  if(( r == _to_odd( ETX )) || ( r == _to_odd( ETB ))) {
+
+	    m_state.state = STATE::CRC1;
+	    return 8;
+
+	  }
+
+	  return 8;
+
+	  // For the states CRC1 and CRC2 simply collect the CRC bytes.
+
+	case STATE::CRC1:
+
+	  if( my_verbose > 2 )
+	    std::cerr << "STATE::CRC1" << std::endl;
+
+	  _save( r );
+	  m_state.state = STATE::CRC2;
+
+	  return 8;
+
+	case STATE::CRC2:
+
+	  if( my_verbose > 2 )
+	    std::cerr << "STATE::CRC1" << std::endl;
+
+	  _save( r );
+	  m_state.state = STATE::END;
+
+	  return 8;
+
+	  // First, when the end state is reached then reset the state
+	  // machine.
+
+	case STATE::END:
+
+	  if( my_verbose > 2 )
+	    std::cerr << "STATE::END" << std::endl;
+
+	  // The next state is to start over.
+
+	  m_state.state = STATE::HEADL;
+
+	  // Check the CRC and, if it's off, try to correct it.
+
+	  { const uint16_t syndrome = m_state.rawCrc;
+	    int            corrected = 0;
+
+	    if( syndrome ) {
+
+	      ProfileScope prof( Stage::CRC_CORRECT, m_state.rawLen );
+
+	      corrected = ::crc_correct( m_state.rawText, m_state.rawLen,
+					 syndrome, my_correct );
+	    }
+
+	    if( corrected >= 0 ) {
+
+	      m_state.crc = 0;
+
+	      build_mesg( m_state.rawText, m_state.rawLen, msg );
+	      msg->crc = corrected;
+
+	      return -1;
+	    }
+	  }
+
+	  std::cerr << std::endl << "CRC check failure" << std::endl;
+#ifdef dpgdebug0
+	  { std::streamsize         width = std::cerr.width();
+	    std::ios_base::fmtflags flags = std::cerr.flags();
+	    char                    fill  = std::cerr.fill();
+
+	    for( size_t i = 0; i < m_state.rawLen; ++i )
+	      std::cerr << "0x" << std::hex << std::setfill('0') << std::setw(2)
+			<< unsigned( m_state.rawText[i])
+			<< std::dec
+			<< "(" << char(m_state.rawText[i]&0x7f ) << ") ";
+	    std::cerr << std::endl << std::endl;
+
+	    std::cerr.width( width );
+	    std::cerr.setf( flags );
+	    std::cerr.fill( fill );
+	  }
+#endif
+
+	  return 8;
+
+	}
+      } while( true );
+    }
+
+    void
+    AcarsDecoder::demod( const int16_t* sample, size_t n,
+			 std::vector<uint8_t>& bits ) {
+
+      for( size_t ind = 0; ind < n; ++ind )
+	if( _getbit( sample[ind], rl ))
+	  bits.push_back( rl >> 7 );
+
+    }
+
+    // Fill the chunk's VFO outputs: the half phase cosines and the
+    // full phase sines of both VFOs. The PLL's correction is taken
+    // from the end of the last chunk and held for this one.
+
+    void
+    AcarsDecoder::_vfo_chunk( size_t n ) {
+
+      float* const oh = bstat.osch.get();
+      float* const sh = bstat.snh.get();
+      float* const ol = bstat.oscl.get();
+      float* const sl = bstat.snl.get();
+
+      const float
+	steph = Freqh - ( VFOPLL * bstat.dfh ),
+	stepl = Freql - ( VFOPLL * bstat.dfl );
+
+      if( my_osc == Oscillator::LUT ) {
+
+	const uint32_t
+	  uh = _nco_step( steph ),
+	  ul = _nco_step( stepl );
+
+	for( size_t j = 0; j < n; ++j ) {
+
+	  bstat.uphih += uh;
+	  bstat.uphil += ul;
+
+	  oh[j] = _nco_cos( bstat.uphih );
+	  sh[j] = _nco_sin( bstat.uphih << 1 );
+	  ol[j] = _nco_cos( bstat.uphil );
+	  sl[j] = _nco_sin( bstat.uphil << 1 );
+	}
+
+      } else {
+
+	for( size_t j = 0; j < n; ++j ) {
+
+	  bstat.phih += steph;
+	  if( bstat.phih >= fourPI )
+	    bstat.phih -= fourPI;
+	  bstat.phil += stepl;
+	  if( bstat.phil >= fourPI )
+	    bstat.phil -= fourPI;
+
+	  oh[j] = std::cos( bstat.phih / 2.0 );
+	  sh[j] = std::sin( bstat.phih );
+	  ol[j] = std::cos( bstat.phil / 2.0 );
+	  sl[j] = std::sin( bstat.phil );
+	}
+      }
+    }
+
+    // The block bit former, handing emit() each symbol it forms.
+
+    template<typename F>
+    void
+    AcarsDecoder::_form( const int16_t* sample, size_t n, F emit ) {
+
+      float* const hl = bstat.hlin.get();
+      float* const ll = bstat.llin.get();
+      float* const il = bstat.ilin.get();
+      float* const ql = bstat.qlin.get();
+      float* const cl = bstat.clin.get();
+
+      float* const x   = bstat.x.get();
+      float* const lv  = bstat.lv.get();
+      float* const s   = bstat.s.get();
+      float* const s2  = bstat.s2.get();
+      float* const tmp = bstat.tmp.get();
+
+      while( n ) {
+
+	const size_t k = std::min( n, size_t( DEMOD_CHUNK ));
+
+	// Normalize. The level tracker is a one pole filter so it
+	// stays serial, but it is only a multiply-add.
+
+	volk_16i_s32f_convert_32f( x, sample, 1.0, k );
+
+	for( size_t j = 0; j < k; ++j ) {
+
+	  assert( x[j] >= 0 );
+
+	  bstat.lin = ( 0.003 * x[j] ) + ( 0.997 * bstat.lin );
+	  lv[j] = bstat.lin;
+	}
+
+	volk_32f_x2_divide_32f(   s,  x, lv, k );
+	volk_32f_x2_multiply_32f( s2, s, s,  k );
+
+	/* VFOs and mix, into the history after the last BITLEN */
+
+	_vfo_chunk( k );
+
+	volk_32f_x2_multiply_32f( hl + BITLEN, s2, bstat.snh.get(), k );
+	volk_32f_x2_multiply_32f( ll + BITLEN, s2, bstat.snl.get(), k );
+
+	volk_32f_x2_add_32f(      tmp, bstat.oscl.get(), bstat.osch.get(), k );
+	volk_32f_x2_multiply_32f( il + BITLEN, s, tmp, k );
+	volk_32f_x2_subtract_32f( tmp, bstat.oscl.get(), bstat.osch.get(), k );
+	volk_32f_x2_multiply_32f( ql + BITLEN, s, tmp, k );
+	volk_32f_x2_multiply_32f( cl + BITLEN,
+				  bstat.oscl.get(), bstat.osch.get(), k );
+
+	/* bit clock */
+
+	for( size_t j = 0; j < k; ++j ) {
+
+	  const size_t q = BITLEN + j;
+
+	  bstat.hsum += hl[q] - hl[q - BITLEN / 2];
+	  bstat.lsum += ll[q] - ll[q - BITLEN / 2];
+	  bstat.isum += il[q] - il[q - BITLEN];
+	  bstat.qsum += ql[q] - ql[q - BITLEN];
+
+	  if( ++bstat.clock >= ( BITLEN/4 + bstat.ea )) {
+
+	    bstat.clock = 0;
+
+	    float   C;
+	    uint8_t sym;
+
+	    volk_32f_x2_dot_prod_32f( &C, cl + q + 1 - BITLEN, hr.get(),
+				      BITLEN );
+
+	    if( _bit_clock( C, sym ))
+	      emit( sym );
+	  }
+	}
+
+	// Slide the newest BITLEN to the front and recompute the sums
+	// from them, so rounding can't build up.
+
+	memmove( hl, hl + k, BITLEN * sizeof( float ));
+	memmove( ll, ll + k, BITLEN * sizeof( float ));
+	memmove( il, il + k, BITLEN * sizeof( float ));
+	memmove( ql, ql + k, BITLEN * sizeof( float ));
+	memmove( cl, cl + k, BITLEN * sizeof( float ));
+
+	float sum;
+
+	volk_32f_accumulator_s32f( &sum, hl + BITLEN / 2, BITLEN / 2 );
+	bstat.hsum = sum;
+	volk_32f_accumulator_s32f( &sum, ll + BITLEN / 2, BITLEN / 2 );
+	bstat.lsum = sum;
+	volk_32f_accumulator_s32f( &sum, il, BITLEN );
+	bstat.isum = sum;
+	volk_32f_accumulator_s32f( &sum, ql, BITLEN );
+	bstat.qsum = sum;
+
+	bstat.dfh = float( bstat.hsum );
+	bstat.dfl = float( bstat.lsum );
+
+	sample += k;
+	n      -= k;
+      }
+    }
+
+    void
+    AcarsDecoder::demod_block( const int16_t* sample, size_t n,
+			       BitSink& sink ) {
+
+      _form( sample, n, [&]( uint8_t sym ) { sink.bit( _polarize( sym )); } );
+
+    }
+
+    // Run the message state machine over the bits that are waiting
+    // for as long as it can take a character's worth.
+
+    void
+    AcarsDecoder::_frame( void ) {
+
+      while( nfbits >= 8 ) {
+
+	msg_t msgl;
+	int   bitsConsumed;
+
+	{ ProfileScope prof( Stage::GETMESG, nfbits );
+
+	  bitsConsumed = _getmesg( fbits, nfbits, &msgl );
+	}
+
+	if( bitsConsumed == -1 ) {
+
+	  msgl.rx_idx = rx_idx++;
+	  my_callback( msgl );
+	  bitsConsumed = 8;
+	}
+
+	fbits    = ( bitsConsumed == 64 ) ? 0 : ( fbits >> bitsConsumed );
+	nfbits  -= bitsConsumed;
+      }
+
+      my_in_message.store( m_state.state != STATE::HEADL,
+			   std::memory_order_relaxed );
+
+    }
+
+    // Pack a bit into the message state machine's register and run
+    // the machine a register at a time. Looking for the PRE-KEY it has
+    // to run at every bit, though: each character that isn't one
+    // resets the polarities, and that has to happen before the next
+    // bit is polarized.
+
+    inline void
+    AcarsDecoder::_take_bit( const uint8_t b ) {
+
+      fbits |= uint64_t( b ) << nfbits;
+
+      if(( ++nfbits == 64 ) ||
+	 (( nfbits >= 8 ) && ( m_state.state == STATE::HEADL )))
+	_frame();
+
+    }
+
+    void
+    AcarsDecoder::push( const int16_t* sample, size_t n ) {
+
+      // The bit former's time includes the message state machine's,
+      // which is also counted on its own.
+
+      ProfileScope prof( Stage::GETBIT, n );
+
+      if( my_symbols ) {
+	_form( sample, n, [this]( uint8_t sym ) { my_symbols->push_back( sym ); } );
+	return;
+      }
+
+      _form( sample, n, [this]( uint8_t sym ) { _take_bit( _polarize( sym )); } );
+      _frame();
+
+    }
+
+    void
+    AcarsDecoder::frame( const uint8_t* symbols, size_t n ) {
+
+      for( size_t i = 0; i < n; ++i )
+	_take_bit( _polarize( symbols[i] ));
+
+      _frame();
+
+    }
+
+  }
+}
+
+
+//  LocalWords:  PRE SOH ETX ETB CRC GNURadio ACARS
@@ -0,0 +1,259 @@
+/* -*- c++ -*- */
+
+/*
+ * Copyright 2016 Dennis Glatting
+ *
+ *
+ * A polyphase decimating FIR for the narrowband front end.
+ *
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ *
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <string>
+
+#if defined( __SSE2__ )
+#include <emmintrin.h>
+#elif defined( __ARM_NEON ) || defined( __ARM_NEON__ )
+#include <arm_neon.h>
+#endif
+
+#include <acars/fir.h>
+
+
+static const std::string my_ident = "$Id: fir.cc,v 1.1 2016/07/16 22:31:40 dennisg Exp $";
+
+
+namespace gr {
+  namespace acars {
+
+    // The taps are Q14. A tap is at most twice the cutoff over the
+    // output rate, well under one, and the sums of 8 bit samples
+    // times them fit in 32 bits for any decimation I'd use.
+
+    static const int Q = 14;
+
+    // The I and Q sums of n (a multiple of 8) samples times the taps.
+
+    static inline void
+    _dot( const int16_t* r, const int16_t* j, const int16_t* h, size_t n,
+	  int& sum_r, int& sum_j ) noexcept {
+
+#if defined( __SSE2__ )
+
+      __m128i acc_r = _mm_setzero_si128();
+      __m128i acc_j = _mm_setzero_si128();
+
+      for( size_t i = 0; i < n; i += 8 ) {
+
+	const __m128i t = _mm_loadu_si128( reinterpret_cast<const __m128i*>( h + i ));
+
+	acc_r = _mm_add_epi32( acc_r, _mm_madd_epi16
+			       ( _mm_loadu_si128( reinterpret_cast<const __m128i*>( r + i )), t ));
+	acc_j = _mm_add_epi32( acc_j, _mm_madd_epi16
+			       ( _mm_loadu_si128( reinterpret_cast<const __m128i*>( j + i )), t ));
+      }
+
+      acc_r = _mm_add_epi32( acc_r, _mm_shuffle_epi32( acc_r, 0x4e ));
+      acc_r = _mm_add_epi32( acc_r, _mm_shuffle_epi32( acc_r, 0xb1 ));
+      acc_j = _mm_add_epi32( acc_j, _mm_shuffle_epi32( acc_j, 0x4e ));
+      acc_j = _mm_add_epi32( acc_j, _mm_shuffle_epi32( acc_j, 0xb1 ));
+
+      sum_r = _mm_cvtsi128_si32( acc_r );
+      sum_j = _mm_cvtsi128_si32( acc_j );
+
+#elif defined( __ARM_NEON ) || defined( __ARM_NEON__ )
+
+      int32x4_t acc_r = vdupq_n_s32( 0 );
+      int32x4_t acc_j = vdupq_n_s32( 0 );
+
+      for( size_t i = 0; i < n; i += 8 ) {
+
+	const int16x8_t t = vld1q_s16( h + i );
+	const int16x8_t x = vld1q_s16( r + i );
+	const int16x8_t y = vld1q_s16( j + i );
+
+	acc_r = vmlal_s16( acc_r, vget_low_s16( x ),  vget_low_s16( t ));
+	acc_r = vmlal_s16( acc_r, vget_high_s16( x ), vget_high_s16( t ));
+	acc_j = vmlal_s16( acc_j, vget_low_s16( y ),  vget_low_s16( t ));
+	acc_j = vmlal_s16( acc_j, vget_high_s16( y ), vget_high_s16( t ));
+      }
+
+      const int32x2_t s_r = vpadd_s32( vget_low_s32( acc_r ), vget_high_s32( acc_r ));
+      const int32x2_t s_j = vpadd_s32( vget_low_s32( acc_j ), vget_high_s32( acc_j ));
+
+      sum_r = vget_lane_s32( vpadd_s32( s_r, s_r ), 0 );
+      sum_j = vget_lane_s32( vpadd_s32( s_j, s_j ), 0 );
+
+#else
+
+      sum_r = 0;
+      sum_j = 0;
+
+      for( size_t i = 0; i < n; ++i ) {
+	sum_r += int( r[i] ) * h[i];
+	sum_j += int( j[i] ) * h[i];
+      }
+
+#endif
+
+    }
+
+    // n pairs of IQ bytes into I and Q less 127.
+
+    static inline void
+    _split( const uint8_t* iq, size_t n, int16_t* r, int16_t* j ) noexcept {
+
+      size_t k = 0;
+
+#if defined( __SSE2__ )
+
+      const __m128i low  = _mm_set1_epi16( 0xff );
+      const __m128i bias = _mm_set1_epi16( 127 );
+
+      for( ; k + 8 <= n; k += 8 ) {
+
+	const __m128i x = _mm_loadu_si128( reinterpret_cast<const __m128i*>( iq + 2 * k ));
+
+	_mm_storeu_si128( reinterpret_cast<__m128i*>( r + k ),
+			  _mm_sub_epi16( _mm_and_si128( x, low ), bias ));
+	_mm_storeu_si128( reinterpret_cast<__m128i*>( j + k ),
+			  _mm_sub_epi16( _mm_srli_epi16( x, 8 ), bias ));
+      }
+
+#elif defined( __ARM_NEON ) || defined( __ARM_NEON__ )
+
+      const int16x8_t bias = vdupq_n_s16( 127 );
+
+      for( ; k + 8 <= n; k += 8 ) {
+
+	const uint8x8x2_t x = vld2_u8( iq + 2 * k );
+
+	vst1q_s16( r + k, vsubq_s16( vreinterpretq_s16_u16( vmovl_u8( x.val[0] )), bias ));
+	vst1q_s16( j + k, vsubq_s16( vreinterpretq_s16_u16( vmovl_u8( x.val[1] )), bias ));
+      }
+
+#endif
+
+      for( ; k < n; ++k ) {
+	r[k] = int16_t( iq[ 2 * k ]     - 127 );
+	j[k] = int16_t( iq[ 2 * k + 1 ] - 127 );
+      }
+
+    }
+
+    Decimator::Decimator( int the_decimation, int the_taps, double the_rate,
+			  double the_cutoff )
+      : my_decimation( std::max( the_decimation, 1 )), my_rate( the_rate ),
+	my_n( 0 ), my_phase( 0 ) {
+
+      const size_t n  = size_t( std::max( the_taps, 1 )) * my_decimation;
+      const double fc = the_cutoff / the_rate;
+      const double m  = 0.5 * ( n - 1 );
+
+      std::vector<double> h( n );
+      double              sum = 0.0;
+
+      for( size_t k = 0; k < n; ++k ) {
+
+	const double x = k - m;
+	const double a = 2.0 * M_PI * ( k + 1 ) / ( n + 1 );
+
+	h[k]  = ( x == 0.0 ) ? 2.0 * fc : sin( 2.0 * M_PI * fc * x ) / ( M_PI * x );
+	h[k] *= 0.42 - 0.5 * cos( a ) + 0.08 * cos( 2.0 * a );
+
+	sum += h[k];
+      }
+
+      // The oldest sample is first in the window, so the taps are
+      // stored back to front, with the padding in front.
+
+      my_n = ( n + 7 ) & ~size_t( 7 );
+      my_h.assign( my_n, 0 );
+
+      for( size_t k = 0; k < n; ++k )
+	my_h[ my_n - 1 - k ] =
+	  int16_t( lround( h[k] * my_decimation / sum * ( 1 << Q )));
+
+      my_r.assign( my_n - 1 + FIR_CHUNK, 0 );
+      my_j.assign( my_n - 1 + FIR_CHUNK, 0 );
+
+    }
+
+    size_t
+    Decimator::push( const uint8_t* iq, size_t len, int* out ) {
+
+      const size_t hist  = my_n - 1;
+      size_t       n_out = 0;
+
+      for( size_t off = 0; off + 2 <= len; off += 2 * FIR_CHUNK ) {
+
+	const size_t   n = std::min(( len - off ) / 2, size_t( FIR_CHUNK ));
+	const uint8_t* p = iq + off;
+	int16_t*       r = my_r.data() + hist;
+	int16_t*       j = my_j.data() + hist;
+
+	_split( p, n, r, j );
+
+	// Sample k of the chunk ends a sum when it's the decimation'th
+	// since the last; the window that ends with it starts at k in
+	// the buffer.
+
+	for( size_t k = my_decimation - my_phase - 1; k < n;
+	     k += my_decimation ) {
+
+	  int sum_r, sum_j;
+
+	  _dot( my_r.data() + k, my_j.data() + k, my_h.data(), my_n,
+		sum_r, sum_j );
+
+	  out[ 2 * n_out ]     = ( sum_r + ( 1 << ( Q - 1 ))) >> Q;
+	  out[ 2 * n_out + 1 ] = ( sum_j + ( 1 << ( Q - 1 ))) >> Q;
+	  ++n_out;
+	}
+
+	my_phase = int(( my_phase + n ) % my_decimation );
+
+	std::copy( my_r.begin() + n, my_r.begin() + n + hist, my_r.begin());
+	std::copy( my_j.begin() + n, my_j.begin() + n + hist, my_j.begin());
+      }
+
+      return n_out;
+    }
+
+    double
+    Decimator::response( double the_hz ) const {
+
+      std::complex<double> h( 0.0, 0.0 );
+      double               dc = 0.0;
+
+      for( size_t k = 0; k < my_n; ++k ) {
+	h  += double( my_h[k] ) * std::polar( 1.0, 2.0 * M_PI * the_hz * k / my_rate );
+	dc += my_h[k];
+      }
+
+      return 20.0 * log10( std::max( std::abs( h ) / dc, 1e-12 ));
+    }
+
+  }
+}
+
+
+//  LocalWords:  FIR Blackman sinc IQ NEON SSE
@@ -0,0 +1,205 @@
+/* -*- c++ -*- */
+
+/*
+ * Copyright 2016 Dennis Glatting
+ *
+ *
+ * The narrowband front end in one pass: IQ bytes in, the AM envelope
+ * at Fe out.
+ *
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ *
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+extern "C" {
+
+#include <stdint.h>
+
+}
+
+#if defined( __SSE2__ )
+#include <emmintrin.h>
+#elif defined( __ARM_NEON ) || defined( __ARM_NEON__ )
+#include <arm_neon.h>
+#endif
+
+#include <acars/frontend.h>
+#include <acars/profile.h>
+
+
+static const std::string my_ident = "$Id: frontend.cc,v 1.1 2016/07/16 01:40:02 dennisg Exp $";
+
+
+namespace gr {
+  namespace acars {
+
+    // Turn n bytes (a multiple of 8) of IQ by a quarter of the rate
+    // into signed 16 bit pairs, as rotate_90() and the subtraction in
+    // low_pass() do. In each group of four pairs the second and the
+    // fourth swap I and Q and the bytes marked below are inverted
+    // (255 - x); then everything has 127 taken off.
+
+    static const uint8_t invert[8] = { 0, 0, 0xff, 0, 0xff, 0xff, 0, 0xff };
+
+    static inline void
+    _turn( const uint8_t* in, size_t n, int16_t* rj ) noexcept {
+
+      size_t i = 0;
+
+#if defined( __SSE2__ )
+
+      const __m128i keep = _mm_set_epi16( 0, -1, 0, -1, 0, -1, 0, -1 );
+      const __m128i inv  = _mm_set_epi8( -1, 0, -1, -1, 0, -1, 0, 0,
+					 -1, 0, -1, -1, 0, -1, 0, 0 );
+      const __m128i bias = _mm_set1_epi16( 127 );
+      const __m128i zero = _mm_setzero_si128();
+
+      for( ; i + 16 <= n; i += 16 ) {
+
+	__m128i x  = _mm_loadu_si128( reinterpret_cast<const __m128i*>( in + i ));
+	__m128i sw = _mm_or_si128( _mm_slli_epi16( x, 8 ), _mm_srli_epi16( x, 8 ));
+
+	x = _mm_or_si128( _mm_and_si128( keep, x ), _mm_andnot_si128( keep, sw ));
+	x = _mm_xor_si128( x, inv );
+
+	_mm_storeu_si128( reinterpret_cast<__m128i*>( rj + i ),
+			  _mm_sub_epi16( _mm_unpacklo_epi8( x, zero ), bias ));
+	_mm_storeu_si128( reinterpret_cast<__m128i*>( rj + i + 8 ),
+			  _mm_sub_epi16( _mm_unpackhi_epi8( x, zero ), bias ));
+      }
+
+#elif defined( __ARM_NEON ) || defined( __ARM_NEON__ )
+
+      static const uint8_t keep_bytes[16] = {
+	0xff, 0xff, 0, 0, 0xff, 0xff, 0, 0, 0xff, 0xff, 0, 0, 0xff, 0xff, 0, 0
+      };
+
+      const uint8x16_t keep = vld1q_u8( keep_bytes );
+      const uint8x16_t inv  = vcombine_u8( vld1_u8( invert ), vld1_u8( invert ));
+      const int16x8_t  bias = vdupq_n_s16( 127 );
+
+      for( ; i + 16 <= n; i += 16 ) {
+
+	uint8x16_t x = vld1q_u8( in + i );
+
+	x = veorq_u8( vbslq_u8( keep, x, vrev16q_u8( x )), inv );
+
+	vst1q_s16( rj + i,
+		   vsubq_s16( vreinterpretq_s16_u16( vmovl_u8( vget_low_u8( x ))),
+			      bias ));
+	vst1q_s16( rj + i + 8,
+		   vsubq_s16( vreinterpretq_s16_u16( vmovl_u8( vget_high_u8( x ))),
+			      bias ));
+      }
+
+#endif
+
+      // An inverted byte less 127 is 128 less the byte.
+
+      for( ; i < n; i += 8 ) {
+	rj[ i     ] = int16_t( in[ i     ] - 127 );
+	rj[ i + 1 ] = int16_t( in[ i + 1 ] - 127 );
+	rj[ i + 2 ] = int16_t( 128 - in[ i + 3 ] );
+	rj[ i + 3 ] = int16_t( in[ i + 2 ] - 127 );
+	rj[ i + 4 ] = int16_t( 128 - in[ i + 4 ] );
+	rj[ i + 5 ] = int16_t( 128 - in[ i + 5 ] );
+	rj[ i + 6 ] = int16_t( in[ i + 7 ] - 127 );
+	rj[ i + 7 ] = int16_t( 128 - in[ i + 6 ] );
+      }
+
+    }
+
+    // am_demod() of one sum, saturated.
+
+    static inline int16_t
+    _magnitude( int r, int j, int scale ) noexcept {
+
+      const int m = int( sqrt( double( r * r + j * j )));
+
+      return int16_t( std::min( m * scale * 8, int( INT16_MAX )));
+    }
+
+    size_t
+    am_front_end( const uint8_t* buf, size_t len,
+		  int downsample, int scale,
+		  int& now_r, int& now_j, int& prev_index,
+		  int16_t* out ) noexcept {
+
+      ProfileScope prof( Stage::FRONT_END, len / 2 );
+
+      int16_t rj[ 2 * FRONT_END_CHUNK ];
+      size_t  n_out = 0;
+      int     seq   = 0;
+
+      for( size_t off = 0; off < len; off += 2 * FRONT_END_CHUNK ) {
+
+	const size_t n = std::min( len - off, size_t( 2 * FRONT_END_CHUNK ));
+
+	_turn( buf + off, n, rj );
+
+	// Sum a run of pairs at a time, up to the end of the current
+	// sum or of the chunk.
+
+	const int16_t* p    = rj;
+	size_t         left = n / 2;
+
+	while( left ) {
+
+	  const size_t run = std::min( left, size_t( downsample - prev_index ));
+	  int          r   = now_r;
+	  int          j   = now_j;
+
+	  for( size_t k = 0; k < run; ++k ) {
+	    r += p[ 2 * k ];
+	    j += p[ 2 * k + 1 ];
+	  }
+
+	  p          += 2 * run;
+	  left       -= run;
+	  prev_index += int( run );
+
+	  if( prev_index < downsample ) {
+	    now_r = r;
+	    now_j = j;
+	    break;
+	  }
+
+	  if(( seq++ % 2 ) == 1 ) {
+	    r = ( r * 5 ) / 8;
+	    j = ( j * 5 ) / 8;
+	  }
+
+	  out[ n_out++ ] = _magnitude( r, j, scale );
+
+	  now_r      = 0;
+	  now_j      = 0;
+	  prev_index = 0;
+	}
+      }
+
+      return n_out;
+    }
+
+  }
+}
+
+
+//  LocalWords:  IQ NEON SSE
@@ -0,0 +1,174 @@
+/* -*- c++ -*- */
+
+/*
+ * Copyright 2016 Dennis Glatting
+ *
+ *
+ * A squelch gate in front of a decoder.
+ *
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ *
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+#include <acars/gate.h>
+
+
+static const std::string my_ident = "$Id: gate.cc,v 1.1 2016/07/17 19:05:52 dennisg Exp $";
+
+
+namespace gr {
+  namespace acars {
+
+    // Windows (2 s) after which an open gate's floor follows again.
+
+    static const int max_open = 400;
+
+    static_assert(( GATE_LOOKBACK % GATE_WINDOW ) == 0,
+		  "the look-back is whole windows" );
+
+    SquelchGate::SquelchGate( AcarsDecoder& the_decoder, double the_open_db )
+      : my_decoder( the_decoder ),
+	my_open( pow( 10.0, the_open_db / 10.0 )),
+	my_close( pow( 10.0, the_open_db / 20.0 )),
+	my_floor( -1.0 ), my_is_open( false ), my_quiet( 0 ),
+	my_windows( 0 ),
+	my_window( GATE_WINDOW ), my_fill( 0 ), my_sum( 0.0 ),
+	my_back( GATE_LOOKBACK ), my_back_pos( 0 ), my_back_new( 0 ),
+	my_seen( 0 ), my_passed( 0 ), my_live( 0 ) {
+    }
+
+    void
+    SquelchGate::_pass( const int16_t* samples, size_t n ) {
+
+      if( n == 0 )
+	return;
+
+      my_decoder.push( samples, n );
+      my_passed += n;
+
+    }
+
+    void
+    SquelchGate::push( const int16_t* samples, size_t n ) {
+
+      my_seen += n;
+
+      while( n ) {
+
+	const size_t k = std::min( n, size_t( GATE_WINDOW ) - my_fill );
+
+	for( size_t i = 0; i < k; ++i )
+	  my_sum += double( samples[i] ) * samples[i];
+
+	std::copy( samples, samples + k, my_window.begin() + my_fill );
+
+	if( my_is_open ) {
+	  _pass( samples, k );
+	  my_live += k;
+	}
+
+	my_fill += k;
+	samples += k;
+	n       -= k;
+
+	if( my_fill == GATE_WINDOW )
+	  _window();
+      }
+
+    }
+
+    void
+    SquelchGate::_window( void ) {
+
+      const double level  = my_sum / GATE_WINDOW;
+      const bool   passed = my_is_open;
+      const bool   first  = ( my_floor < 0.0 );
+
+      auto follow = [&] {
+	my_floor += ( level - my_floor ) * (( level < my_floor ) ? 0.25 : 1.0 / 32 );
+	my_floor  = std::max( my_floor, 1.0 );
+      };
+
+      if( first )
+	my_floor = std::max( level, 1.0 );
+
+      if( !my_is_open ) {
+
+	if( level > my_floor * my_open ) {
+
+	  // The look-back is oldest first from where the next window
+	  // would go, and only what the decoder hasn't had: when the
+	  // gate closed moments ago the rest is the end of the last
+	  // burst, which it has. The decoder isn't reset: resetting its
+	  // level and VFOs cost a message or two in 25 in the SNR sweep,
+	  // and a message it was in the middle of can't survive 40 ms of
+	  // nothing anyway.
+
+	  const size_t from =
+	    ( my_back_pos + GATE_LOOKBACK - my_back_new ) % GATE_LOOKBACK;
+	  const size_t wrap =
+	    std::min( my_back_new, size_t( GATE_LOOKBACK ) - from );
+
+	  my_is_open = true;
+	  my_quiet   = 0;
+	  my_windows = 0;
+
+	  _pass( my_back.data() + from, wrap );
+	  _pass( my_back.data(), my_back_new - wrap );
+	  _pass( my_window.data(), GATE_WINDOW );
+	  my_live += GATE_WINDOW;
+
+	} else
+	  follow();
+
+      } else {
+
+	if( ++my_windows > max_open )
+	  follow();
+
+	if( level < my_floor * my_close ) {
+	  if( ++my_quiet >= GATE_HOLD )
+	    my_is_open = false;
+	} else
+	  my_quiet = 0;
+      }
+
+      std::copy( my_window.begin(), my_window.end(),
+		 my_back.begin() + my_back_pos );
+
+      // The first window only sets the floor, and the front end is
+      // still filling its filters in it; replayed, it cost the first
+      // message in the SNR sweep at 20 dB.
+
+      my_back_pos = ( my_back_pos + GATE_WINDOW ) % GATE_LOOKBACK;
+      my_back_new = ( passed || my_is_open || first ) ? 0 :
+	std::min( my_back_new + GATE_WINDOW, size_t( GATE_LOOKBACK ));
+
+      my_fill = 0;
+      my_sum  = 0.0;
+
+    }
+
+  }
+}
+
+
+//  LocalWords:  pre
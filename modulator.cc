@@ -0,0 +1,205 @@
+/* -*- c++ -*- */
+
+/*
+ * Copyright 2016 Dennis Glatting
+ *
+ *
+ * A synthetic ACARS transmitter, for testing the receiver.
+ *
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ *
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+#include <acars/crc.h>
+#include <acars/decoder.h>
+#include <acars/modulator.h>
+#include <acars/sin.h>
+#include <acars/utility.h>
+
+
+static const std::string my_ident = "$Id: modulator.cc,v 1.1 2016/07/15 04:12:37 dennisg Exp $";
+
+
+namespace gr {
+  namespace acars {
+
+    // The carrier's amplitude, how deeply the MSK modulates it, and
+    // the counts a unit amplitude is in the IQ. That's a quiet
+    // signal, but am_demod() scales the sum of the decimated samples
+    // up and much more overflows it, noise and all, at the bottom of
+    // the SNR sweep.
+
+    static constexpr double carrier = 0.5;
+    static constexpr double depth   = 0.5;
+    static constexpr double counts  = 8.0;
+
+    Modulator::Modulator( double the_rate, uint32_t the_seed )
+      : my_rate( the_rate ), my_sigma( 0.0 ), my_offset( 0.0 ),
+	my_drift( 0.0 ),
+	my_spb( size_t( lround( the_rate / BIT_RATE ))),
+	my_l0( L0( my_spb )), my_l1( L1( my_spb )),
+	my_h0( H0( my_spb )), my_h1( H1( my_spb )),
+	my_rng( the_seed ), my_noise( 0.0, 1.0 ),
+	my_phase( 0.0 ), my_n( 0 ) {
+
+      snr( 30.0 );
+
+    }
+
+    void
+    Modulator::snr( double the_db ) {
+
+      // The noise is white across the capture rate, so only Fe / rate
+      // of its power is left after decimation.
+
+      my_sigma = sqrt( carrier * carrier * my_rate /
+		       ( 2.0 * Fe * pow( 10.0, the_db / 10.0 )));
+
+    }
+
+    void
+    Modulator::offset( double the_hz ) noexcept {
+
+      my_offset = twoPI * the_hz / my_rate;
+    }
+
+    // One sample of the envelope: turned by the carrier offset, noise
+    // added, and turned by a quarter of the rate (e^-j(pi/2)n).
+
+    void
+    Modulator::_emit( double a, std::vector<uint8_t>& iq ) {
+
+      double i = a * cos( my_phase ) + my_sigma * my_noise( my_rng );
+      double q = a * sin( my_phase ) + my_sigma * my_noise( my_rng );
+      double t;
+
+      my_phase = fmod( my_phase + my_offset, twoPI );
+
+      switch( my_n++ & 3 ) {
+      case 1: t = i; i =  q; q = -t; break;
+      case 2:        i = -i; q = -q; break;
+      case 3: t = i; i = -q; q =  t; break;
+      }
+
+      iq.push_back( uint8_t( std::min( 255.0, std::max( 0.0, round( 127.5 + i * counts )))));
+      iq.push_back( uint8_t( std::min( 255.0, std::max( 0.0, round( 127.5 + q * counts )))));
+
+    }
+
+    void
+    Modulator::silence( double seconds, std::vector<uint8_t>& iq ) {
+
+      const size_t n = size_t( seconds * my_rate );
+
+      iq.reserve( iq.size() + 2 * n );
+
+      for( size_t k = 0; k < n; ++k )
+	_emit( 0.0, iq );
+
+    }
+
+    std::vector<uint8_t>
+    Modulator::frame( const msg_t& msg ) {
+
+      std::vector<uint8_t> f( MOD_PREKEY_BYTES, PRE_KEY_CHAR );
+
+      for( uint8_t c : { BIT_SYNC_1, BIT_SYNC_2, CHAR_SYNC_1, CHAR_SYNC_2 })
+	f.push_back( _to_odd( c ));
+
+      const size_t soh = f.size();
+
+      auto field = [&]( const unsigned char* s, size_t n ) {
+	for( size_t i = 0; ( i < n ) && s[i]; ++i )
+	  f.push_back( _to_odd( s[i] ));
+      };
+
+      f.push_back( _to_odd( SOH ));
+      field( &msg.mode, 1 );
+      field( msg.addr, 7 );
+      field( &msg.ack, 1 );
+      field( msg.label, 2 );
+      field( &msg.bid, 1 );
+      f.push_back( _to_odd( STX ));
+      field( msg.no, 4 );
+      field( msg.fid, 6 );
+      field( reinterpret_cast<const unsigned char*>( msg.txt ),
+	     MAX_TEXT_BYTES );
+      f.push_back( _to_odd( ETX ));
+
+      const uint16_t crc = gen_crc( f.cbegin() + soh, f.cend());
+
+      f.push_back( uint8_t( crc ));
+      f.push_back( uint8_t( crc >> 8 ));
+      f.push_back( _to_odd( DEL ));
+
+      return f;
+    }
+
+    // The bits go least significant first. A bit the same as the one
+    // before is a full cycle of 2400 Hz and a different one half a
+    // cycle of 1200 Hz, which turns the wave over; the templates come
+    // in both polarities so the wave stays continuous.
+    //
+    // Each bit's template is stretched or squeezed (nearest sample)
+    // to where the transmitter's clock puts the bit's end, which is
+    // how a clock that's off by a little looks to the receiver.
+
+    void
+    Modulator::burst( const msg_t& msg, std::vector<uint8_t>& iq ) {
+
+      const std::vector<uint8_t> chars = frame( msg );
+      const double               spb   =
+	my_rate / ( BIT_RATE * ( 1.0 + my_drift * 1e-6 ));
+
+      bool     prev = true;
+      bool     up   = true;
+      uint64_t n    = 0;
+      size_t   b    = 0;
+
+      iq.reserve( iq.size() + 2 * size_t( chars.size() * 8 * spb + 1 ));
+
+      for( uint8_t c : chars )
+	for( int k = 0; k < 8; ++k, ++b ) {
+
+	  const bool bit = ( c >> k ) & 1;
+
+	  const BufferVOLK<lv_32fc_t>& shape = ( bit == prev ) ?
+	    ( up ? my_h1 : my_h0 ) : ( up ? my_l0 : my_l1 );
+
+	  if( bit != prev )
+	    up = !up;
+	  prev = bit;
+
+	  const uint64_t end = uint64_t( llround(( b + 1 ) * spb ));
+	  const uint64_t len = end - n;
+
+	  for( uint64_t j = 0; j < len; ++j, ++n )
+	    _emit( carrier * ( 1.0 + depth *
+			       shape[ int( j * my_spb / len ) ].real()), iq );
+	}
+
+    }
+
+  }
+}
+
+
+//  LocalWords:  MSK IQ SOH ETX CRC DEL
@@ -0,0 +1,197 @@
+/* -*- c++ -*- */
+
+/*
+ * Copyright 2016 Dennis Glatting
+ *
+ *
+ * A small work stealing thread pool.
+ *
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ *
+ */
+
+#include <algorithm>
+#include <string>
+
+#include <acars/pool.h>
+
+
+static const std::string my_ident = "$Id: pool.cc,v 1.1 2016/07/21 02:14:37 dennisg Exp $";
+
+
+namespace gr {
+  namespace acars {
+
+    WorkPool::WorkPool( int the_workers )
+      : my_pending( 0 ), my_stop( false ), my_deal( 0 ), my_steals( 0 ) {
+
+      const size_t n = size_t( std::max( the_workers, 1 ));
+
+      for( size_t i = 0; i < n; ++i )
+	my_queues.emplace_back( new Queue );
+
+      for( size_t i = 0; i < n; ++i )
+	my_threads.emplace_back( &WorkPool::_worker, this, i );
+
+    }
+
+    WorkPool::~WorkPool( void ) {
+
+      {
+	std::lock_guard<std::mutex> l( my_lock );
+	my_stop = true;
+      }
+      my_wake.notify_all();
+
+      for( auto& t : my_threads )
+	t.join();
+
+    }
+
+    // Take a job: the newest off the home queue, or the oldest off
+    // the first other queue that has one.
+
+    bool
+    WorkPool::_take( size_t the_home, Job& the_job ) {
+
+      if( my_pending.load( std::memory_order_acquire ) == 0 )
+	return false;
+
+      const size_t n = my_queues.size();
+
+      for( size_t k = 0; k < n; ++k ) {
+
+	Queue& q = *my_queues[ ( the_home + k ) % n ];
+
+	std::lock_guard<std::mutex> l( q.lock );
+
+	if( q.jobs.empty())
+	  continue;
+
+	if( k == 0 ) {
+	  the_job = q.jobs.back();
+	  q.jobs.pop_back();
+	} else {
+	  the_job = q.jobs.front();
+	  q.jobs.pop_front();
+	  my_steals.fetch_add( 1, std::memory_order_relaxed );
+	}
+
+	my_pending.fetch_sub( 1, std::memory_order_acq_rel );
+
+	return true;
+      }
+
+      return false;
+    }
+
+    // The batch's lock is held while left is counted down, and the
+    // caller takes it before it returns, so the batch isn't gone
+    // before this is done with it.
+
+    void
+    WorkPool::_finish( Job& the_job ) {
+
+      std::lock_guard<std::mutex> l( the_job.batch->lock );
+
+      if( --the_job.batch->left == 0 )
+	the_job.batch->done.notify_all();
+
+    }
+
+    void
+    WorkPool::_worker( size_t the_home ) {
+
+      for( ;; ) {
+
+	Job job;
+
+	if( _take( the_home, job )) {
+	  ( *job.task )();
+	  _finish( job );
+	  continue;
+	}
+
+	std::unique_lock<std::mutex> l( my_lock );
+
+	my_wake.wait( l, [this] {
+	    return my_stop || ( my_pending.load( std::memory_order_acquire ) > 0 );
+	  });
+
+	if( my_stop && ( my_pending.load( std::memory_order_acquire ) == 0 ))
+	  return;
+      }
+
+    }
+
+    void
+    WorkPool::run( std::vector<Task>& the_tasks ) {
+
+      if( the_tasks.empty())
+	return;
+
+      Batch batch;
+
+      batch.left = the_tasks.size();
+
+      // Deal the tasks out starting one queue on from where the last
+      // batch started, so one-task batches don't all land on the same
+      // worker.
+
+      const size_t workers = my_threads.size();
+      const size_t first   = my_deal.fetch_add( 1, std::memory_order_relaxed );
+
+      for( size_t i = 0; i < the_tasks.size(); ++i ) {
+
+	Queue& q = *my_queues[ ( first + i ) % workers ];
+
+	std::lock_guard<std::mutex> l( q.lock );
+	q.jobs.push_back( Job{ &the_tasks[i], &batch } );
+      }
+
+      {
+	std::lock_guard<std::mutex> l( my_lock );
+	my_pending.fetch_add( the_tasks.size(), std::memory_order_acq_rel );
+      }
+      my_wake.notify_all();
+
+      // Help, as if the first queue were home, until there's nothing
+      // left to take, then wait for the workers to finish what they
+      // took.
+
+      Job job;
+
+      while( _take( first % workers, job )) {
+	( *job.task )();
+	_finish( job );
+
+	std::lock_guard<std::mutex> l( batch.lock );
+	if( batch.left == 0 )
+	  break;
+      }
+
+      std::unique_lock<std::mutex> l( batch.lock );
+
+      batch.done.wait( l, [&batch] { return batch.left == 0; } );
+
+    }
+
+  }
+}
+
+
+//  LocalWords:  WorkPool
@@ -0,0 +1,161 @@
+/* -*- c++ -*- */
+
+/*
+ * Copyright 2016 Dennis Glatting
+ *
+ *
+ * Per-stage timing of the demodulator and decoder.
+ *
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ *
+ */
+
+#include <string>
+
+#include <acars/profile.h>
+
+
+static const std::string my_ident = "$Id: profile.cc,v 1.1 2016/07/11 03:14:40 dennisg Exp $";
+
+
+namespace gr {
+  namespace acars {
+
+    namespace detail {
+
+      std::atomic<bool> profile_on( false );
+      thread_local int  profile_depth = 0;
+
+    }
+
+    // Bucket b counts calls that took [2^b, 2^(b+1)) ns. 2^40ns is
+    // about 18 minutes, which is plenty.
+
+    static constexpr int buckets = 40;
+
+    static const char* const stage_names[] = {
+      "rotate_90", "low_pass", "post_squelch", "am_demod", "am_front_end",
+      "low_pass_simple", "deemph_filter", "dc_block_filter",
+      "channelizer",
+      "_getbit", "_getmesg", "crc_correct", "print_mesg"
+    };
+
+    static_assert( sizeof( stage_names ) / sizeof( stage_names[0] ) ==
+		   size_t( Stage::COUNT ),
+		   "a Stage is missing its name" );
+
+    static struct stage_stats_s {
+
+      std::atomic<uint64_t> calls;
+      std::atomic<uint64_t> samples;
+      std::atomic<uint64_t> ns;
+      std::atomic<uint64_t> top_ns;    // Of the calls that weren't nested.
+      std::atomic<uint64_t> hist[ buckets ];
+
+    } stats[ size_t( Stage::COUNT ) ];
+
+    void
+    profile_enable( bool on ) noexcept {
+
+      detail::profile_on.store( on, std::memory_order_relaxed );
+
+    }
+
+    void
+    profile_record( Stage s, uint64_t ns, size_t samples,
+		    bool nested ) noexcept {
+
+      stage_stats_s& st = stats[ size_t( s ) ];
+      int            b  = 0;
+
+      for( uint64_t x = ns; ( x > 1 ) && ( b < ( buckets - 1 )); x >>= 1 )
+	++b;
+
+      st.calls.fetch_add(   1,       std::memory_order_relaxed );
+      st.samples.fetch_add( samples, std::memory_order_relaxed );
+      st.ns.fetch_add(      ns,      std::memory_order_relaxed );
+      if( !nested )
+	st.top_ns.fetch_add( ns,     std::memory_order_relaxed );
+      st.hist[b].fetch_add( 1,       std::memory_order_relaxed );
+
+    }
+
+    void
+    profile_dump( FILE* f ) {
+
+      uint64_t total = 0;
+
+      // The nested stages' time is already in their parents'.
+
+      for( const auto& st : stats )
+	total += st.top_ns.load( std::memory_order_relaxed );
+
+      fprintf( f, "\n%-16s %12s %14s %10s %6s %9s %9s\n",
+	       "stage", "calls", "samples", "ms", "%", "ns/call", "Msps" );
+
+      for( size_t i = 0; i < size_t( Stage::COUNT ); ++i ) {
+
+	const stage_stats_s& st = stats[i];
+	const uint64_t
+	  calls   = st.calls.load(   std::memory_order_relaxed ),
+	  samples = st.samples.load( std::memory_order_relaxed ),
+	  ns      = st.ns.load(      std::memory_order_relaxed ),
+	  top_ns  = st.top_ns.load(  std::memory_order_relaxed );
+
+	if( calls == 0 )
+	  continue;
+
+	const std::string name =
+	  std::string(( ns && !top_ns ) ? "  " : "" ) + stage_names[i];
+
+	fprintf( f, "%-16s %12llu %14llu %10.1f %6.2f %9.0f %9.2f\n",
+		 name.c_str(),
+		 (unsigned long long)calls, (unsigned long long)samples,
+		 ns / 1e6,
+		 total ? ( 100.0 * ns ) / total : 0.0,
+		 double( ns ) / calls,
+		 ns ? ( 1e3 * samples ) / ns : 0.0 );
+
+	// The histogram, trimmed to the buckets that were used. Each
+	// row is the lower edge of the bucket and the number of calls.
+
+	int lo = 0, hi = buckets - 1;
+
+	while(( lo < hi ) &&
+	      ( st.hist[lo].load( std::memory_order_relaxed ) == 0 ))
+	  ++lo;
+	while(( hi > lo ) &&
+	      ( st.hist[hi].load( std::memory_order_relaxed ) == 0 ))
+	  --hi;
+
+	for( int b = lo; b <= hi; ++b )
+	  fprintf( f, "%18s>= %12llu ns: %llu\n", "",
+		   b ? ( 1ULL << b ) : 0ULL,
+		   (unsigned long long)st.hist[b].load
+		   ( std::memory_order_relaxed ));
+      }
+
+      fprintf( f, "\n" );
+      fflush( f );
+
+    }
+
+  }
+}
+
+
+//  LocalWords:  histogram ns Msps
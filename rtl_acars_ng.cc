@@ -61,6 +61,10 @@
 #include <stdlib.h>
 
 #ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
 #include <unistd.h>
 #else
 #include <windows.h>
@@ -83,12 +87,25 @@
 #include <iomanip>
 #include <iostream>
 #include <map>
+#include <memory>
 #include <string>
 #include <vector>
 
 #include <acars/Buffer.h>
+#include <acars/Ring.h>
+#include <acars/bench.h>
+#include <acars/channelizer.h>
 #include <acars/crc.h>
+#include <acars/dataset.h>
+#include <acars/decoder.h>
+#include <acars/fir.h>
+#include <acars/frontend.h>
+#include <acars/gate.h>
 #include <acars/message.h>
+#include <acars/pool.h>
+#include <acars/profile.h>
+#include <acars/scan.h>
+#include <acars/utility.h>
 
 using namespace gr::acars;
 
@@ -101,145 +118,27 @@ using namespace gr::acars;
 #define DEFAULT_BUF_LENGTH   (1 * 16384)
 #define MAXIMUM_OVERSAMPLE	      16
 #define MAXIMUM_BUF_LENGTH	(MAXIMUM_OVERSAMPLE * DEFAULT_BUF_LENGTH)
+#define MAXIMUM_DECIMATION	      66  /* 3.168 Msps, the dongle tops out at 3.2 */
 #define AUTO_GAIN		    -100
 #define BUFFER_DUMP		    4096
 
 #define FREQUENCIES_LIMIT  	    1000
 
+// Wideband mode. The capture rate is a multiple of the bit former's
+// rate, the multiple chosen from this range, and the channels have to
+// fit inside this fraction of it (the rest is the dongle's roll off).
 
-// After down sampling (i.e., applying a low pass filter and
-// decimating), the sample rate into the bit former is 48k/bps.
-
-#define Fe       48000.0
-#define Freqh    (4800.0/Fe*twoPI)
-#define Freql    (2400.0/Fe*twoPI)
-#define BITLEN   int(Fe/1200.0)
-
-/* ACARS defines */
-
-#define VFOPLL 0.7e-3
-#define BITPLL 0.2
-
-
-// Bit state machine.
-
-static struct bstat_s {
-
-  BufferVOLK<float>
-    hsample = BufferVOLK<float>( BITLEN ),
-    lsample = BufferVOLK<float>( BITLEN ),
-    isample = BufferVOLK<float>( BITLEN ),
-    qsample = BufferVOLK<float>( BITLEN ),
-    csample = BufferVOLK<float>( BITLEN );
-
-  int is;
-  int clock;
-  float lin;
-  float phih,phil;
-  float dfh,dfl;
-  float pC,ppC;
-  int sgI, sgQ;
-  float ea;
-
-} bstat;
-
-
-// Message state machine state.
-
-enum class STATE {
-  HEADL, HEADF,    // Header (PRE-KEY) lost, Header found. The
-		   // transition from lost to found is at least eight
-		   // bits are found to be a logical 1. When "found,"
-		   // the state machine will consume PRE-KEY bits
-		   // until at least two bits in eight are not a
-		   // logical 1, at which time the state machine
-		   // starts to look for BIT-SYNC. If there are more
-		   // that two bits that are not a logical one then
-		   // the state machine transitions back to lost.
-  SYNC,            // Looking for the bit pattern matching the
-		   // BIT-SYNC, CHAR-SYNC, and SOH.
-  TXT,             // Collecting the text segment of a message by
-		   // passing the SOH1 state and terminated by a ETX
-		   // or ETB (or buffer overflow).
-  CRC1, CRC2,      // Looking for the first and second CRC byte.
-  END              // Process the message, if any.
-};
-std::ostream& operator<<( std::ostream&, const STATE& ) ;
-
-struct {
-
-  // The state machine's state.
-  
-  STATE state;
-  
-  // After PRE-KEY characters have been found then the search is on
-  // for the SYNC words and SOH. We collect those bits and at a
-  // certain point (i.e., when enough bits has been collected for the
-  // words) the check is on to declare sync.
-  //
-  // There has to be a permissible number of errors in the words and
-  // there has to be a stopping point to declare no-SYNC.
-
-  uint64_t syncForming;
-  int      syncBitsHave;
-
-  const int errLim = 3;
-  const int syncBitsLim = ( 40 + 15 ); // 5 words * 8 bits plus extra.
-
-  // The number of consecutive PRE-KEY bits I have seen and the number
-  // I want to see before advancing the state machine.
-  //
-  //  (10ms represents 24 bits of PRE-KEY. PRE_KEY is 208 bits, which
-  //   is 86ms.)
-
-        int consecutivePreKey;
-  const int consecutivePreKeyLim = ( 0.010 * 2400 ); /* 10ms */
-  
-  // The raw message bytes with parity and framing bytes.
-
-  std::vector<uint8_t> rawText;
-  
-  // This was previously used for CRC but doubled as a flag. Now it is
-  // a flag where non-zero indicates uncorrected CRC errors.
-  
-  uint16_t crc;
-
-} m_state;
-
+#define WIDEBAND_DECIMATION_MIN       50  /* 2.4 Msps */
+#define WIDEBAND_DECIMATION_MAX       64  /* 3.072 Msps */
+#define WIDEBAND_USABLE             0.92
+#define WIDEBAND_BUF_LENGTH  (4 * DEFAULT_BUF_LENGTH)
 
-struct acars_flight {
-  char *flightid;
-  char *from;
-  char *to;
-  char *airline;
-};
-struct acars_flight acars_flights[160000];
-
-
-struct acars_aircraft {
-  char *registration;
-  char *modes;
-  char *manufacturer;
-  char *model;
-};
-struct acars_aircraft acars_aircrafts[500000];
 
 
-struct acars_airport {
-  char *name;
-  char *city;
-  char *country;
-  char *code;
-};
-struct acars_airport acars_airports[10000];
-
 
-struct acars_ml {
-  char *ml_code;
-  char *ml_label;
-};
+// The aircraft, airport, flight, and label datasets, indexed.
 
-struct acars_ml acars_mls[16000];
+static Dataset dataset;
 
 /*
   struct acars_airlines {
@@ -250,67 +149,6 @@ struct acars_ml acars_mls[16000];
   struct acars_airlines acars_airliness[16000];
 */
 
-
-// This vector is indexed with a u_char and returns the number of bits
-// set to 1.
-
-static const
-std::vector<int> bits_set = {
-  0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
-  1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5,
-  1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5,
-  2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6,
-  1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5,
-  2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6,
-  2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6,
-  3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7,
-  1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5,
-  2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6,
-  2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6,
-  3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7,
-  2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6,
-  3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7,
-  3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7,
-  4, 5, 5, 6, 5, 6, 6, 7, 5, 6, 6, 7, 6, 7, 7, 8
-};
-
-// This vector and routine is used to set a character's parity.
-
-static const
-std::vector<uint8_t> parity_bit = {
-  0x80, 0x00, 0x00, 0x80, 0x00, 0x80, 0x80, 0x00,
-  0x00, 0x80, 0x80, 0x00, 0x80, 0x00, 0x00, 0x80,
-  0x00, 0x80, 0x80, 0x00, 0x80, 0x00, 0x00, 0x80,
-  0x80, 0x00, 0x00, 0x80, 0x00, 0x80, 0x80, 0x00,
-
-  0x00, 0x80, 0x80, 0x00, 0x80, 0x00, 0x00, 0x80,
-  0x80, 0x00, 0x00, 0x80, 0x00, 0x80, 0x80, 0x00,
-  0x80, 0x00, 0x00, 0x80, 0x00, 0x80, 0x80, 0x00,
-  0x00, 0x80, 0x80, 0x00, 0x80, 0x00, 0x00, 0x80,
-
-  0x00, 0x80, 0x80, 0x00, 0x80, 0x00, 0x00, 0x80,
-  0x80, 0x00, 0x00, 0x80, 0x00, 0x80, 0x80, 0x00,
-  0x80, 0x00, 0x00, 0x80, 0x00, 0x80, 0x80, 0x00,
-  0x00, 0x80, 0x80, 0x00, 0x80, 0x00, 0x00, 0x80,
-
-  0x80, 0x00, 0x00, 0x80, 0x00, 0x80, 0x80, 0x00,
-  0x00, 0x80, 0x80, 0x00, 0x80, 0x00, 0x00, 0x80,
-  0x00, 0x80, 0x80, 0x00, 0x80, 0x00, 0x00, 0x80,
-  0x80, 0x00, 0x00, 0x80, 0x00, 0x80, 0x80, 0x00
-};
-
-inline uint8_t
-_to_odd( uint8_t c ) {
-
-  return c | parity_bit[ c & 0x7f ];
-}
-
-// Given a index, which bit is set/clear?
-
-static const std::vector<uint8_t> mask = {
-  0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80
-};
-
 // I could do a bunch of casting or simply provide inline wrappers
 // that do the same thing. I prefer this way.
 
@@ -353,26 +191,121 @@ strncpy( char* dest, const uint8_t* src, size_t n ) {
 
 static int n_omp = 2;
 
+// n_omp workers that decode the channels of a wideband block in
+// parallel, shared by every device. NULL when there's only one
+// channel to decode.
+
+static std::unique_ptr<WorkPool> pool;
+
+
+// The reader and the demodulator are joined by a ring of IQ blocks
+// that are allocated once at start-up. The reader fills a free block
+// in place and pushes it; the demodulator works on the oldest block in
+// place and pops it when it is done. If the demodulator falls so far
+// behind that the ring is full then the reader drops the block it just
+// read and counts it rather than overwrite data still being worked on.
+
+struct iq_block {
+
+  Buffer<uint8_t> data;
+  uint32_t        len;
+  uint64_t        sample;   /* the first sample's place in the stream */
+  uint32_t        tune;     /* the hop it was read after */
+  uint32_t        settle;   /* bytes at its start read while settling */
+
+};
+
+// With -S the demodulator is a pipeline of three threads: the front
+// end (full_demod()), the bit former, and the message state machine,
+// each on a core of its own. They're joined the same way, by rings of
+// envelope blocks and of symbol blocks, but a stage whose output ring
+// is full waits for room rather than drop anything; only the reader
+// drops.
+
+#define PIPE_RING_SIZE 8
+
+struct env_block {
+
+  Buffer<int16_t> data;     /* the front end's output, at Fe */
+  uint32_t        len;
+  uint64_t        sample;   /* the sample clock at its end */
+  uint32_t        freq;     /* what it was tuned to */
+
+};
+
+struct sym_block {
+
+  std::vector<uint8_t> data;  /* AcarsDecoder symbols */
+  uint64_t             sample;
+  uint32_t             freq;
+
+};
+
+// A stage's wake-up and what it did, to see which one is the
+// bottleneck: the time it worked and, of that, waited for room on its
+// output, and the blocks it took and how full its input was each time.
+
+struct pipe_stage {
+
+  pthread_t       thread;
+  pthread_cond_t  ready;    /* a block was pushed on its input */
+  pthread_mutex_t mutex;
+  uint64_t        busy_ns;
+  uint64_t        blocked_ns;
+  uint64_t        takes;
+  uint64_t        depth;
+
+};
+
+// Decoded messages leave the same way. Whichever thread runs a
+// device's decoders fills a record in the next free slot of the
+// device's ring and the writer thread formats and prints it, so a slow
+// terminal or pipe holds up only the writer. If the writer falls so
+// far behind that the ring is full the message is dropped and counted
+// rather than stall the demodulator.
+//
+// A record is stamped with the device's sample clock (the samples read
+// when the message was decoded), not the time. The writer turns the
+// clock into the time from when the device's stream started and its
+// rate, and with more than one device prints the messages of all of
+// them in that order.
+
+#define OUT_RING_SIZE 256
+
+// How long (seconds) the writer holds a message for a device that has
+// gone quiet, one that isn't reading or is far behind, before printing
+// it anyway.
+
+#define OUT_MAX_LAG   2.0
+
+struct out_record {
+
+  msg_t    msg;
+  uint64_t sample;
+
+};
+
+static bool              out_wait = false;  /* wait for room, don't drop */
+static std::atomic<bool> out_done( false );
 
-static pthread_t demod_thread;
-static pthread_cond_t data_ready;   /* shared buffer filled */
-static pthread_rwlock_t data_rw;    /* lock for shared buffer */
-static pthread_mutex_t data_mutex;  /* because conds are dumb */
+static pthread_t       out_thread;
+static pthread_cond_t  out_ready;   /* a record was pushed on a ring */
+static pthread_mutex_t out_mutex;
 
 static pthread_mutex_t dataset_mutex;
 
 static volatile int do_exit = 0;
-static rtlsdr_dev_t *dev = NULL;
+static volatile sig_atomic_t do_profile_dump = 0;
 static int lcm_post[17] = {1,1,1,3,1,5,3,7,1,9,5,11,3,13,7,15,1};
 static int ACTUAL_BUF_LENGTH;
 
-static BufferVOLK<float> h = BufferVOLK<float>( BITLEN );
 
 static int *atan_lut = NULL;
 static int atan_lut_size = 131072; /* 512 KB */
 static int atan_lut_coef = 8;
 
 static int debug_hop=0;
+static int round_robin=0;  /* -R, scan the old way */
 static int current_freq = 0;
 
 static int verbose = 0;
@@ -383,11 +316,12 @@ struct fm_state
   int      pre_r, pre_j;
   int      prev_index;
   int      downsample;    /* min 1, max 256 */
+  int      decimation;    /* -X, 0 picks downsample from sample_rate */
   int      post_downsample;
   int      output_scale;
   int      squelch_level, conseq_squelch, squelch_hits, terminate_on_squelch;
   int      exit_flag;
-  uint8_t  buf[MAXIMUM_BUF_LENGTH];
+  uint8_t  *buf;                        /* the IQ block being demodulated */
   uint32_t buf_len;
   int      signal[MAXIMUM_BUF_LENGTH];  /* 16 bit signed i/q pairs */
   int16_t  signal2[MAXIMUM_BUF_LENGTH]; /* signal has lowpass, signal2 has demod */
@@ -401,189 +335,80 @@ struct fm_state
   uint32_t sample_rate;
   int      output_rate;
   int      fir_enable;
-  int      fir[256];  /* fir_len == downsample */
-  int      fir_sum;
+  int      fir_taps;                    /* per phase */
+  std::unique_ptr<Decimator> fir;
   int      custom_atan;
   int      deemph, deemph_a;
   int      now_lpr;
   int      prev_lpr_index;
   int      dc_block, dc_avg;
+  int      deemph_avg;
+  uint64_t sample_clock;                /* samples read to the end of buf */
+  rtlsdr_dev_t *dev;                    /* NULL for a recording */
+  uint32_t tune_gen;                    /* hops so far */
+  std::atomic<uint64_t> tune_ask;       /* the last hop's gen and capture freq */
+  AcarsDecoder* decoder;                /* bits and messages */
+  std::unique_ptr<ScanScheduler> scan;  /* which channel next, NULL for -R */
+  double   gate_db;                     /* -q, 0 for no squelch gate */
+  std::unique_ptr<SquelchGate> gate;    /* in front of decoder */
+  uint32_t wb_center;                   /* wideband: all channels at once */
+  std::unique_ptr<Channelizer> channelizer;
+  std::vector<std::unique_ptr<AcarsDecoder>> wb_decoders;  /* per freqs[] */
+  std::vector<std::unique_ptr<SquelchGate>>  wb_gates;     /* in front of them */
+  std::vector<WorkPool::Task> wb_tasks;                    /* push a block to each */
+  std::vector<std::vector<msg_t>> wb_held;                 /* decoded, not queued */
 };
 
-typedef struct {
-  unsigned char mode;
-  unsigned char addr[8];
-  unsigned char ack;
-  unsigned char label[3];
-  unsigned char bid;
-  unsigned char no[5];
-  unsigned char fid[7];
-  char txt[256];
-  int crc;
-} msg_t;
-
-// ACARS decoder variables
-static long rx_idx;
-int c;
-uint8_t rl;
-int nbitl = 0;
+// A dongle and everything that runs from it: its own reader and
+// demodulator threads, front end, and decoders, and the rings between
+// them and on to the writer. Every -d gets one; a recording gets one
+// with no device.
 
+struct receiver
+{
+  int      index;                       /* -d */
+  std::unique_ptr<fm_state>     fm;
+  std::unique_ptr<AcarsDecoder> decoder;
+  RingSPSC<iq_block>   iq_ring;
+  unsigned long        iq_overruns;
+  uint64_t             iq_clock;        /* samples read, dropped ones too */
+  uint32_t             tune_now;        /* the hop the reader last did */
+  uint32_t             settle;          /* bytes still to be tagged settling */
+  unsigned long        tune_skipped;    /* blocks from before a hop */
+  pthread_t            read_thread;
+  pthread_t            demod_thread;
+  pthread_cond_t       data_ready;      /* a block was pushed on iq_ring */
+  pthread_mutex_t      data_mutex;      /* because conds are dumb */
+  RingSPSC<out_record> out_ring;
+  unsigned long        out_overruns;
+  std::atomic<uint64_t> out_clock;      /* every message before it is queued */
+  double               out_epoch;       /* the time at sample zero */
+  double               out_rate;        /* of the sample clock (Hz) */
+  uint64_t             msg_sample;      /* what the decoder's messages */
+  uint32_t             msg_freq;        /* are stamped with */
+  bool                 piped;           /* -S */
+  RingSPSC<env_block>  env_ring;        /* front end to bit former */
+  RingSPSC<sym_block>  sym_ring;        /* bit former to framer */
+  std::atomic<bool>    env_done;        /* no more envelope blocks */
+  std::atomic<bool>    sym_done;        /* no more symbol blocks */
+  pipe_stage           stage[3];        /* front end, bits, framer */
+  struct timespec      pipe_start;
+
+  receiver() : index(0), iq_ring(DEFAULT_ASYNC_BUF_NUMBER), iq_overruns(0),
+	       iq_clock(0), tune_now(0), settle(0), tune_skipped(0),
+	       out_ring(OUT_RING_SIZE), out_overruns(0),
+	       out_clock(0), out_epoch(0), out_rate(1), msg_sample(0),
+	       msg_freq(0), piped(false), env_ring(PIPE_RING_SIZE),
+	       sym_ring(PIPE_RING_SIZE), env_done(false), sym_done(false),
+	       stage(), pipe_start() {}
+};
 
-// Constants.
-
-static constexpr double halfPI = ( M_PI / 2.0 );
-static constexpr double twoPI  = ( M_PI * 2.0 );
-static constexpr double fourPI = ( M_PI * 4.0 );
+static std::vector<std::unique_ptr<receiver>> receivers;
 
 
 static const std::string my_ident = "$Id: rtl_acars_ng.cc,v 1.8 2016/07/07 04:50:21 dennisg Exp dennisg $";
 
 
-// Two routines to count the number of bit errors (i.e., the number of
-// bits set to a 1 formed by an XOR or two words).
-
-inline int
-_count_bit_errors( uint8_t c1, uint8_t c2 ) {
-
-  return bits_set[ c1 ^ c2 ];
-}
-
-inline int
-_count_bit_errors( uint64_t c1, uint64_t c2 ) {
-
-  const uint64_t x = c1 ^ c2;
-
-    return
-      bits_set[ uint8_t( x >> 56 ) & uint8_t( 0xff )] +
-      bits_set[ uint8_t( x >> 48 ) & uint8_t( 0xff )] +
-      bits_set[ uint8_t( x >> 40 ) & uint8_t( 0xff )] +
-      bits_set[ uint8_t( x >> 32 ) & uint8_t( 0xff )] +
-      bits_set[ uint8_t( x >> 24 ) & uint8_t( 0xff )] +
-      bits_set[ uint8_t( x >> 16 ) & uint8_t( 0xff )] +
-      bits_set[ uint8_t( x >>  8 ) & uint8_t( 0xff )] +
-      bits_set[ uint8_t( x >>  0 ) & uint8_t( 0xff )];
-}
-
-std::ostream&
-operator<<( std::ostream& o, const STATE& s ) {
-
-  if( s == STATE::HEADL )
-    o << "HEADL";
-  else
-    if( s == STATE::HEADF )
-      o << "HEADF";
-    else
-      if( s == STATE::SYNC )
-	o << "SYNC";
-      else
-	if( s == STATE::TXT )
-	  o << "TXT";
-	else
-	  if( s == STATE::CRC1 )
-	    o << "CRC1";
-	  else
-	    if( s == STATE::CRC2 )
-	      o << "CRC2";
-	    else
-	      if( s == STATE::END )
-		o << "END";
-	      else
-		o << "dunno";
-  return o;
-}
-
-
-void
-_dump_sync( const uint64_t checkPhrase,
-	    const uint64_t checkWord ) {
-
-  const uint64_t
-    w1 = (  checkWord & 0xffffffffff ),
-    w2 = ( ~checkWord & 0xffffffffff );
-  const int
-    err1 = _count_bit_errors( w1, checkPhrase ),
-    err2 = _count_bit_errors( w2, checkPhrase );
-
-  std::streamsize         width = std::cout.width();
-  std::ios_base::fmtflags flags = std::cout.flags();
-  char                    fill  = std::cout.fill();
-
-  std::cout << "Check: "
-	    << std::hex << std::showbase
-	    << std::setw(14) << checkPhrase
-	    << " ";
-  std::cout << std::hex << std::showbase
-	    << std::setw(14) << w1
-	    << std::dec
-	    << " "
-	    << std::setw(2) << err1;
-  if( err1 < 5 )
-    std::cout << " *** ";
-  else
-    std::cout << "     ";
-  std::cout << std::hex << std::showbase
-	    << std::setw(14) << w2
-	    << std::dec
-	    << " "
-	    << std::setw(2) << err2;
-  if( err2 < 5 )
-    std::cout << " *** ";
-  else
-    std::cout << "     ";
-  std::cout << std::endl;
-
-  std::cout.width( width );
-  std::cout.setf( flags );
-  std::cout.fill( fill );
-
-}
-   
-
-void
-_dump_bit_state_machine( void ) {
-
-  std::cout << "c: ";
-  for( size_t i = 0; i < bstat.csample.size(); ++i )
-    std::cout << bstat.csample[i] << " ";
-  std::cout << std::endl;
-
-  std::cout << "h: ";
-  for( size_t i = 0; i < bstat.hsample.size(); ++i )
-    std::cout << bstat.hsample[i] << " ";
-  std::cout << std::endl;
-
-  std::cout << "l: ";
-  for( size_t i = 0; i < bstat.lsample.size(); ++i )
-    std::cout << bstat.lsample[i] << " ";
-  std::cout << std::endl;
-
-  std::cout << "i: ";
-  for( size_t i = 0; i < bstat.isample.size(); ++i )
-    std::cout << bstat.isample[i] << " ";
-  std::cout << std::endl;
-
-  std::cout << "q: ";
-  for( size_t i = 0; i < bstat.qsample.size(); ++i )
-    std::cout << bstat.qsample[i] << " ";
-  std::cout << std::endl;
-
-  std::cout << "phih= " << bstat.phih
-	    << ", phil= " << bstat.phil << std::endl;
-  std::cout << "dfh= " << bstat.dfh
-	    << ", dfl= "<< bstat.dfl << std::endl;
-  std::cout << "pC= " << bstat.pC
-	    << ", ppC= "<< bstat.ppC << std::endl;
-  std::cout << "sgI= " << bstat.sgI
-	    << ", sgQ= "<< bstat.sgQ << std::endl;
-
-  std::cout << "is: " << bstat.is    << std::endl;
-  std::cout << "cl: " << bstat.clock << std::endl;
-  std::cout << "ln: " << bstat.lin   << std::endl;
-  std::cout << "ea: " << bstat.ea    << std::endl;
-
-  std::cout << std::endl;
-
-}
 
 
 void usage(void)
@@ -591,21 +416,42 @@ void usage(void)
   fprintf(stderr,
 	  "rtl_fm, a simple narrow band FM demodulator for RTL2832 based DVB-T receivers\n\n"
 	  "Use:\tnew_rtl_acars -f freq [-options] \n"
-	  "\t[-F enables Hamming FIR (default: off/square)]\n"
+	  "\t[-F enables the polyphase FIR (default: off/square)]\n"
+	  "\t[-T FIR taps per phase (default: %d)]\n"
+	  "\t[-X decimation (capture rate = decimation x 48 kHz, 2-%d,\n"
+	  "\t default: 21)]\n"
 	  "\t[-r debug hop]\n"
 	  "\t[-v verbose]\n"
 	  "\t[-h help (usage)]\n"
 	  "\t-f frequency_to_tune_to [Hz]\n"
 	  "\t (use multiple -f for scanning, requires squelch)\n"
 	  "\t (ranges supported, -f 118M:137M:25k)\n"
+	  "\t[-B benchmark (run a built in benchmark and exit: crc, demod, ecc, fir, frontend,\n"
+	  "\t gate, nco, pool, scan, snr)]\n"
+	  "\t[-C image (compile the datasets into an image and exit)]\n"
+	  "\t[-c crc engine (table, slice8, or clmul, default: the fastest\n"
+	  "\t the CPU has)]\n"
+	  "\t[-D image (the compiled datasets, default: datasets/acars.img)]\n"
+	  "\t[-G file (write a synthetic recording of ten messages and exit)]\n"
 	  "\t[-d device_index (default: 0)]\n"
+	  "\t (use multiple -d for more dongles, the -f after each are its\n"
+	  "\t channels; -g and -p apply to all)\n"
+	  "\t[-e bit errors to correct per message (0-2, default: 1)]\n"
+	  "\t[-i replay_file (8-bit unsigned IQ, .cu8, at the capture rate)]\n"
 	  "\t[-g tuner_gain (default: automatic)]\n"
 	  "\t[-l squelch_level (default: 0/off)]\n"
 	  "\t[-o oversampling (default: 1, 4 recommended)]\n"
 	  "\t[-p ppm_error (default: 0)]\n"
+	  "\t[-q gate (dB over the noise floor that wakes the decoder,\n"
+	  "\t default: 3, 0 decodes all the time)]\n"
 	  "\t[-r squelch debug mode ]\n"
 	  "\t[-t squelch_delay (default: 0)]\n"
-	  "\t (+values will mute/scan, -values will exit)\n" );
+	  "\t (+values will mute/scan, -values will exit)\n"
+	  "\t[-P profile the demodulator and decoder, dump on SIGUSR1 and exit]\n"
+	  "\t[-R scan the channels in order, not by the traffic heard on them]\n"
+	  "\t[-S split the demodulator into a pipeline of three threads]\n"
+	  "\t[-W wideband, decode every -f channel at once (no hopping)]\n",
+	  FIR_TAPS, MAXIMUM_DECIMATION);
   exit(1);
 }
 
@@ -628,1712 +474,1721 @@ static void sighandler(int signum)
   do_exit = 1;
   //rtlsdr_cancel_async(dev);
 }
-#endif
 
+// SIGUSR1 asks for the profile. The dump is done by whichever thread
+// is demodulating, at the top of its loop, not here.
 
-void load_flights(void)
+static void profile_sighandler(int signum)
 {
-  FILE *f = fopen("datasets/flightroute2.txt", "r");
-  if (!f) {
-    fprintf(stderr, "Warning: datasets/flightroute2.txt data source not found\n");
-    acars_flights[0].flightid = NULL;
-    return;
-  }
+  do_profile_dump = 1;
+}
+#endif
 
-  int i = 0;
 
-  char *line = NULL;
-  size_t len = 0;
-  while (getline(&line, &len, f) != -1) {
-    char *item = line;
-    char *tabpos;
-
-    tabpos = strchr(item, '\t');
-    if (!tabpos) { fprintf(stderr, "Parse error on line: %s\n", line); continue; }
-    tabpos[0] = 0;
-    acars_flights[i].flightid = strdup(item);
-    item = tabpos + 1;
-
-    tabpos = strchr(item, '\t');
-    if (!tabpos) { fprintf(stderr, "Parse error on line: %s\n", line); continue; }
-    tabpos[0] = 0;
-    acars_flights[i].from = strdup(item);
-    item = tabpos + 1;
-
-    tabpos = strchr(item, '\t');
-    if (!tabpos) { fprintf(stderr, "Parse error on line: %s\n", line); continue; }
-    tabpos[0] = 0;
-    acars_flights[i].to = strdup(item);
-    item = tabpos + 1;
-
-    tabpos = strchr(item, '\t');
-    tabpos[0] = 0;
-    acars_flights[i].airline = strdup(item);
+// Dump the profile if someone asked for it.
 
-    i++;
-  }
+static void
+_check_profile_dump( void ) {
 
-  acars_flights[i].flightid = NULL;
-  fclose(f);
-  printf("Loaded: %i flights from dataset.....\n", i);
+  if( do_profile_dump ) {
+    do_profile_dump = 0;
+    profile_dump( stderr );
+  }
 }
 
 
+// Map the compiled dataset image, unless there isn't one or the text
+// files have changed since it was compiled, in which case read the
+// text files.
 
+static void
+load_datasets( const char* image ) {
 
-void load_airports(void)
-{
-  FILE *f = fopen("datasets/airports.txt", "r");
-  if (!f) {
-    fprintf(stderr, "Warning: datasets/airports.txt data source not found\n");
-    acars_airports[0].code = NULL;
+  if( Dataset::newer_text( image, "datasets" )) {
+    if( access( image, F_OK ) == 0 )
+      fprintf( stderr, "Warning: %s is older than the datasets, "
+	       "recompile it with -C\n", image );
+  }
+  else if( dataset.map( image )) {
+    printf( "Mapped: %s, %zu aircrafts, %zu airports, %zu flights, "
+	    "%zu ACARS message labels\n", image, dataset.aircrafts(),
+	    dataset.airports(), dataset.flights(), dataset.labels());
     return;
   }
+  else
+    fprintf( stderr, "Warning: can't map %s: %s\n", image, strerror( errno ));
 
-  int i = 0;
-
-  char *line = NULL;
-  size_t len = 0;
-  while (getline(&line, &len, f) != -1) {
-    char *item = line;
-    char *tabpos;
-
-    tabpos = strchr(item, '\t');
-    if (!tabpos) { fprintf(stderr, "Parse error on line: %s\n", line); continue; }
-    tabpos[0] = 0;
-    acars_airports[i].name = strdup(item);
-    item = tabpos + 1;
-
-    tabpos = strchr(item, '\t');
-    if (!tabpos) { fprintf(stderr, "Parse error on line: %s\n", line); continue; }
-    tabpos[0] = 0;
-    acars_airports[i].city = strdup(item);
-    item = tabpos + 1;
-
-    tabpos = strchr(item, '\t');
-    if (!tabpos) { fprintf(stderr, "Parse error on line: %s\n", line); continue; }
-    tabpos[0] = 0;
-    acars_airports[i].country = strdup(item);
-    item = tabpos + 1;
-
-    tabpos = strchr(item, '\t');
-    tabpos[0] = 0;
-    acars_airports[i].code = strdup(item);
+  dataset.load_text( "datasets" );
+}
 
-    i++;
-  }
 
-  acars_airports[i].code = NULL;
-  fclose(f);
-  printf("Loaded: %i airports from dataset.....\n", i);
+void process_qv(char *txt)
+{
+  switch (txt[0])
+    {
+    case '1': printf("\nAutotune reject reason: Contrary to airline preference\n");break;
+    case '2': printf("\nATN session in progress\n");break;
+    case '3': printf("\nAutotune uplink format error\n");break;
+    default: printf("\nAutotune reject reason: unknown\n");
+    }
 }
 
 
-void load_aircrafts(void)
+void process_sa(char *txt)
 {
-  FILE *f = fopen("datasets/aircrafts.txt", "r");
-  if (!f) {
-    fprintf(stderr, "Warning: datasets/aircrafts.txt data source not found\n");
-    acars_aircrafts[0].registration = NULL;
-    return;
-  }
+  printf("Version: %c\n",txt[0]);
+  if (txt[1]=='E')
+    printf("Link state: Established\n");
+  else
+    if (txt[1]=='L')
+      printf("Link state: Lost\n");
+    else
+      printf("Link state: Unknown\n");
+  
+  switch (txt[2]) {
+    case 'V': printf("Link type: VHF ACARS\n");break;
+    case 'S': printf("Link type: Generic SATCOM\n");break;
+    case 'H': printf("Link type: HF\n");break;
+    case 'G': printf("Link type: GlobalStar SATCOM\n");break;
+    case 'C': printf("Link type: ICO SATCOM\n");break;
+    case '2': printf("Link type: VDL Mode 2\n");break;
+    case 'X': printf("Link type: Inmarsat Aero\n");break;
+    case 'I': printf("Link type: Irridium SATCOM\n");break;
+    default:  printf("Link type: Unknown\n");
+    }
+  printf("Event occured at: %c%c:%c%c:%c%c\n",txt[3],txt[4],txt[5],txt[6],txt[7],txt[8]);
+}
 
-  int i = 0;
 
-  char *line = NULL;
-  size_t len = 0;
-  while (getline(&line, &len, f) != -1) {
-    char *item = line;
-    char *tabpos;
-
-    tabpos = strchr(item, '\t');
-    if (!tabpos) { fprintf(stderr, "Parse error on line: %s\n", line); continue; }
-    tabpos[0] = 0;
-    acars_aircrafts[i].registration = strdup(item);
-    item = tabpos + 1;
-
-    tabpos = strchr(item, '\t');
-    if (!tabpos) { fprintf(stderr, "Parse error on line: %s\n", line); continue; }
-    tabpos[0] = 0;
-    acars_aircrafts[i].modes = strdup(item);
-    item = tabpos + 1;
-
-    tabpos = strchr(item, '\t');
-    if (!tabpos) { fprintf(stderr, "Parse error on line: %s\n", line); continue; }
-    tabpos[0] = 0;
-    acars_aircrafts[i].manufacturer = strdup(item);
-    item = tabpos + 1;
-
-    tabpos = strchr(item, '\t');
-    if (!tabpos) {tabpos = (char*)malloc(1);tabpos[0] = 0;}
-    acars_aircrafts[i].model = strdup(item);
-    i++;
+void
+process_5u(char *txt) {
+
+  char airport[5] = { 0 };
+  int cur=0;
+  int cur2=0;
+    
+  printf("Weather report requested from: ");
+  while (txt[cur]!=0) {
+    
+    if ((txt[cur]<='Z')&&(txt[cur]>='A')) {
+      
+	  airport[cur2]=txt[cur];
+	  cur2++;
+
+	  if (cur2==4) {
+	    
+	      const char *regtmp = (const char *) airport;
+
+	      while (regtmp[0] == '.')
+		regtmp++;
+
+	      for (long i = dataset.airport(regtmp); i >= 0;
+		   i = dataset.next_airport(i)) {
+		const acars_airport ap = dataset.airport_at(i);
+		printf("%s (%s) ",ap.name,ap.city);
+	      }
+	      cur2 = 0;
+	  }
+    } else
+      cur2=0;
+    cur++;
   }
+  printf("\n");
+}
 
-  acars_aircrafts[i].registration = NULL;
-  fclose(f);
-  printf("Loaded: %i aircrafts from dataset.....\n", i);
+void process_q1(char *txt)
+{
+  printf("Departure station: %c%c%c%c\n",txt[0],txt[1],txt[2],txt[3]);
+  printf("OUT event occured at: %c%c:%c%c\n",txt[4],txt[5],txt[6],txt[7]);
+  printf("OFF event occured at: %c%c:%c%c\n",txt[8],txt[9],txt[10],txt[11]);
+  printf("ON event occured at: %c%c:%c%c\n",txt[12],txt[13],txt[14],txt[15]);
+  printf("IN event occured at: %c%c:%c%c\n",txt[16],txt[17],txt[18],txt[19]);
+  printf("Fuel: %c%c%c%c\n",txt[20],txt[21],txt[22],txt[23]);
+  printf("Destination station: %c%c%c%c\n",txt[24],txt[25],txt[26],txt[27]);
 }
 
+void process_q2(char *txt)
+{
+  printf("Departure station: %c%c%c%c\n",txt[0],txt[1],txt[2],txt[3]);
+  printf("ETA: %c%c:%c%c\n",txt[4],txt[5],txt[6],txt[7]);
+  printf("Fuel: %c%c%c%c\n",txt[8],txt[9],txt[10],txt[11]);
+}
 
-void load_message_labels(void)
+void process_qa(char *txt)
 {
-  FILE *f = fopen("datasets/acars_mls.txt", "r");
-  if (!f) {
-    fprintf(stderr, "Warning: datasets/acars_mls.txt data source not found\n");
-    acars_mls[0].ml_code = NULL;
-    return;
-  }
+  printf("Departure station: %c%c%c%c\n",txt[0],txt[1],txt[2],txt[3]);
+  printf("OUT event occured at: %c%c:%c%c\n",txt[4],txt[5],txt[6],txt[7]);
+  printf("Boarded fuel: %c%c%c%c%c\n",txt[8],txt[9],txt[10],txt[11],txt[12]);
+  printf("Fuel quantity: %c%c%c%c\n",txt[13],txt[14],txt[15],txt[16]);
+}
 
-  int i = 0;
+void process_qb(char *txt)
+{
+  printf("Departure station: %c%c%c%c\n",txt[0],txt[1],txt[2],txt[3]);
+  printf("OFF event occured at: %c%c:%c%c\n",txt[4],txt[5],txt[6],txt[7]);
+}
 
-  char *line = NULL;
-  size_t len = 0;
-  while (getline(&line, &len, f) != -1) {
-    char *item = line;
-    char *tabpos;
+void process_qc(char *txt)
+{
+  printf("Departure station: %c%c%c%c\n",txt[0],txt[1],txt[2],txt[3]);
+  printf("ON event occured at: %c%c:%c%c\n",txt[4],txt[5],txt[6],txt[7]);
+}
 
-    tabpos = strchr(item, '\t');
-    if (!tabpos) { fprintf(stderr, "Parse error on line: %s\n", line); continue; }
-    tabpos[0] = 0;
-    acars_mls[i].ml_code = strdup(item);
-    item = tabpos + 1;
+void process_qd(char *txt)
+{
+  printf("Departure station: %c%c%c%c\n",txt[0],txt[1],txt[2],txt[3]);
+  printf("IN event occured at: %c%c:%c%c\n",txt[4],txt[5],txt[6],txt[7]);
+  printf("Boarded fuel: %c%c%c%c%c\n",txt[8],txt[9],txt[10],txt[11],txt[12]);
+  printf("Fuel quantity: %c%c%c%c\n",txt[13],txt[14],txt[15],txt[16]);
+  printf("Captain/First officer ID: %c\n",txt[17]);
+}
 
-    tabpos = strchr(item, '\t');
-    tabpos[0] = 0;
-    acars_mls[i].ml_label = strdup(item);
 
-    i++;
-  }
+void process_qe(char *txt)
+{
+  printf("Departure station: %c%c%c%c\n",txt[0],txt[1],txt[2],txt[3]);
+  printf("OUT event occured at: %c%c:%c%c\n",txt[4],txt[5],txt[6],txt[7]);
+  printf("Boarded fuel: %c%c%c%c%c\n",txt[8],txt[9],txt[10],txt[11],txt[12]);
+  printf("Fuel quantity: %c%c%c%c\n",txt[13],txt[14],txt[15],txt[16]);
+  printf("Destination station: %c%c%c\n",txt[17],txt[18],txt[19]);
+}
 
-  acars_mls[i].ml_code = NULL;
-  fclose(f);
-  printf("Loaded: %i ACARS message labels from dataset.....\n", i);
+void process_qf(char *txt)
+{
+  printf("Departure station: %c%c%c%c\n",txt[0],txt[1],txt[2],txt[3]);
+  printf("OFF event occured at: %c%c:%c%c\n",txt[4],txt[5],txt[6],txt[7]);
+  printf("Destination station: %c%c%c%c\n",txt[8],txt[9],txt[10],txt[11]);
 }
 
 
-bool
-_getbit( const float sample, uint8_t& outbits ) {
+void process_qg(char *txt)
+{
+  printf("Departure station: %c%c%c%c\n",txt[0],txt[1],txt[2],txt[3]);
+  printf("OUT event occured at: %c%c:%c%c\n",txt[4],txt[5],txt[6],txt[7]);
+  printf("Return IN event occured at: %c%c:%c%c\n",txt[8],txt[9],txt[10],txt[11]);
+}
 
-  bool bt = false;
-  
-  assert( sample >= 0 );
+void process_qh(char *txt)
+{
+  printf("Departure station: %c%c%c%c\n",txt[0],txt[1],txt[2],txt[3]);
+  printf("OUT event occured at: %c%c:%c%c\n",txt[4],txt[5],txt[6],txt[7]);
+}
 
-  if( --bstat.is < 0 )
-    bstat.is = BITLEN - 1;
-  
-  bstat.lin = ( 0.003 * std::fabs( sample )) + ( 0.997 * bstat.lin );
-  
-  /* VFOs */
-  
-  { float oscl, osch;
-    
-    const float
-      s  = sample / bstat.lin,
-      s2 = s * s;
-
-    bstat.phih += Freqh - ( VFOPLL * bstat.dfh );
-    if( bstat.phih >= fourPI )
-      bstat.phih -= fourPI;
-    bstat.dfh = 0.0;
-    bstat.hsample[bstat.is] = s2 * std::sin( bstat.phih );
-    for( int i = 0; i < ( BITLEN / 2 ); ++i )
-      bstat.dfh += bstat.hsample[( bstat.is + i ) % BITLEN];
-    osch = std::cos( bstat.phih / 2.0 );
-    
-    bstat.phil += Freql - ( VFOPLL * bstat.dfl );
-    if( bstat.phil >= fourPI )
-      bstat.phil -= fourPI;
-    bstat.lsample[bstat.is] = s2 * std::sin( bstat.phil );
-    bstat.dfl = 0.0;
-    for( int i = 0; i < ( BITLEN / 2 ); ++i )
-      bstat.dfl += bstat.lsample[( bstat.is + i ) % BITLEN];
-    oscl = std::cos( bstat.phil / 2.0 );
-
-    /* mix */
-    
-    bstat.isample[bstat.is] = s * ( oscl + osch );
-    bstat.qsample[bstat.is] = s * ( oscl - osch );
-    bstat.csample[bstat.is] = oscl * osch;
 
-  }
+void process_qk(char *txt)
+{
+  printf("Departure station: %c%c%c%c\n",txt[0],txt[1],txt[2],txt[3]);
+  printf("ON event occured at: %c%c:%c%c\n",txt[4],txt[5],txt[6],txt[7]);
+  printf("Destination station: %c%c%c%c\n",txt[8],txt[9],txt[10],txt[11]);
+}
 
-  /* bit clock */
-  
-  if( ++bstat.clock >= ( BITLEN/4 + bstat.ea )) {
-    
-    bstat.clock = 0;
-    
-    /*  clock filter  */
-    
-    float C = 0.0;
-    
-    for( int i = 0; i < BITLEN; ++i )
-      C += h[i] * bstat.csample[( bstat.is + i ) % BITLEN];
-    
-    if(( bstat.pC < C ) && ( bstat.pC < bstat.ppC )) {
-      
-      float Q = 0;
-      
-      /* integrator */
-      
-      for( int i = 0; i < BITLEN; ++i )
-	Q += bstat.qsample[( bstat.is + i ) % BITLEN];
-      
-      if( bstat.sgQ == 0 ) {
-	if( Q < 0 )
-	  bstat.sgQ = -1;
-	else
-	  bstat.sgQ = 1;
-      }
-      
-      outbits =
-	( outbits >> 1 ) | uint8_t((( Q * bstat.sgQ ) > 0 ) ? 0x80 : 0 );
-      bt = true;
-      
-      bstat.ea = -BITPLL * ( C - bstat.ppC );
-      if( bstat.ea > 2.0 )
-	bstat.ea =  2.0;
-      if( bstat.ea < -2.0 )
-	bstat.ea = -2.0;
-      
-    }
-    
-    if(( bstat.pC > C ) && ( bstat.pC > bstat.ppC )) {
-      
-      float I = 0;
-      
-      /* integrator */
-      
-      for( int i = 0; i < BITLEN; ++i )
-	I += bstat.isample[( bstat.is + i ) % BITLEN];
-      
-      if( bstat.sgI == 0 ) {
-	if( I < 0 )
-	  bstat.sgI = -1;
-	else
-	  bstat.sgI = 1;
-	
-      }
-      
-      outbits =
-	( outbits >> 1 ) | uint8_t((( I * bstat.sgI ) > 0 ) ? 0x80 : 0 );
-      bt = true;
-      
-      bstat.ea = BITPLL * ( C - bstat.ppC );
-      if( bstat.ea > 2.0 )
-	bstat.ea = 2.0;
-      if( bstat.ea < -2.0 )
-	bstat.ea = -2.0;
-    }
-    
-    bstat.ppC = bstat.pC;
-    bstat.pC  = C;
-    
-  }
-  
-  return bt;
-  
+void process_ql(char *txt)
+{
+  printf("Destination station: %c%c%c%c\n",txt[0],txt[1],txt[2],txt[3]);
+  printf("IN event occured at: %c%c:%c%c\n",txt[4],txt[5],txt[6],txt[7]);
+  printf("Fuel quantity: %c%c%c%c\n",txt[8],txt[9],txt[10],txt[11]);
+  printf("Captain/First officer ID: %c\n",txt[12]);
+  printf("Departure station: %c%c%c%c\n",txt[13],txt[14],txt[15],txt[16]);
 }
 
+void process_qm(char *txt)
+{
+  printf("Destination station: %c%c%c%c\n",txt[0],txt[1],txt[2],txt[3]);
+  printf("Fuel quantity: %c%c%c%c\n",txt[4],txt[5],txt[6],txt[7]);
+  printf("Departure station: %c%c%c%c\n",txt[8],txt[9],txt[10],txt[11]);
+  printf("Category of landing: %c\n",txt[12]);
+}
 
-void
-init_bits(void) {
+void process_qn(char *txt)
+{
+  printf("Destination station: %c%c%c%c\n",txt[0],txt[1],txt[2],txt[3]);
+  printf("New destination station: %c%c%c%c\n",txt[4],txt[5],txt[6],txt[7]);
+  printf("ETA at diversion station: %c%c:%c%c\n",txt[8],txt[9],txt[10],txt[11]);
+  printf("Fuel quantity: %c%c%c%c\n",txt[12],txt[13],txt[14],txt[15]);
+  printf("Flight segment originating station: %c%c%c%c\n",txt[16],txt[17],txt[18],txt[19]);
+}
 
-  for( int i = 0; i < BITLEN; ++i ) 
-    h[i] = ( twoPI * float(i) / float(BITLEN));
-  volk_32f_sin_32f( h.get(), h.get(), h.size());
-  
-  for( int i = 0; i < BITLEN; ++i ) {
-    bstat.hsample[i] = bstat.lsample[i] =
-      bstat.isample[i] = bstat.qsample[i] =
-      bstat.csample[i] = 0.0;
-  }
-  
-  bstat.is = bstat.clock = 0;
-  bstat.sgI = bstat.sgQ = 0;
 
-  bstat.phih = bstat.phil = 0.0;
-  bstat.dfh  = bstat.dfl  = 0.0;
-  bstat.pC   = bstat.ppC  = 0.0;
-  bstat.ea  = 0.0;
-  bstat.lin = 1.0;
+void process_qp(char *txt)
+{
+  printf("Departure station: %c%c%c%c\n",txt[0],txt[1],txt[2],txt[3]);
+  printf("Destination station: %c%c%c%c\n",txt[4],txt[5],txt[6],txt[7]);
+  printf("OUT event occured at: %c%c:%c%c\n",txt[7],txt[8],txt[10],txt[11]);
+  printf("Boarded fuel: %c%c%c%c\n",txt[12],txt[13],txt[14],txt[15]);
+}
 
+void process_qq(char *txt)
+{
+  printf("Departure station: %c%c%c%c\n",txt[0],txt[1],txt[2],txt[3]);
+  printf("Destination station: %c%c%c%c\n",txt[4],txt[5],txt[6],txt[7]);
+  printf("OFF event occured at: %c%c:%c%c\n",txt[8],txt[9],txt[10],txt[11]);
 }
 
-inline void
-_reset_message_state_machine(void) {
+void process_qr(char *txt)
+{
+  printf("Departure station: %c%c%c%c\n",txt[0],txt[1],txt[2],txt[3]);
+  printf("Destination station: %c%c%c%c\n",txt[4],txt[5],txt[6],txt[7]);
+  printf("ON event occured at: %c%c:%c%c\n",txt[8],txt[9],txt[10],txt[11]);
+}
 
-  m_state.state             = STATE::HEADL;
-  m_state.syncForming       = 0;
-  m_state.syncBitsHave      = 0;
-  m_state.consecutivePreKey = 0;
-  m_state.crc               = 0;
-  
-  m_state.rawText.clear();
-  
+void process_qs(char *txt)
+{
+  printf("Destination station: %c%c%c%c\n",txt[0],txt[1],txt[2],txt[3]);
+  printf("New destination station: %c%c%c%c\n",txt[4],txt[5],txt[6],txt[7]);
+  printf("IN event occured at: %c%c:%c%c\n",txt[8],txt[9],txt[10],txt[11]);
+  printf("Fuel quantity: %c%c%c%c\n",txt[12],txt[13],txt[14],txt[15]);
+  printf("Flight segment originating station: %c%c%c%c\n",txt[16],txt[17],txt[18],txt[19]);
+  printf("Captain/First officer ID: %c\n",txt[20]);
 }
 
-inline void
-_reset_bit_state_machine( void ) {
+void process_qt(char *txt)
+{
+  printf("Departure station: %c%c%c%c\n",txt[0],txt[1],txt[2],txt[3]);
+  printf("Destination station: %c%c%c%c\n",txt[4],txt[5],txt[6],txt[7]);
+  printf("OUT event occured at: %c%c:%c%c\n",txt[8],txt[9],txt[10],txt[11]);
+  printf("Return IN event occured at: %c%c:%c%c\n",txt[12],txt[13],txt[14],txt[15]);
+  printf("Fuel onboard: %c%c%c%c\n",txt[16],txt[17],txt[18],txt[19]);
+}
 
-  // Wouldn't it also make sense to clear the accumulators?
-  
-  bstat.sgI = bstat.sgQ = 0;
+void process_57(char *txt)
+{
+  printf("Current position: %c%c%c%c%c\n",txt[0],txt[1],txt[2],txt[3],txt[4]);
+  printf("Current time: %c%c:%c%c\n",txt[5],txt[6],txt[7],txt[8]);
+  printf("Flight level: %c%c%c\n",txt[9],txt[10],txt[11]);
+  printf("Next report point: %c%c%c%c%c\n",txt[12],txt[13],txt[14],txt[15],txt[16]);
+  printf("Time over: %c%c:%c%c\n",txt[17],txt[18],txt[19],txt[20]);
+  printf("Fuel onboard: %c%c%c%c\n",txt[21],txt[22],txt[23],txt[24]);
+  printf("Static air temp: %c%c%c\n",txt[25],txt[26],txt[27]);
+  printf("Wind direction: %c%c%c deg.\n",txt[28],txt[29],txt[30]);
+  printf("Wind speed: %c%c%c knots.\n",txt[31],txt[32],txt[33]);
+  printf("Sky condition: %c%c%c%c%c%c%c%c\n",txt[34],txt[35],txt[36],txt[37],txt[38],txt[39],txt[40],txt[41]);
+  printf("Turbulence: %c%c%c%c%c%c%c%c\n",txt[42],txt[43],txt[44],txt[45],txt[46],txt[47],txt[48],txt[49]);
+  printf("Cruising speed: %c%c%c%c%c\n",txt[50],txt[51],txt[52],txt[54],txt[54]);
+}
 
+
+void process_h1(char *txt)
+{
+  if (!strncmp(txt,"#DF",3)) printf("Source: Digital Flight Data Acquisition Unit\n");
+  if (!strncmp(txt,"#CF",3)) printf("Source: Central Fault Display\n");
+  if (!strncmp(txt,"#M1",3)) printf("Source: Flight Management Computer, Left\n");
+  if (!strncmp(txt,"#M2",3)) printf("Source: Flight Management Computer, Right\n");
+  if (!strncmp(txt,"#M3",3)) printf("Source: Flight Management Computer, Center\n");
+  if (!strncmp(txt,"#MD",3)) printf("Source: Flight Management Computer, Selected\n");
+  if (!strncmp(txt,"#EC",3)) printf("Source: Engine Display System\n");
+  if (!strncmp(txt,"#EI",3)) printf("Source: Engine Indicating System\n");
+  if (!strncmp(txt,"#PS",3)) printf("Source: Keyboard/Display Unit\n");
+  if (!strncmp(txt,"#S1",3)) printf("Source: SDU, Left\n");
+  if (!strncmp(txt,"#S2",3)) printf("Source: SDU, Right\n");
+  if (!strncmp(txt,"#SD",3)) printf("Source: SDU, Selected\n");
+  if (!strncmp(txt,"#T",2)) printf("Source: Cabin Terminal Message\n");
+  if (!strncmp(txt,"#WO",3)) printf("Source: Weather Observation Report\n");
 }
 
-ssize_t
-getline(char **linep, size_t *np, FILE *stream) {
 
-  char *p = NULL;
-  size_t i = 0;
+void process_54(char *txt)
+{
+  printf("Frequency (MHZ): %c%c%c.%c%c%c\n",txt[0],txt[1],txt[2],txt[3],txt[4],txt[5]);
+}
 
-  if (!linep || !np) {
-    errno = EINVAL;
-    return -1;
-  }
 
-  if (!(*linep) || !(*np)) {
-    *np = 120;
-    *linep = (char *)malloc(*np);
-    if (!(*linep)) {
-      return -1;
+int is_flight_num(const uint8_t* text)
+{
+  int a=0;
+  int ok=1,dig=0;
+
+  while (a<6) 
+    {
+      if (!((text[a]=='-') || (text[a]=='.') || ((text[a]<='Z') && (text[a]>='A')) || ((text[a]>='0') && (text[a]<='9')))) ok = 0;
+      a++;
     }
-  }
+  if (!((text[2]>='0') && (text[a]<='9'))) ok = 0;
+  for (a=3;a<6;a++) if (((text[2]>='0') && (text[a]<='9'))) dig = 1;
+  if (dig==0) ok=0;
+  return ok;
+}
 
-  flockfile(stream);
 
-  p = *linep;
-  int ch;
-  for (ch = 0; (ch = getc_unlocked(stream)) != EOF;) {
-    if (i > *np) {
-      /* Grow *linep. */
-      size_t m = *np * 2;
-      char *s = (char *)realloc(*linep, m);
+void print_mesg(msg_t * msg, time_t t) {
 
-      if (!s) {
-        int error = errno;
-        funlockfile(stream);
-        errno = error;
-        return -1;
-      }
+  ProfileScope prof( Stage::PRINT_MESG );
 
-      *linep = s;
-      *np = m;
-    }
+  struct tm* tmp;
 
-    p[i] = ch;
-    if ('\n' == ch) break;
-    i += 1;
-  }
-  funlockfile(stream);
+  printf("\n[BEGIN_MESSAGE]----------------------------------------------------------\n\n");
+  printf("RX_IDX: %ld\n", msg->rx_idx);
+  if (msg->crc) printf("CRC: Bad, corrected (%d bit%s)\n", msg->crc,
+		       msg->crc == 1 ? "" : "s");
+  else printf("CRC: Correct\n");
+  if (msg->freq) printf("Frequency: %0.3f MHz\n", msg->freq / 1e6);
+  tmp = localtime(&t);
+  printf("Timestamp: %02d/%02d/%04d %02d:%02d\n",	     tmp->tm_mday, tmp->tm_mon + 1, tmp->tm_year + 1900,
+	 tmp->tm_hour, tmp->tm_min);
+  printf("ACARS mode: %c \n", msg->mode);
+  printf("Message label: %s ", msg->label);
 
-  /* Null-terminate the string. */
-  if (i > *np) {
-    /* Grow *linep. */
-    size_t m = *np * 2;
-    char *s = (char *)realloc(*linep, m);
+  for (long i = dataset.label((const char*)msg->label); i >= 0;
+       i = dataset.next_label(i))
+    printf("(%s)\n",dataset.label_at(i).ml_label);
 
-    if (!s) {
-      return -1;
+  printf("Aircraft reg: %s, ", msg->addr);
+  printf("flight id: %s\n", msg->fid);
+  if ((msg->addr)&&(strlen(msg->addr)<8)&&(strlen(msg->addr)>1)&&(strcmp(msg->addr,".......")!=0))
+    {
+      char regtmp[8];
+      memset(regtmp,0,8);
+      int ind = 0;
+      while ((ind<8)&&(msg->addr[ind]=='.')) ind++;
+      strcpy(regtmp,&msg->addr[ind]);
+
+      const long i = strlen(regtmp) ? dataset.aircraft(regtmp) : -1;
+      if (i >= 0) {
+	const acars_aircraft ac = dataset.aircraft_at(i);
+	printf("Aircraft: %s \n",ac.manufacturer);
+	printf("Registration: %s \n",ac.registration);
+	printf("Mode-S ID: %s\n",ac.modes);
+      }
     }
 
-    *linep = s;
-    *np = m;
-  }
+  // The airline is the flight ID's first two characters and the
+  // flight is looked up by what follows the third. The route's
+  // origin and destination are each taken from the first flight
+  // that has a known airport for it, and printed in the order those
+  // flights are in the dataset.
 
-  p[i + 1] = '\0';
-  return ((i > 0)? (ssize_t) i : -1);
-}
+  const char *fid = (const char*)msg->fid;
 
+  if ((strlen(fid)>1) && is_flight_num(msg->fid)) {
 
-int
-build_mesg( const std::vector<uint8_t>& txt, msg_t* msg) {
+    const long al = dataset.airline(fid);
 
-  std::vector<char> m;
-  int               k = 0;
+    if (al >= 0)
+      printf("Airline: %s \n",dataset.flight_at(al).airline);
 
-  assert( msg );
-  memset( msg, 0, sizeof( msg_t ));
-	  
-  // Remove framing and special characters (e.g., the SOH and the two
-  // CRC bytes).
+    if (strlen(fid)>3) {
 
-  for( size_t i = 1; i < ( txt.size() - 3 ); ++i ) {
+      const Dataset::leg_s from = dataset.departure(fid, fid+3);
+      const Dataset::leg_s to   = dataset.arrival(fid, fid+3);
 
-    char r = char( txt[i] & 0x7f );
-  
-    if( r < ' ' && r != CR && r != LF )
-      r = '.'; // was 0xa4 AR CHANGE: Set other placeholder
-    
-    m.push_back( r );
-    
-  }
+      for (int leg = 0; leg < 2; leg++) {
 
-  /* fill msg struct */
+	const bool from_first =
+	  (to.flight < 0) || ((from.flight >= 0) && (from.flight <= to.flight));
+	const Dataset::leg_s &l = ((leg == 0) == from_first) ? from : to;
 
-  msg->mode = m[k++];
+	if (l.flight < 0)
+	  continue;
 
-  for( int i = 0; i < 7; ++i ) 
-    msg->addr[i] = m[k++];
-  
-  /* ACK/NAK */
-  msg->ack = m[k++];
+	const acars_airport ap = dataset.airport_at(l.airport);
+	printf("%s: %s - %s (%s, %s) \n", (&l == &from) ? "From" : "To",
+	       ap.code,ap.name,ap.city,ap.country);
+      }
+    }
+  }
+
+  printf("\nBlock id: %d, ", (int) msg->bid);
+  printf(" msg. no: %s\n", msg->no);
+  if (!strcmp(msg->label,"QV")) process_qv(msg->txt);
+  if (!strcmp(msg->label,"5U")) process_5u(msg->txt);
+  if (!strcmp(msg->label,"SA")) process_sa(msg->txt);
+  if (!strcmp(msg->label,"Q1")) process_q1(msg->txt);
+  if (!strcmp(msg->label,"Q2")) process_q2(msg->txt);
+  if (!strcmp(msg->label,"QA")) process_qa(msg->txt);
+  if (!strcmp(msg->label,"QB")) process_qb(msg->txt);
+  if (!strcmp(msg->label,"QC")) process_qc(msg->txt);
+  if (!strcmp(msg->label,"QD")) process_qd(msg->txt);
+  if (!strcmp(msg->label,"QE")) process_qr(msg->txt);
+  if (!strcmp(msg->label,"QF")) process_qf(msg->txt);
+  if (!strcmp(msg->label,"QG")) process_qg(msg->txt);
+  if (!strcmp(msg->label,"QH")) process_qh(msg->txt);
+  if (!strcmp(msg->label,"QK")) process_qk(msg->txt);
+  if (!strcmp(msg->label,"QL")) process_ql(msg->txt);
+  if (!strcmp(msg->label,"QM")) process_qm(msg->txt);
+  if (!strcmp(msg->label,"QN")) process_qn(msg->txt);
+  if (!strcmp(msg->label,"QP")) process_qp(msg->txt);
+  if (!strcmp(msg->label,"QQ")) process_qq(msg->txt);
+  if (!strcmp(msg->label,"QR")) process_qr(msg->txt);
+  if (!strcmp(msg->label,"QS")) process_qs(msg->txt);
+  if (!strcmp(msg->label,"QT")) process_qt(msg->txt);
+  if (!strcmp(msg->label,"57")) process_57(msg->txt);
+  if (!strcmp(msg->label,"H1")) process_h1(msg->txt);
+  if (!strcmp(msg->label,"54")) process_54(msg->txt);
 
-  msg->label[0] = m[k++];
-  msg->label[1] = m[k++];
+  printf("Message content:-\n%s", msg->txt);
 
-  msg->bid = m[k];
-  k++;
-  k++;
 
-  for( int i = 0; i < 4; ++i ) 
-    msg->no[i] = m[k++];
-  
-  for( int i = 0; i < 6; ++i ) 
-    msg->fid[i] = m[k++];
 
-  for( size_t i = 0; size_t(k) < m.size(); ++i )
-    msg->txt[i] = m[k++];
+  printf
+    ("\n\n[END_MESSAGE ]------------------------------------------------------------\n\n");
 
-  return 1;
 }
 
+///////// END OF ACARS ROUTINES //////////
 
-int
-_getmesg( const uint8_t& r, msg_t* msg ) noexcept {
 
-  assert( msg );
-  
-  // This is a confusing loop. The point of the loop is to allow a
-  // state change to process the word a second time. Specifically,
-  // when the state changes from PRE-KEY to BIT SYNC. In this case the
-  // code has been processing PRE KEY words but suddenly the word
-  // isn't PRE-KEY and it might be a forming BIT SYNC. In that case,
-  // loop again until some condition is met.
-
-  if( m_state.state != STATE::HEADL )
-    if( verbose > 3 )
-      std::cout << m_state.state << ": "
-		<< std::hex << unsigned(r) << std::dec
-		<< std::endl;
-      
-  do {
 
-    switch( m_state.state ) {
-      
-      // PREKEY lost. Looking for PRE-KEY.
-      
-    case STATE::HEADL:
-      
-      if( r == PRE_KEY_CHAR ) {
-	
-	if( ++m_state.consecutivePreKey > m_state.consecutivePreKeyLim )
-	  m_state.state = STATE::HEADF;
-	
-      } else {
-	
-	_reset_bit_state_machine();
-	_reset_message_state_machine();
-	
-      }
-      
-      return 1;
-      
-      // PRE-KEY found. Keep looking for PRE-KEY characters. If the
-      // character isn't a PRE-KEY then advance the state machine to
-      // sync.
-      
-    case STATE::HEADF:
-      
-      // If the character isn't a PRE-KEY then we might be seeing the
-      // start of the SYNC characters, so advance the state
-      // machine. If the character is a PRE-KEY then we don't want to
-      // risk consuming the first bits of the BIT SYNC, which are 11.
-
-      if( r == PRE_KEY_CHAR ) {
-	
-	return 1;
-	
-      } else {
-	
-	m_state.state        = STATE::SYNC;
-	m_state.syncForming  = 0;
-	m_state.syncBitsHave = 0;
-	
-      }
-      break;
-      
-      // If the character is the first bitsync then advance the state
-      // machine to the second bitsync.
-      
-    case STATE::SYNC:
-      
-      if(( verbose > 3 ) && 0 )
-	std::cout << "STATE::SYNC" << std::endl;
-      
-      { static const uint64_t syncCheck =
-	  ( uint64_t( _to_odd( BIT_SYNC_1 ))  <<  0 ) |
-	  ( uint64_t( _to_odd( BIT_SYNC_2 ))  <<  8 ) |
-	  ( uint64_t( _to_odd( CHAR_SYNC_1 )) << 16 ) |
-	  ( uint64_t( _to_odd( CHAR_SYNC_2 )) << 24 ) |
-	  ( uint64_t( _to_odd( SOH ))         << 32 );
-	
-	int bitsConsumed = 0;
-	
-	for( int i = 0; i < 8; ++i ) {
-	  
-	  static const std::vector<uint8_t> mask = {
-	    0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80
-	  };
-	  
-	  // Add a bit from the passed word to the sync word.
-	  
-	  m_state.syncForming >>= 1;
-	  if( mask[i] & r )
-	    m_state.syncForming |= uint64_t(0x00008000000000);
-	  ++bitsConsumed;
-	  
-	  // If we have collected enough bits to check for the SYNC
-	  // words and SOH then do so.
-	  
-	  if( ++m_state.syncBitsHave >= 40  /* 5*8=40 */ ) {
-
-            if( verbose > 3 )
-	      _dump_sync( syncCheck, m_state.syncForming );
-	    
-	    if ( _count_bit_errors( m_state.syncForming, syncCheck ) <=
-		 m_state.errLim ) {
-	      
-	      // The formed word has less than some number of errors
-	      // and that is enough to declare SYNC and collect TXT.
-	      
-	      m_state.state = STATE::TXT;
-
-	      m_state.rawText.clear();
-	      m_state.rawText.push_back( _to_odd( SOH ));
-	      
-	      return bitsConsumed;
-	      
-	    }
-	  }
-	  
-	  // If the number of bits collected to search for the SYNC
-	  // words and SOH has been exhausted then start over.
 
-	  if( m_state.syncBitsHave >= m_state.syncBitsLim ) {
-	    
-	    m_state.state = STATE::HEADL;
-	    break;
-	    
-	  }
-	}
-	
-	return bitsConsumed;
-	
-      }
-      
-      // Collect text characters until either an ETX or ETB character
-      // is encountered or until the buffer fills. If the buffer fills
-      // then discard the message.
-      //
-      // Clearly, if there is a bit error in ETX/ETB then it cannot be
-      // absorbed. Need to fix that.
-      
-    case STATE::TXT:
-      
-      if( verbose > 2 )
-	std::cout << "STATE::TXT size= "
-		  << m_state.rawText.size()
-		  << " + 1"
-		  << std::endl;
-      
-      // Save the character.
-      
-      m_state.rawText.push_back( r );
-      
-      // If the buffer is full then reset the state machine.
-      
-#define BMAX ( MODE_BYTES + ADDRESS_BYTES + ACK_NAK_BYTES +	   \
-	       LABEL_BYTES + BLOCK_ID_BYTES + STX_BYTES +	   \
-	       SEQ_NUM_BYTES + FLIGHT_NUM_BYTES + MAX_TEXT_BYTES + \
-	       ETX_BYTES )
-      
-      if(  m_state.rawText.size() > BMAX ) {
-	
-	m_state.state = STATE::HEADL;
-	break;
-	
-      }
-      
-      // If it's an ETX or ETB then advance the state machine to
-      // collect the CRC.
-      
-      if(( r == _to_odd( ETX )) || ( r == _to_odd( ETB ))) {
-	
-	m_state.state = STATE::CRC1;
-	return 8;
-	
-      }
-
-      return 8;
-      
-      // For the states CRC1 and CRC2 simply collect the CRC bytes.
-      
-    case STATE::CRC1:
-      
-      if( verbose > 2 )
-	std::cout << "STATE::CRC1" << std::endl;
-
-      m_state.rawText.push_back( r );
-      m_state.state = STATE::CRC2;
-      
-      return 8;
-      
-    case STATE::CRC2:
-      
-      if( verbose > 2 )
-	std::cout << "STATE::CRC1" << std::endl;
-      
-      m_state.rawText.push_back( r );
-      m_state.state = STATE::END;
-      
-      return 8;
-      
-      // First, when the end state is reached then reset the state
-      // machine.
-      
-    case STATE::END:
-      
-      if( verbose > 2 )
-	std::cout << "STATE::END" << std::endl;
-
-      // The next state is to start over.
-      
-      m_state.state = STATE::HEADL;
-
-      // Check the CRC.
 
-      if( gen_crc( m_state.rawText.begin(),
-		   m_state.rawText.cend()) == 0x0000 ) {
 
-	m_state.crc = 0;
+/* more cond dumbness */
+#define safe_cond_signal(n, m) pthread_mutex_lock(m); pthread_cond_signal(n); pthread_mutex_unlock(m)
 
-	build_mesg( m_state.rawText, msg );
 
-	return -1;
-	
-      } else {
+/* 90 rotation is 1+0j, 0+1j, -1+0j, 0-1j
+   or [0, 1, -3, 2, -4, -5, 7, -6] */
 
-	// Correct one bit error.
+void
+rotate_90( uint8_t* buf, uint32_t len ) {
+  
+  ProfileScope prof( Stage::ROTATE_90, len / 2 );
 
-	for( size_t i = 0; i < m_state.rawText.size(); ++i ) {
-	  for( int j = 0; j < 8; ++j ) {
+  for( uint32_t i = 0; i < len; i += 8 ) {
 
-	    m_state.rawText[i] ^= mask[j];
+    uint8_t tmp;
+    
+    /* uint8_t negation = 255 - x */
 
-	    if( gen_crc( m_state.rawText.begin(),
-			 m_state.rawText.cend()) == 0x0000 ) {
+    tmp = 255 - buf[i+3];
+    buf[i+3] = buf[i+2];
+    buf[i+2] = tmp;
 
-	      m_state.crc = 0;
+    buf[i+4] = 255 - buf[i+4];
+    buf[i+5] = 255 - buf[i+5];
 
-	      build_mesg( m_state.rawText, msg );
-	      
-	      return -1;
+    tmp = 255 - buf[i+6];
+    buf[i+6] = buf[i+7];
+    buf[i+7] = tmp;
+  }
+}
 
-	    } else
-	      m_state.rawText[i] ^= mask[j];
+void low_pass(struct fm_state *fm, unsigned char *buf, uint32_t len)
+/* simple square window FIR */
+{
+  ProfileScope prof(Stage::LOW_PASS, len / 2);
+  int i=0, i2=0, seq=0;
+  while (i < (int)len) {
+    fm->now_r += ((int)buf[i]   - 127);
+    fm->now_j += ((int)buf[i+1] - 127);
+    i += 2;
+    fm->prev_index++;
 
-	  }
-	}
+    if ( (fm->prev_index<(fm->downsample)) ) continue;
+    if ((seq%2)==1)
+      {
+	// signal is ~10khz wide, don't need whole 48khz
+	// eliminate some RF noise by attenuating stuff outside 24khz a bit
+	fm->signal[i2]   = (fm->now_r*5)/(8); 
+	fm->signal[i2+1] = (fm->now_j*5)/(8);
       }
-
-      std::cout << std::endl << "CRC check failure" << std::endl;
-#ifdef dpgdebug0
-      { std::streamsize         width = std::cout.width();
-	std::ios_base::fmtflags flags = std::cout.flags();
-	char                    fill  = std::cout.fill();
-	
-	for( size_t i = 0; i < m_state.rawText.size(); ++i )
-	  std::cout << "0x" << std::hex << std::setfill('0') << std::setw(2)
-		    << unsigned( m_state.rawText[i])
-		    << std::dec
-		    << "(" << char(m_state.rawText[i]&0x7f ) << ") ";
-	std::cout << std::endl << std::endl;
-	
-	std::cout.width( width );
-	std::cout.setf( flags );
-	std::cout.fill( fill );
+    else
+      {
+	fm->signal[i2]   = fm->now_r;// * fm->output_scale;
+	fm->signal[i2+1] = fm->now_j;// * fm->output_scale;
       }
-#endif
-      
-      return 8;
-      
-    }
-  } while( true );
+    seq++;
+    fm->prev_index = 0;
+    fm->now_r = 0;
+    fm->now_j = 0;
+    i2 += 2;
+  }
+  fm->signal_len = i2;
 }
 
 
-void process_qv(char *txt)
+// The FIR is designed for the capture rate, so it's built after
+// optimal_settings() has picked it.
+
+void build_fir(struct fm_state *fm)
 {
-  switch (txt[0])
-    {
-    case '1': printf("\nAutotune reject reason: Contrary to airline preference\n");break;
-    case '2': printf("\nATN session in progress\n");break;
-    case '3': printf("\nAutotune uplink format error\n");break;
-    default: printf("\nAutotune reject reason: unknown\n");
-    }
+  if (!fm->fir_enable)
+    return;
+  fm->fir.reset(new Decimator(fm->downsample, fm->fir_taps,
+			      double(fm->downsample) * fm->sample_rate));
 }
 
 
-void process_sa(char *txt)
+void low_pass_fir(struct fm_state *fm, unsigned char *buf, uint32_t len)
+/* polyphase, in place of low_pass()'s square window */
 {
-  printf("Version: %c\n",txt[0]);
-  if (txt[1]=='E')
-    printf("Link state: Established\n");
-  else
-    if (txt[1]=='L')
-      printf("Link state: Lost\n");
-    else
-      printf("Link state: Unknown\n");
-  
-  switch (txt[2]) {
-    case 'V': printf("Link type: VHF ACARS\n");break;
-    case 'S': printf("Link type: Generic SATCOM\n");break;
-    case 'H': printf("Link type: HF\n");break;
-    case 'G': printf("Link type: GlobalStar SATCOM\n");break;
-    case 'C': printf("Link type: ICO SATCOM\n");break;
-    case '2': printf("Link type: VDL Mode 2\n");break;
-    case 'X': printf("Link type: Inmarsat Aero\n");break;
-    case 'I': printf("Link type: Irridium SATCOM\n");break;
-    default:  printf("Link type: Unknown\n");
-    }
-  printf("Event occured at: %c%c:%c%c:%c%c\n",txt[3],txt[4],txt[5],txt[6],txt[7],txt[8]);
+  ProfileScope prof(Stage::LOW_PASS, len / 2);
+  fm->signal_len = 2 * int(fm->fir->push(buf, len, fm->signal));
 }
 
 
-void
-process_5u(char *txt) {
-
-  char airport[4];
-  int cur=0;
-  int cur2=0;
-  int i=0;
-    
-  printf("Weather report requested from: ");
-  while (txt[cur]!=0) {
-    
-    if ((txt[cur]<='Z')&&(txt[cur]>='A')) {
-      
-	  airport[cur2]=txt[cur];
-	  cur2++;
-
-	  if (cur2==4) {
-	    
-	      i=0;
-	      while(acars_airports[i].code) {
-		
-		  const char *regtmp = (const char *) airport;
-
-		  while (regtmp[0] == '.')
-		    regtmp++;
-
-		  if(!strcmp(acars_airports[i].code, regtmp))
-		    printf("%s (%s) ",acars_airports[i].name,acars_airports[i].city);
-		  i++;
-	      }
-	      cur2 = 0;
-	  }
-    } else
-      cur2=0;
-    cur++;
+int low_pass_simple(int16_t *signal2, int len, int step)
+// no wrap around, length must be multiple of step
+{
+  ProfileScope prof(Stage::LOW_PASS_SIMPLE, len);
+  int i, i2, sum;
+  for(i=0; i < len; i+=step) {
+    sum = 0;
+    for(i2=0; i2<step; i2++)
+      sum += (int)signal2[i + i2];
+   
+    //signal2[i/step] = (int16_t)(sum / step);
+    signal2[i/step] = (int16_t)(sum);
   }
-  printf("\n");
+  signal2[i/step + 1] = signal2[i/step];
+  return len / step;
 }
 
-void process_q1(char *txt)
-{
-  printf("Departure station: %c%c%c%c\n",txt[0],txt[1],txt[2],txt[3]);
-  printf("OUT event occured at: %c%c:%c%c\n",txt[4],txt[5],txt[6],txt[7]);
-  printf("OFF event occured at: %c%c:%c%c\n",txt[8],txt[9],txt[10],txt[11]);
-  printf("ON event occured at: %c%c:%c%c\n",txt[12],txt[13],txt[14],txt[15]);
-  printf("IN event occured at: %c%c:%c%c\n",txt[16],txt[17],txt[18],txt[19]);
-  printf("Fuel: %c%c%c%c\n",txt[20],txt[21],txt[22],txt[23]);
-  printf("Destination station: %c%c%c%c\n",txt[24],txt[25],txt[26],txt[27]);
-}
 
-void process_q2(char *txt)
+void low_pass_real(struct fm_state *fm)
+/* simple square window FIR */
+// add support for upsampling?
 {
-  printf("Departure station: %c%c%c%c\n",txt[0],txt[1],txt[2],txt[3]);
-  printf("ETA: %c%c:%c%c\n",txt[4],txt[5],txt[6],txt[7]);
-  printf("Fuel: %c%c%c%c\n",txt[8],txt[9],txt[10],txt[11]);
+  int i=0, i2=0;
+  int fast = (int)fm->sample_rate / (fm->post_downsample);
+  int slow = fm->output_rate;
+  while (i < fm->signal2_len) {
+    fm->now_lpr += fm->signal2[i];
+    i++;
+    fm->prev_lpr_index += slow;
+    if (fm->prev_lpr_index < fast) {
+      continue;
+    }
+    fm->signal2[i2] = (int16_t)(fm->now_lpr / (fast/slow));
+    fm->prev_lpr_index -= fast;
+    fm->now_lpr = 0;
+    i2 += 1;
+  }
+  fm->signal2_len = i2;
 }
 
-void process_qa(char *txt)
-{
-  printf("Departure station: %c%c%c%c\n",txt[0],txt[1],txt[2],txt[3]);
-  printf("OUT event occured at: %c%c:%c%c\n",txt[4],txt[5],txt[6],txt[7]);
-  printf("Boarded fuel: %c%c%c%c%c\n",txt[8],txt[9],txt[10],txt[11],txt[12]);
-  printf("Fuel quantity: %c%c%c%c\n",txt[13],txt[14],txt[15],txt[16]);
-}
 
-void process_qb(char *txt)
-{
-  printf("Departure station: %c%c%c%c\n",txt[0],txt[1],txt[2],txt[3]);
-  printf("OFF event occured at: %c%c:%c%c\n",txt[4],txt[5],txt[6],txt[7]);
-}
+/* define our own complex math ops
+   because ARMv5 has no hardware float */
 
-void process_qc(char *txt)
+inline void
+multiply(int ar, int aj, int br, int bj, int *cr, int *cj)
 {
-  printf("Departure station: %c%c%c%c\n",txt[0],txt[1],txt[2],txt[3]);
-  printf("ON event occured at: %c%c:%c%c\n",txt[4],txt[5],txt[6],txt[7]);
+  *cr = ar*br - aj*bj;
+  *cj = aj*br + ar*bj;
 }
 
-void process_qd(char *txt)
+
+int polar_discriminant(int ar, int aj, int br, int bj)
 {
-  printf("Departure station: %c%c%c%c\n",txt[0],txt[1],txt[2],txt[3]);
-  printf("IN event occured at: %c%c:%c%c\n",txt[4],txt[5],txt[6],txt[7]);
-  printf("Boarded fuel: %c%c%c%c%c\n",txt[8],txt[9],txt[10],txt[11],txt[12]);
-  printf("Fuel quantity: %c%c%c%c\n",txt[13],txt[14],txt[15],txt[16]);
-  printf("Captain/First officer ID: %c\n",txt[17]);
+  int cr, cj;
+  double angle;
+  multiply(ar, aj, br, -bj, &cr, &cj);
+  angle = atan2((double)cj, (double)cr);
+  return (int)(angle / 3.14159 * (1<<14));
 }
 
 
-void process_qe(char *txt)
+int fast_atan2(int y, int x)
+/* pre scaled for int16 */
 {
-  printf("Departure station: %c%c%c%c\n",txt[0],txt[1],txt[2],txt[3]);
-  printf("OUT event occured at: %c%c:%c%c\n",txt[4],txt[5],txt[6],txt[7]);
-  printf("Boarded fuel: %c%c%c%c%c\n",txt[8],txt[9],txt[10],txt[11],txt[12]);
-  printf("Fuel quantity: %c%c%c%c\n",txt[13],txt[14],txt[15],txt[16]);
-  printf("Destination station: %c%c%c\n",txt[17],txt[18],txt[19]);
+  int yabs, angle;
+  int pi4=(1<<12), pi34=3*(1<<12);  // note pi = 1<<14
+  if (x==0 && y==0) {
+    return 0;
+  }
+  yabs = y;
+  if (yabs < 0) {
+    yabs = -yabs;
+  }
+  if (x >= 0) {
+    angle = pi4  - pi4 * (x-yabs) / (x+yabs);
+  } else {
+    angle = pi34 - pi4 * (x+yabs) / (yabs-x);
+  }
+  if (y < 0) {
+    return -angle;
+  }
+  return angle;
 }
 
-void process_qf(char *txt)
+
+int polar_disc_fast(int ar, int aj, int br, int bj)
 {
-  printf("Departure station: %c%c%c%c\n",txt[0],txt[1],txt[2],txt[3]);
-  printf("OFF event occured at: %c%c:%c%c\n",txt[4],txt[5],txt[6],txt[7]);
-  printf("Destination station: %c%c%c%c\n",txt[8],txt[9],txt[10],txt[11]);
+  int cr, cj;
+  multiply(ar, aj, br, -bj, &cr, &cj);
+  return fast_atan2(cj, cr);
 }
 
 
-void process_qg(char *txt)
+int atan_lut_init()
 {
-  printf("Departure station: %c%c%c%c\n",txt[0],txt[1],txt[2],txt[3]);
-  printf("OUT event occured at: %c%c:%c%c\n",txt[4],txt[5],txt[6],txt[7]);
-  printf("Return IN event occured at: %c%c:%c%c\n",txt[8],txt[9],txt[10],txt[11]);
-}
+  int i = 0;
 
-void process_qh(char *txt)
-{
-  printf("Departure station: %c%c%c%c\n",txt[0],txt[1],txt[2],txt[3]);
-  printf("OUT event occured at: %c%c:%c%c\n",txt[4],txt[5],txt[6],txt[7]);
+  atan_lut = (int*)malloc(atan_lut_size * sizeof(int));
+
+  for (i = 0; i < atan_lut_size; i++) {
+    atan_lut[i] = (int) (atan((double) i / (1<<atan_lut_coef)) / 3.14159 * (1<<14));
+  }
+
+  return 0;
 }
 
 
-void process_qk(char *txt)
+int polar_disc_lut(int ar, int aj, int br, int bj)
 {
-  printf("Departure station: %c%c%c%c\n",txt[0],txt[1],txt[2],txt[3]);
-  printf("ON event occured at: %c%c:%c%c\n",txt[4],txt[5],txt[6],txt[7]);
-  printf("Destination station: %c%c%c%c\n",txt[8],txt[9],txt[10],txt[11]);
+  int cr, cj, x, x_abs;
+
+  multiply(ar, aj, br, -bj, &cr, &cj);
+
+  /* special cases */
+  if (cr == 0 || cj == 0) {
+    if (cr == 0 && cj == 0)
+      {return 0;}
+    if (cr == 0 && cj > 0)
+      {return 1 << 13;}
+    if (cr == 0 && cj < 0)
+      {return -(1 << 13);}
+    if (cj == 0 && cr > 0)
+      {return 0;}
+    if (cj == 0 && cr < 0)
+      {return 1 << 14;}
+  }
+
+  /* real range -32768 - 32768 use 64x range -> absolute maximum: 2097152 */
+  x = (cj << atan_lut_coef) / cr;
+  x_abs = abs(x);
+
+  if (x_abs >= atan_lut_size) {
+    /* we can use linear range, but it is not necessary */
+    return (cj > 0) ? 1<<13 : -1<<13;
+  }
+
+  if (x > 0) {
+    return (cj > 0) ? atan_lut[x] : atan_lut[x] - (1<<14);
+  } else {
+    return (cj > 0) ? (1<<14) - atan_lut[-x] : -atan_lut[-x];
+  }
+
+  return 0;
 }
 
-void process_ql(char *txt)
+
+void am_demod(struct fm_state *fm)
+// todo, fix this extreme laziness
 {
-  printf("Destination station: %c%c%c%c\n",txt[0],txt[1],txt[2],txt[3]);
-  printf("IN event occured at: %c%c:%c%c\n",txt[4],txt[5],txt[6],txt[7]);
-  printf("Fuel quantity: %c%c%c%c\n",txt[8],txt[9],txt[10],txt[11]);
-  printf("Captain/First officer ID: %c\n",txt[12]);
-  printf("Departure station: %c%c%c%c\n",txt[13],txt[14],txt[15],txt[16]);
+  ProfileScope prof(Stage::AM_DEMOD, fm->signal_len / 2);
+  int i, pcm;
+  for (i = 0; i < (fm->signal_len); i += 2) {
+    // hypot uses floats but won't overflow
+    //fm->signal2[i/2] = (int16_t)hypot(fm->signal[i], fm->signal[i+1]);
+    pcm = fm->signal[i] * fm->signal[i];
+    pcm += fm->signal[i+1] * fm->signal[i+1];
+    fm->signal2[i/2] = (int16_t)sqrt(pcm) * fm->output_scale;
+    // Milen: add some gain to signal
+    fm->signal2[i/2] *= 8;
+  }
+  fm->signal2_len = fm->signal_len/2;
+  // lowpass? (3khz)  highpass?  (dc)
 }
 
-void process_qm(char *txt)
+
+void deemph_filter(struct fm_state *fm)
 {
-  printf("Destination station: %c%c%c%c\n",txt[0],txt[1],txt[2],txt[3]);
-  printf("Fuel quantity: %c%c%c%c\n",txt[4],txt[5],txt[6],txt[7]);
-  printf("Departure station: %c%c%c%c\n",txt[8],txt[9],txt[10],txt[11]);
-  printf("Category of landing: %c\n",txt[12]);
+  ProfileScope prof(Stage::DEEMPH_FILTER, fm->signal2_len);
+  int i, d;
+  int avg = fm->deemph_avg;
+  // de-emph IIR
+  // avg = avg * (1 - alpha) + sample * alpha;
+  for (i = 0; i < fm->signal2_len; i++) {
+    d = fm->signal2[i] - avg;
+    if (d > 0) {
+      avg += (d + fm->deemph_a/2) / fm->deemph_a;
+    } else {
+      avg += (d - fm->deemph_a/2) / fm->deemph_a;
+    }
+    fm->signal2[i] = (int16_t)avg;
+  }
+  fm->deemph_avg = avg;
 }
 
-void process_qn(char *txt)
+
+void dc_block_filter(struct fm_state *fm)
 {
-  printf("Destination station: %c%c%c%c\n",txt[0],txt[1],txt[2],txt[3]);
-  printf("New destination station: %c%c%c%c\n",txt[4],txt[5],txt[6],txt[7]);
-  printf("ETA at diversion station: %c%c:%c%c\n",txt[8],txt[9],txt[10],txt[11]);
-  printf("Fuel quantity: %c%c%c%c\n",txt[12],txt[13],txt[14],txt[15]);
-  printf("Flight segment originating station: %c%c%c%c\n",txt[16],txt[17],txt[18],txt[19]);
+  ProfileScope prof(Stage::DC_BLOCK_FILTER, fm->signal2_len);
+  int i, avg;
+  int64_t sum = 0;
+  for (i=0; i < fm->signal2_len; i++) {
+    sum += fm->signal2[i];
+  }
+  avg = sum / fm->signal2_len;
+  avg = (avg + fm->dc_avg * 9) / 10;
+  for (i=0; i < fm->signal2_len; i++) {
+    fm->signal2[i] -= avg;
+  }
+  fm->dc_avg = avg;
 }
 
 
-void process_qp(char *txt)
+int mad(const int *samples, int len, int step)
+/* mean average deviation */
 {
-  printf("Departure station: %c%c%c%c\n",txt[0],txt[1],txt[2],txt[3]);
-  printf("Destination station: %c%c%c%c\n",txt[4],txt[5],txt[6],txt[7]);
-  printf("OUT event occured at: %c%c:%c%c\n",txt[7],txt[8],txt[10],txt[11]);
-  printf("Boarded fuel: %c%c%c%c\n",txt[12],txt[13],txt[14],txt[15]);
+  int i=0, sum=0, ave=0;
+  if (len == 0)
+    {return 0;}
+  for (i=0; i<len; i+=step) {
+    sum += samples[i];
+  }
+  ave = sum / (len * step);
+  sum = 0;
+  for (i=0; i<len; i+=step) {
+    sum += abs(samples[i] - ave);
+  }
+  return sum / (len / step);
 }
 
-void process_qq(char *txt)
+
+int post_squelch(struct fm_state *fm)
+/* returns 1 for active signal, 0 for no signal */
 {
-  printf("Departure station: %c%c%c%c\n",txt[0],txt[1],txt[2],txt[3]);
-  printf("Destination station: %c%c%c%c\n",txt[4],txt[5],txt[6],txt[7]);
-  printf("OFF event occured at: %c%c:%c%c\n",txt[8],txt[9],txt[10],txt[11]);
+  ProfileScope prof(Stage::POST_SQUELCH, fm->signal_len / 2);
+  int dev_r, dev_j, len, sq_l;
+  /* only for small samples, big samples need chunk processing */
+  len = fm->signal_len;
+  sq_l = fm->squelch_level;
+  dev_r = mad(&(fm->signal[0]), len, 2);
+  dev_j = mad(&(fm->signal[1]), len, 2);
+  //fprintf(stderr,"shits: %d dr: %d dj: %d sql: %d\n ",fm->squelch_hits,dev_r,dev_j,sq_l);
+
+  if ((dev_r > sq_l) || (dev_j > sq_l)) {
+    fm->squelch_hits = 0;
+    return 1;
+  }
+  fm->squelch_hits++;
+  return 0;
 }
 
-void process_qr(char *txt)
+
+// What the dongle is tuned to for freqs[freq]: a quarter of the
+// capture rate under it, for rotate_90().
+
+static int tuned_freq(const struct fm_state *fm, int freq)
 {
-  printf("Departure station: %c%c%c%c\n",txt[0],txt[1],txt[2],txt[3]);
-  printf("Destination station: %c%c%c%c\n",txt[4],txt[5],txt[6],txt[7]);
-  printf("ON event occured at: %c%c:%c%c\n",txt[8],txt[9],txt[10],txt[11]);
+  return fm->freqs[freq] + fm->downsample * fm->sample_rate / 4 +
+    fm->edge * fm->sample_rate / 2;
 }
 
-void process_qs(char *txt)
+static void optimal_settings(struct fm_state *fm, int freq, int hopping)
 {
-  printf("Destination station: %c%c%c%c\n",txt[0],txt[1],txt[2],txt[3]);
-  printf("New destination station: %c%c%c%c\n",txt[4],txt[5],txt[6],txt[7]);
-  printf("IN event occured at: %c%c:%c%c\n",txt[8],txt[9],txt[10],txt[11]);
-  printf("Fuel quantity: %c%c%c%c\n",txt[12],txt[13],txt[14],txt[15]);
-  printf("Flight segment originating station: %c%c%c%c\n",txt[16],txt[17],txt[18],txt[19]);
-  printf("Captain/First officer ID: %c\n",txt[20]);
+  int r, capture_freq, capture_rate;
+  fm->downsample = fm->decimation ?
+    fm->decimation : (1000000 / fm->sample_rate) + 1;
+
+  fm->freq_now = freq;
+  capture_rate = fm->downsample * fm->sample_rate;
+  capture_freq = tuned_freq(fm, freq);
+  fm->output_scale = (1<<15) / (128 * fm->downsample);
+  if (fm->output_scale < 1) 
+    fm->output_scale = 1;
+  /* Set the frequency */
+  r = fm->dev ? rtlsdr_set_center_freq(fm->dev, (uint32_t)capture_freq) : 0;
+  if (hopping) {
+    return;}
+		
+  // Milen: don't need 48khz signal, set cutoff at ~16khz
+  //fm->downsample /=2;
+  //fm->post_downsample*=2;
+
+		
+  fprintf(stderr, "Oversampling input by: %ix.\n", fm->downsample);
+  fprintf(stderr, "Oversampling output by: %ix.\n", fm->post_downsample);
+  fprintf(stderr, "Buffer size: %0.2fms\n",
+	  1000 * 0.5 * (float)ACTUAL_BUF_LENGTH / (float)capture_rate);
+  if (r < 0) {
+    fprintf(stderr, "WARNING: Failed to set center freq.\n");}
+  else {
+    fprintf(stderr, "Tuned to %u Hz.\n", capture_freq);}
+
+  /* Set the sample rate */
+  fprintf(stderr, "Sampling at %u Hz.\n", capture_rate);
+  if (fm->output_rate > 0) {
+    fprintf(stderr, "Output at %u Hz.\n", fm->output_rate);
+  } else {
+    fprintf(stderr, "Output at %u Hz.\n", fm->sample_rate/fm->post_downsample);}
+  r = fm->dev ? rtlsdr_set_sample_rate(fm->dev, (uint32_t)capture_rate) : 0;
+  if (r < 0) {
+    fprintf(stderr, "WARNING: Failed to set sample rate.\n");}
+
 }
 
-void process_qt(char *txt)
+
+// Pick the capture rate and centre frequency for wideband mode. The
+// rate is the smallest multiple of the bit former's rate that holds
+// every channel, and the centre is kept off the channels so none of
+// them sits on the dongle's DC spike. Returns the decimation, or zero
+// if the channels don't fit. Nothing is printed or tuned unless apply
+// is set.
+
+static int wideband_settings(struct fm_state *fm, int apply)
 {
-  printf("Departure station: %c%c%c%c\n",txt[0],txt[1],txt[2],txt[3]);
-  printf("Destination station: %c%c%c%c\n",txt[4],txt[5],txt[6],txt[7]);
-  printf("OUT event occured at: %c%c:%c%c\n",txt[8],txt[9],txt[10],txt[11]);
-  printf("Return IN event occured at: %c%c:%c%c\n",txt[12],txt[13],txt[14],txt[15]);
-  printf("Fuel onboard: %c%c%c%c\n",txt[16],txt[17],txt[18],txt[19]);
+  static const int nudge[] = { 0, 25000, -25000, 50000, -50000,
+			       75000, -75000, 100000, -100000 };
+  uint32_t lo = fm->freqs[0], hi = fm->freqs[0];
+  int i, d, n, r;
+
+  for (i = 1; i < fm->freq_len; i++) {
+    lo = std::min(lo, fm->freqs[i]);
+    hi = std::max(hi, fm->freqs[i]);
+  }
+
+  for (d = WIDEBAND_DECIMATION_MIN; d <= WIDEBAND_DECIMATION_MAX; d++) {
+
+    const double edge = WIDEBAND_USABLE * 0.5 * d * fm->sample_rate;
+
+    for (n = 0; n < int(sizeof(nudge) / sizeof(nudge[0])); n++) {
+
+      const int64_t center = int64_t(lo + hi) / 2 + nudge[n];
+      bool ok = true;
+
+      for (i = 0; ok && i < fm->freq_len; i++) {
+	const int64_t off = int64_t(fm->freqs[i]) - center;
+	ok = (std::llabs(off) + 12500 <= edge) && (std::llabs(off) >= 15000);
+      }
+      if (!ok)
+	continue;
+
+      fm->downsample = d;
+      fm->wb_center = uint32_t(center);
+      if (!apply)
+	return d;
+
+      fprintf(stderr, "Wideband: %d channel(s), decimating by %d.\n",
+	      fm->freq_len, d);
+      r = fm->dev ? rtlsdr_set_center_freq(fm->dev, fm->wb_center) : 0;
+      if (r < 0) {
+	fprintf(stderr, "WARNING: Failed to set center freq.\n");}
+      else {
+	fprintf(stderr, "Tuned to %u Hz.\n", fm->wb_center);}
+      fprintf(stderr, "Sampling at %u Hz.\n", d * fm->sample_rate);
+      r = fm->dev ? rtlsdr_set_sample_rate(fm->dev, d * fm->sample_rate) : 0;
+      if (r < 0) {
+	fprintf(stderr, "WARNING: Failed to set sample rate.\n");}
+
+      return d;
+    }
+  }
+
+  return 0;
 }
 
-void process_57(char *txt)
+
+void full_demod(struct fm_state *fm)
 {
-  printf("Current position: %c%c%c%c%c\n",txt[0],txt[1],txt[2],txt[3],txt[4]);
-  printf("Current time: %c%c:%c%c\n",txt[5],txt[6],txt[7],txt[8]);
-  printf("Flight level: %c%c%c\n",txt[9],txt[10],txt[11]);
-  printf("Next report point: %c%c%c%c%c\n",txt[12],txt[13],txt[14],txt[15],txt[16]);
-  printf("Time over: %c%c:%c%c\n",txt[17],txt[18],txt[19],txt[20]);
-  printf("Fuel onboard: %c%c%c%c\n",txt[21],txt[22],txt[23],txt[24]);
-  printf("Static air temp: %c%c%c\n",txt[25],txt[26],txt[27]);
-  printf("Wind direction: %c%c%c deg.\n",txt[28],txt[29],txt[30]);
-  printf("Wind speed: %c%c%c knots.\n",txt[31],txt[32],txt[33]);
-  printf("Sky condition: %c%c%c%c%c%c%c%c\n",txt[34],txt[35],txt[36],txt[37],txt[38],txt[39],txt[40],txt[41]);
-  printf("Turbulence: %c%c%c%c%c%c%c%c\n",txt[42],txt[43],txt[44],txt[45],txt[46],txt[47],txt[48],txt[49]);
-  printf("Cruising speed: %c%c%c%c%c\n",txt[50],txt[51],txt[52],txt[54],txt[54]);
+  int i, sr, freq_next = 0, hop = 0;
+  double now = 0.0;
+
+  if (fm->channelizer) {
+    ProfileScope prof(Stage::CHANNELIZER, fm->buf_len / 2);
+    fm->channelizer->push(fm->buf, fm->buf_len);
+    return;
+  }
+
+  // One channel with the square window is the usual case and goes
+  // through the fused front end. With one channel the squelch has
+  // nothing to do (its mute, like the signal2 filters below, works on
+  // signal2 before am_demod() replaces it), so this is all that
+  // matters of the passes below.
+
+  if (!fm->fir_enable && fm->freq_len == 1) {
+    fm->signal2_len = int(am_front_end(fm->buf, fm->buf_len, fm->downsample,
+				       fm->output_scale, fm->now_r, fm->now_j,
+				       fm->prev_index, fm->signal2));
+    return;
+  }
+
+  rotate_90(fm->buf, fm->buf_len);
+  if (fm->fir_enable) {
+    low_pass_fir(fm, fm->buf, fm->buf_len);
+  } else {
+    low_pass(fm, fm->buf, fm->buf_len);
+  }
+
+  sr = post_squelch(fm);
+
+  // The scheduler counts time by the sample clock, so a replay scans
+  // as a dongle would have.
+
+  if (fm->scan) {
+    const double rate = double(fm->downsample) * fm->sample_rate;
+    now = fm->sample_clock / rate;
+    fm->scan->observe(now, fm->buf_len / 2 / rate, sr != 0);
+  }
+
+  if (!sr && fm->squelch_hits > 1/*fm->conseq_squelch*/) {
+    //if (fm->terminate_on_squelch) {
+    //	fm->exit_flag = 1;}
+    if (fm->freq_len == 1) {  /* mute */
+      for (i=0; i<fm->signal_len; i++) {
+	fm->signal2[i] = 0;}
+    }  else if (!fm->scan) {
+      hop = 1;
+      freq_next = (fm->freq_now + 1) % fm->freq_len;
+    }  else if (fm->scan->leave(now, fm->decoder->in_message())) {
+      freq_next = int(fm->scan->next(now));
+      hop = (freq_next != fm->freq_now);
+    }
+  }
+  if (fm->post_downsample > 1)
+    fm->signal2_len = low_pass_simple( fm->signal2, fm->signal2_len,
+				       fm->post_downsample);
+  if (fm->output_rate > 0) 
+    low_pass_real(fm);
+  if (fm->deemph) 
+    deemph_filter(fm);
+  if (fm->dc_block) 
+    dc_block_filter(fm);
+  
+  /* ignore under runs for now */
+
+  //fwrite(fm->signal2, 2, fm->signal2_len, fm->file);
+  // The hop is only asked for here. The reader does the retune, between
+  // two reads, and tags the blocks after it; the demodulator skips the
+  // ones read before it and the samples read while the tuner settled.
+
+  if (hop) {
+    if (debug_hop) fprintf(stderr,"Hopping freq!\n");
+    fm->freq_now = freq_next;
+    current_freq = fm->freqs[freq_next];
+    fm->squelch_hits = fm->conseq_squelch + 1;  /* hair trigger */
+    fm->tune_gen++;
+    fm->tune_ask = (uint64_t(fm->tune_gen) << 32) |
+      uint32_t(tuned_freq(fm, freq_next));
+  } else
+    am_demod(fm);
+  
 }
 
 
-void process_h1(char *txt)
-{
-  if (!strncmp(txt,"#DF",3)) printf("Source: Digital Flight Data Acquisition Unit\n");
-  if (!strncmp(txt,"#CF",3)) printf("Source: Central Fault Display\n");
-  if (!strncmp(txt,"#M1",3)) printf("Source: Flight Management Computer, Left\n");
-  if (!strncmp(txt,"#M2",3)) printf("Source: Flight Management Computer, Right\n");
-  if (!strncmp(txt,"#M3",3)) printf("Source: Flight Management Computer, Center\n");
-  if (!strncmp(txt,"#MD",3)) printf("Source: Flight Management Computer, Selected\n");
-  if (!strncmp(txt,"#EC",3)) printf("Source: Engine Display System\n");
-  if (!strncmp(txt,"#EI",3)) printf("Source: Engine Indicating System\n");
-  if (!strncmp(txt,"#PS",3)) printf("Source: Keyboard/Display Unit\n");
-  if (!strncmp(txt,"#S1",3)) printf("Source: SDU, Left\n");
-  if (!strncmp(txt,"#S2",3)) printf("Source: SDU, Right\n");
-  if (!strncmp(txt,"#SD",3)) printf("Source: SDU, Selected\n");
-  if (!strncmp(txt,"#T",2)) printf("Source: Cabin Terminal Message\n");
-  if (!strncmp(txt,"#WO",3)) printf("Source: Weather Observation Report\n");
+void acars_decode(struct fm_state *fm) {
+
+  // The channels' decoders are independent, so with a pool they run
+  // in parallel. What they decode is held until they're all done.
+
+  if( fm->channelizer ) {
+
+    if( pool && ( fm->wb_tasks.size() > 1 ))
+      pool->run( fm->wb_tasks );
+    else
+      for( auto& t : fm->wb_tasks )
+	t();
+
+    return;
+  }
+
+  if( fm->gate )
+    fm->gate->push( fm->signal2, fm->signal2_len );
+  else
+    fm->decoder->push( fm->signal2, fm->signal2_len );
+
 }
 
 
-void process_54(char *txt)
-{
-  printf("Frequency (MHZ): %c%c%c.%c%c%c\n",txt[0],txt[1],txt[2],txt[3],txt[4],txt[5]);
+// Count a block the demodulator had no room for. Verbose users hear
+// about it when it happens; everyone else hears about it at exit.
+
+static void
+_iq_overrun( receiver* rx ) {
+
+  if(( ++rx->iq_overruns == 1 ) || ( verbose > 1 ))
+    fprintf( stderr, "WARNING: device %d demodulator overrun, "
+	     "%lu block(s) dropped.\n", rx->index, rx->iq_overruns );
+
 }
 
 
-int is_flight_num(const uint8_t* text)
+void
+rtlsdr_callback(unsigned char *buf, uint32_t len, void *ctx)
 {
-  int a=0;
-  int ok=1,dig=0;
+  receiver* rx = (receiver *)ctx;
 
-  while (a<6) 
-    {
-      if (!((text[a]=='-') || (text[a]=='.') || ((text[a]<='Z') && (text[a]>='A')) || ((text[a]>='0') && (text[a]<='9')))) ok = 0;
-      a++;
-    }
-  if (!((text[2]>='0') && (text[a]<='9'))) ok = 0;
-  for (a=3;a<6;a++) if (((text[2]>='0') && (text[a]<='9'))) dig = 1;
-  if (dig==0) ok=0;
-  return ok;
-}
+  if (do_exit) {
+    return;}
+  if (!rx) {
+    return;}
 
+  // The library owns buf so this path has to copy, but it is the only
+  // copy and it is made without a lock.
 
-void print_mesg(msg_t * msg) {
+  iq_block* b = rx->iq_ring.write_slot();
 
-  time_t     t;
-  struct tm* tmp;
-  long       i = 0;
+  if( b == nullptr ) {
+    rx->iq_clock += len / 2;
+    _iq_overrun( rx );
+    return;
+  }
 
-  printf("\n[BEGIN_MESSAGE]----------------------------------------------------------\n\n");
-  printf("RX_IDX: %ld\n", rx_idx);
-  if (msg->crc) printf("CRC: Bad, corrected\n");
-  else printf("CRC: Correct\n");
-  t = time(NULL);
-  tmp = localtime(&t);
-  printf("Timestamp: %02d/%02d/%04d %02d:%02d\n",	     tmp->tm_mday, tmp->tm_mon + 1, tmp->tm_year + 1900,
-	 tmp->tm_hour, tmp->tm_min);
-  printf("ACARS mode: %c \n", msg->mode);
-  printf("Message label: %s ", msg->label);
+  assert( len <= b->data.size());
+  memcpy( b->data.get(), buf, len );
+  b->len    = len;
+  b->sample = rx->iq_clock;
+  rx->iq_clock += len / 2;
 
-  i=0;
-  while(acars_mls[i].ml_code){
-    if(!strcmp(acars_mls[i].ml_code, (const char*)msg->label)){
-      printf("(%s)\n",acars_mls[i].ml_label);
-    }
-    i++;
-  }
+  rx->iq_ring.push();
+  safe_cond_signal(&rx->data_ready, &rx->data_mutex);
+  /* single threaded uses 25% less CPU? */
+  /* full_demod(fm2); */
+}
 
-  printf("Aircraft reg: %s, ", msg->addr);
-  printf("flight id: %s\n", msg->fid);
-  i=0;
-  if ((msg->addr)&&(strlen(msg->addr)<8)&&(strlen(msg->addr)>1)&&(strcmp(msg->addr,".......")!=0))
-    {
-      while(acars_aircrafts[i].registration)
-	{
-	  char regtmp[8];
-	  memset(regtmp,0,8);
-	  int ind = 0;
-	  while ((ind<8)&&(msg->addr[ind]=='.')) ind++;
-	  strcpy(regtmp,&msg->addr[ind]);
-
-	  int len = strlen(regtmp);
-	  if ((len>0)&&(!strncmp(acars_aircrafts[i].registration, regtmp,len))){
-	    printf("Aircraft: %s \n",acars_aircrafts[i].manufacturer);
-	    printf("Registration: %s \n",acars_aircrafts[i].registration);
-	    printf("Mode-S ID: %s\n",acars_aircrafts[i].modes);
-	    goto aircraft_finished;
-	  }
-	  i++;
-	}
-    }
 
- aircraft_finished:
-
-  i=0;
-  int found=0;
-  int found2=0;
-  int found3=0;
-	
-  char regtmp[8];
-  memset(regtmp,0,8);
-  int ind = 0;
-  regtmp[0]=msg->fid[0];
-  regtmp[1]=msg->fid[1];
-  ind = 1;
-  int correct = is_flight_num(msg->fid);
-  while ((ind<7)/*&&(msg->fid[ind]=='0')*/) 
-    {
-      regtmp[2]='0';
-      if (ind>1) strncpy(&regtmp[3], &msg->fid[ind], 7-ind);
-      else strncpy(&regtmp[2], &msg->fid[ind+1], 4);
-      ind++;
-      if (strlen(msg->fid)>1) while(acars_flights[i].flightid){
-	  if ((!found)&&(!strncmp(acars_flights[i].flightid, regtmp,2))&&(correct)) {
-	    printf("Airline: %s \n",acars_flights[i].airline);
-	    found++;
-	  }
+// Read one block from the device straight into the next free slot of
+// its ring. If the ring is full the block is read into the scratch
+// buffer, to keep the USB stream moving, and dropped.
 
-	  if ((correct)&&(!strncmp(acars_flights[i].flightid, regtmp,2)) && (!strncmp(acars_flights[i].flightid+3, regtmp+3,strlen(regtmp+3)))&&(strlen(regtmp+3)>0))
-	    {
-	      long x = 0;
-	      while((acars_airports[x].code)&&(found2==0)){
-		if(!strcmp(acars_airports[x].code, acars_flights[i].from)){
-		  printf("From: %s - %s (%s, %s) \n",acars_airports[x].code,acars_airports[x].name,acars_airports[x].city,acars_airports[x].country);
-		  found2++;
-		  break;
-		}
-		x++;
-	      }
-	      x=0;
-	      while((acars_airports[x].code)&&(found3==0)){
-		if(!strcmp(acars_airports[x].code, acars_flights[i].to)){
-		  printf("To: %s - %s (%s, %s) \n",acars_airports[x].code,acars_airports[x].name,acars_airports[x].city,acars_airports[x].country);
-		  found3++;
-		  break;
-		}
-		x++;
-	      }
-	    }
-	  i++;
-	}
-    }
+static void
+sync_read( receiver* rx, Buffer<uint8_t>& scratch, uint32_t len ) {
 
+  int       r, n_read;
+  iq_block* b;
 
-  printf("\nBlock id: %d, ", (int) msg->bid);
-  printf(" msg. no: %s\n", msg->no);
-  if (!strcmp(msg->label,"QV")) process_qv(msg->txt);
-  if (!strcmp(msg->label,"5U")) process_5u(msg->txt);
-  if (!strcmp(msg->label,"SA")) process_sa(msg->txt);
-  if (!strcmp(msg->label,"Q1")) process_q1(msg->txt);
-  if (!strcmp(msg->label,"Q2")) process_q2(msg->txt);
-  if (!strcmp(msg->label,"QA")) process_qa(msg->txt);
-  if (!strcmp(msg->label,"QB")) process_qb(msg->txt);
-  if (!strcmp(msg->label,"QC")) process_qc(msg->txt);
-  if (!strcmp(msg->label,"QD")) process_qd(msg->txt);
-  if (!strcmp(msg->label,"QE")) process_qr(msg->txt);
-  if (!strcmp(msg->label,"QF")) process_qf(msg->txt);
-  if (!strcmp(msg->label,"QG")) process_qg(msg->txt);
-  if (!strcmp(msg->label,"QH")) process_qh(msg->txt);
-  if (!strcmp(msg->label,"QK")) process_qk(msg->txt);
-  if (!strcmp(msg->label,"QL")) process_ql(msg->txt);
-  if (!strcmp(msg->label,"QM")) process_qm(msg->txt);
-  if (!strcmp(msg->label,"QN")) process_qn(msg->txt);
-  if (!strcmp(msg->label,"QP")) process_qp(msg->txt);
-  if (!strcmp(msg->label,"QQ")) process_qq(msg->txt);
-  if (!strcmp(msg->label,"QR")) process_qr(msg->txt);
-  if (!strcmp(msg->label,"QS")) process_qs(msg->txt);
-  if (!strcmp(msg->label,"QT")) process_qt(msg->txt);
-  if (!strcmp(msg->label,"57")) process_57(msg->txt);
-  if (!strcmp(msg->label,"H1")) process_h1(msg->txt);
-  if (!strcmp(msg->label,"54")) process_54(msg->txt);
+  // Do the hop the demodulator last asked for, if it isn't done. What
+  // comes in for the next millisecond and BUFFER_DUMP bytes is the
+  // tuner settling; it's read, as the stream has to keep moving, but
+  // tagged so the demodulator skips it.
 
-  printf("Message content:-\n%s", msg->txt);
+  const uint64_t ask = rx->fm->tune_ask.load( std::memory_order_acquire );
 
+  if( uint32_t( ask >> 32 ) != rx->tune_now ) {
 
+    if( rtlsdr_set_center_freq( rx->fm->dev, uint32_t( ask )) < 0 )
+      fprintf( stderr, "WARNING: device %d failed to retune.\n", rx->index );
 
-  rx_idx++;
+    rx->tune_now = uint32_t( ask >> 32 );
+    rx->settle   = ( BUFFER_DUMP +
+		     2 * rx->fm->downsample * rx->fm->sample_rate / 1000 + 7 ) & ~7u;
+  }
 
-  printf
-    ("\n\n[END_MESSAGE ]------------------------------------------------------------\n\n");
+  // The settling bytes are only used up by a read that worked; after
+  // one that failed the next block still has them to skip.
 
-}
+  const uint32_t settle = std::min( rx->settle, len );
 
-///////// END OF ACARS ROUTINES //////////
+  b = rx->iq_ring.write_slot();
 
+  if( b == nullptr ) {
 
+    if( rtlsdr_read_sync( rx->fm->dev, scratch.get(), len, &n_read ) >= 0 )
+      rx->settle -= settle;
+    rx->iq_clock += len / 2;
+    _iq_overrun( rx );
 
+    return;
+  }
 
+  assert( len <= b->data.size());
 
+  r = rtlsdr_read_sync( rx->fm->dev, b->data.get(), len, &n_read );
+  if (r < 0) {
+    fprintf(stderr, "WARNING: device %d sync read failed.\n", rx->index);
+    return;
+  }
+  rx->settle -= settle;
+  b->len    = len;
+  b->sample = rx->iq_clock;
+  b->tune   = rx->tune_now;
+  b->settle = settle;
+  rx->iq_clock += len / 2;
 
-/* more cond dumbness */
-#define safe_cond_signal(n, m) pthread_mutex_lock(m); pthread_cond_signal(n); pthread_mutex_unlock(m)
-#define safe_cond_wait(n, m) pthread_mutex_lock(m); pthread_cond_wait(n, m); pthread_mutex_unlock(m)
+  rx->iq_ring.push();
+  safe_cond_signal(&rx->data_ready, &rx->data_mutex);
+}
 
 
-/* 90 rotation is 1+0j, 0+1j, -1+0j, 0-1j
-   or [0, 1, -3, 2, -4, -5, 7, -6] */
+// Hand a decoded message to the writer, stamped with the device's
+// sample clock. Only the device's demodulator thread may call this,
+// so the wideband decoders, which may be on the pool's workers, hold
+// theirs for decode_block().
 
-void
-rotate_90( uint8_t* buf, uint32_t len ) {
-  
-  for( uint32_t i = 0; i < len; i += 8 ) {
+static void
+queue_mesg( receiver* rx, const msg_t& msg, uint64_t sample ) {
 
-    uint8_t tmp;
-    
-    /* uint8_t negation = 255 - x */
+  out_record* r;
 
-    tmp = 255 - buf[i+3];
-    buf[i+3] = buf[i+2];
-    buf[i+2] = tmp;
+  while(( r = rx->out_ring.write_slot()) == nullptr ) {
 
-    buf[i+4] = 255 - buf[i+4];
-    buf[i+5] = 255 - buf[i+5];
+    if( !out_wait ) {
+      if(( ++rx->out_overruns == 1 ) || ( verbose > 1 ))
+	fprintf( stderr, "WARNING: device %d output overrun, "
+		 "%lu message(s) dropped.\n", rx->index, rx->out_overruns );
+      return;
+    }
 
-    tmp = 255 - buf[i+6];
-    buf[i+6] = buf[i+7];
-    buf[i+7] = tmp;
+    usleep( 1000 );
   }
+
+  r->msg    = msg;
+  r->sample = sample;
+
+  rx->out_ring.push();
+  safe_cond_signal(&out_ready, &out_mutex);
 }
 
-void low_pass(struct fm_state *fm, unsigned char *buf, uint32_t len)
-/* simple square window FIR */
-{
-  int i=0, i2=0, seq=0;
-  while (i < (int)len) {
-    fm->now_r += ((int)buf[i]   - 127);
-    fm->now_j += ((int)buf[i+1] - 127);
-    i += 2;
-    fm->prev_index++;
 
-    if ( (fm->prev_index<(fm->downsample)) ) continue;
-    if ((seq%2)==1)
-      {
-	// signal is ~10khz wide, don't need whole 48khz
-	// eliminate some RF noise by attenuating stuff outside 24khz a bit
-	fm->signal[i2]   = (fm->now_r*5)/(8); 
-	fm->signal[i2+1] = (fm->now_j*5)/(8);
-      }
-    else
-      {
-	fm->signal[i2]   = fm->now_r;// * fm->output_scale;
-	fm->signal[i2+1] = fm->now_j;// * fm->output_scale;
-      }
-    seq++;
-    fm->prev_index = 0;
-    fm->now_r = 0;
-    fm->now_j = 0;
-    i2 += 2;
-  }
-  fm->signal_len = i2;
+static uint64_t
+_ns( void ) {
+
+  struct timespec t;
+
+  clock_gettime( CLOCK_MONOTONIC, &t );
+
+  return uint64_t( t.tv_sec ) * 1000000000 + uint64_t( t.tv_nsec );
 }
 
+// Wait for a free slot on a stage's output ring, counting the wait
+// against the stage.
 
-void build_fir(struct fm_state *fm)
-/* hamming */
-/* point = sum(sample[i] * fir[i] * fir_len / fir_sum) */
-{
-  double a, b, w, N1;
-  int i, len;
-  len = fm->downsample;
-  a = 25.0/46.0;
-  b = 21.0/46.0;
-  N1 = (double)(len-1);
-  for(i = 0; i < len; i++) {
-    w = a - b*cos(2*i*M_PI/N1);
-    fm->fir[i] = (int)(w * 255);
-  }
-  fm->fir_sum = 0;
-  for(i = 0; i < len; i++) {
-    fm->fir_sum += fm->fir[i];
+template<typename T> static T*
+pipe_slot( RingSPSC<T>& ring, pipe_stage& st ) {
+
+  T* b = ring.write_slot();
+
+  if( b == nullptr ) {
+
+    const uint64_t t0 = _ns();
+
+    while(( b = ring.write_slot()) == nullptr )
+      usleep( 1000 );
+
+    st.blocked_ns += _ns() - t0;
   }
+
+  return b;
 }
 
+// Wait for the oldest block on a stage's input ring. Returns nullptr
+// once the ring is empty and the stage before won't push any more.
 
-void low_pass_fir(struct fm_state *fm, unsigned char *buf, uint32_t len)
-/* perform an arbitrary FIR, doubles CPU use */
-// possibly bugged, or overflowing
-{
-  int i=0, i2=0, i3=0;
-  while (i < (int)len) {
-    i3 = fm->prev_index;
-    fm->now_r += ((int)buf[i]   - 127) * fm->fir[i3];
-    fm->now_j += ((int)buf[i+1] - 127) * fm->fir[i3];
-    i += 2;
-    fm->prev_index++;
-		
-    if (fm->prev_index < fm->downsample) {
-      continue;
+template<typename T> static T*
+pipe_take( RingSPSC<T>& ring, pipe_stage& st, std::atomic<bool>& done ) {
+
+  T* b;
+
+  while(( b = ring.read_slot()) == nullptr ) {
+
+    if( done ) {
+      if(( b = ring.read_slot()) == nullptr )
+	return nullptr;
+      break;
     }
-    fm->now_r *= fm->downsample;
-    fm->now_j *= fm->downsample;
-    fm->now_r /= fm->fir_sum;
-    fm->now_j /= fm->fir_sum;
-    fm->signal[i2]   = fm->now_r; //* fm->output_scale;
-    fm->signal[i2+1] = fm->now_j; //* fm->output_scale;
-    fm->prev_index = 0;
-    fm->now_r = 0;
-    fm->now_j = 0;
-    i2 += 2;
+
+    pthread_mutex_lock( &st.mutex );
+    while( !done && ring.empty())
+      pthread_cond_wait( &st.ready, &st.mutex );
+    pthread_mutex_unlock( &st.mutex );
   }
-  fm->signal_len = i2;
+
+  st.takes += 1;
+  st.depth += ring.size() - 1;
+
+  return b;
 }
 
+// The bit former's stage: the squelch gate and the bit former, with
+// the decoder split so the symbols go on to the framer.
 
-int low_pass_simple(int16_t *signal2, int len, int step)
-// no wrap around, length must be multiple of step
+static void *bits_thread_fn(void *arg)
 {
-  int i, i2, sum;
-  for(i=0; i < len; i+=step) {
-    sum = 0;
-    for(i2=0; i2<step; i2++)
-      sum += (int)signal2[i + i2];
-   
-    //signal2[i/step] = (int16_t)(sum / step);
-    signal2[i/step] = (int16_t)(sum);
+  receiver *rx = (receiver *)arg;
+  struct fm_state *fm = rx->fm.get();
+  pipe_stage& st = rx->stage[1];
+  env_block* e;
+
+  while ((e = pipe_take(rx->env_ring, st, rx->env_done))) {
+
+    const uint64_t t0 = _ns();
+    sym_block* b = pipe_slot(rx->sym_ring, st);
+
+    b->data.clear();
+    rx->decoder->split(&b->data);
+    if (fm->gate)
+      fm->gate->push(e->data.get(), e->len);
+    else
+      rx->decoder->push(e->data.get(), e->len);
+    rx->decoder->split(nullptr);
+
+    b->sample = e->sample;
+    b->freq   = e->freq;
+
+    e->data.check();
+    rx->env_ring.pop();
+    rx->sym_ring.push();
+    safe_cond_signal(&rx->stage[2].ready, &rx->stage[2].mutex);
+
+    st.busy_ns += _ns() - t0;
   }
-  signal2[i/step + 1] = signal2[i/step];
-  return len / step;
+
+  rx->sym_done = true;
+  safe_cond_signal(&rx->stage[2].ready, &rx->stage[2].mutex);
+  return 0;
 }
 
+// The framer's stage: the message state machine, and the messages on
+// to the writer.
 
-void low_pass_real(struct fm_state *fm)
-/* simple square window FIR */
-// add support for upsampling?
+static void *frame_thread_fn(void *arg)
 {
-  int i=0, i2=0;
-  int fast = (int)fm->sample_rate / (fm->post_downsample);
-  int slow = fm->output_rate;
-  while (i < fm->signal2_len) {
-    fm->now_lpr += fm->signal2[i];
-    i++;
-    fm->prev_lpr_index += slow;
-    if (fm->prev_lpr_index < fast) {
-      continue;
-    }
-    fm->signal2[i2] = (int16_t)(fm->now_lpr / (fast/slow));
-    fm->prev_lpr_index -= fast;
-    fm->now_lpr = 0;
-    i2 += 1;
-  }
-  fm->signal2_len = i2;
-}
+  receiver *rx = (receiver *)arg;
+  pipe_stage& st = rx->stage[2];
+  sym_block* b;
 
+  while ((b = pipe_take(rx->sym_ring, st, rx->sym_done))) {
 
-/* define our own complex math ops
-   because ARMv5 has no hardware float */
+    const uint64_t t0 = _ns();
 
-inline void
-multiply(int ar, int aj, int br, int bj, int *cr, int *cj)
-{
-  *cr = ar*br - aj*bj;
-  *cj = aj*br + ar*bj;
-}
+    rx->msg_sample = b->sample;
+    rx->msg_freq   = b->freq;
+    rx->decoder->frame(b->data.data(), b->data.size());
+    rx->out_clock  = b->sample;
 
+    rx->sym_ring.pop();
 
-int polar_discriminant(int ar, int aj, int br, int bj)
-{
-  int cr, cj;
-  double angle;
-  multiply(ar, aj, br, -bj, &cr, &cj);
-  angle = atan2((double)cj, (double)cr);
-  return (int)(angle / 3.14159 * (1<<14));
+    st.busy_ns += _ns() - t0;
+  }
+
+  return 0;
 }
 
+// Start a device's pipeline, and stop it once the front end has
+// stopped and everything it did is decoded.
 
-int fast_atan2(int y, int x)
-/* pre scaled for int16 */
-{
-  int yabs, angle;
-  int pi4=(1<<12), pi34=3*(1<<12);  // note pi = 1<<14
-  if (x==0 && y==0) {
-    return 0;
-  }
-  yabs = y;
-  if (yabs < 0) {
-    yabs = -yabs;
-  }
-  if (x >= 0) {
-    angle = pi4  - pi4 * (x-yabs) / (x+yabs);
-  } else {
-    angle = pi34 - pi4 * (x+yabs) / (yabs-x);
+static void
+pipe_start( receiver* rx ) {
+
+  for (size_t i = 0; i < rx->env_ring.capacity(); ++i) {
+    rx->env_ring[i].data.set(ACTUAL_BUF_LENGTH / 2);
+    rx->env_ring[i].len = 0;
+    rx->sym_ring[i].data.reserve(ACTUAL_BUF_LENGTH / 2 / 8);
   }
-  if (y < 0) {
-    return -angle;
+
+  for (auto& st : rx->stage) {
+    pthread_cond_init(&st.ready, NULL);
+    pthread_mutex_init(&st.mutex, NULL);
   }
-  return angle;
+
+  clock_gettime(CLOCK_MONOTONIC, &rx->pipe_start);
+
+  pthread_create(&rx->stage[1].thread, NULL, bits_thread_fn, (void *)rx);
+  pthread_create(&rx->stage[2].thread, NULL, frame_thread_fn, (void *)rx);
 }
 
+static void
+pipe_stop( receiver* rx ) {
+
+  static const char* const names[] = { "front end", "bit former", "framer" };
+  static const size_t rings[] = { DEFAULT_ASYNC_BUF_NUMBER, PIPE_RING_SIZE,
+				  PIPE_RING_SIZE };
+
+  rx->env_done = true;
+  safe_cond_signal(&rx->stage[1].ready, &rx->stage[1].mutex);
+  pthread_join(rx->stage[1].thread, NULL);
+  pthread_join(rx->stage[2].thread, NULL);
+
+  struct timespec t;
 
-int polar_disc_fast(int ar, int aj, int br, int bj)
-{
-  int cr, cj;
-  multiply(ar, aj, br, -bj, &cr, &cj);
-  return fast_atan2(cj, cr);
-}
+  clock_gettime(CLOCK_MONOTONIC, &t);
 
+  const double wall = ( t.tv_sec - rx->pipe_start.tv_sec ) +
+    ( t.tv_nsec - rx->pipe_start.tv_nsec ) * 1e-9;
 
-int atan_lut_init()
-{
-  int i = 0;
+  fprintf(stderr, "Device %d's pipeline over %0.2fs:\n", rx->index, wall);
 
-  atan_lut = (int*)malloc(atan_lut_size * sizeof(int));
+  for (int i = 0; i < 3; ++i) {
 
-  for (i = 0; i < atan_lut_size; i++) {
-    atan_lut[i] = (int) (atan((double) i / (1<<atan_lut_coef)) / 3.14159 * (1<<14));
-  }
+    const pipe_stage& st = rx->stage[i];
 
-  return 0;
+    fprintf(stderr, "  %-10s %5.1f%% busy, %5.1f%% waiting for room",
+	    names[i], 100.0 * (st.busy_ns - st.blocked_ns) / 1e9 / wall,
+	    100.0 * st.blocked_ns / 1e9 / wall);
+    if (st.takes)
+      fprintf(stderr, ", %0.1f of %zu block(s) queued behind its input\n",
+	      double(st.depth) / st.takes, rings[i]);
+    else
+      fprintf(stderr, "\n");
+
+    pthread_cond_destroy(&rx->stage[i].ready);
+    pthread_mutex_destroy(&rx->stage[i].mutex);
+  }
 }
 
+// Decode the block the demodulator just did and queue what the
+// wideband decoders held, channel by channel, as they'd have queued
+// it themselves without the pool. With -S it's handed to the
+// pipeline instead.
 
-int polar_disc_lut(int ar, int aj, int br, int bj)
-{
-  int cr, cj, x, x_abs;
+static void
+decode_block( receiver* rx ) {
 
-  multiply(ar, aj, br, -bj, &cr, &cj);
+  struct fm_state *fm = rx->fm.get();
 
-  /* special cases */
-  if (cr == 0 || cj == 0) {
-    if (cr == 0 && cj == 0)
-      {return 0;}
-    if (cr == 0 && cj > 0)
-      {return 1 << 13;}
-    if (cr == 0 && cj < 0)
-      {return -(1 << 13);}
-    if (cj == 0 && cr > 0)
-      {return 0;}
-    if (cj == 0 && cr < 0)
-      {return 1 << 14;}
-  }
+  if( rx->piped ) {
 
-  /* real range -32768 - 32768 use 64x range -> absolute maximum: 2097152 */
-  x = (cj << atan_lut_coef) / cr;
-  x_abs = abs(x);
+    env_block* e = pipe_slot( rx->env_ring, rx->stage[0] );
 
-  if (x_abs >= atan_lut_size) {
-    /* we can use linear range, but it is not necessary */
-    return (cj > 0) ? 1<<13 : -1<<13;
-  }
+    assert( size_t( fm->signal2_len ) <= e->data.size());
+    memcpy( e->data.get(), fm->signal2, fm->signal2_len * sizeof( int16_t ));
+    e->len    = fm->signal2_len;
+    e->sample = fm->sample_clock;
+    e->freq   = fm->freqs[fm->freq_now];
 
-  if (x > 0) {
-    return (cj > 0) ? atan_lut[x] : atan_lut[x] - (1<<14);
-  } else {
-    return (cj > 0) ? (1<<14) - atan_lut[-x] : -atan_lut[-x];
+    rx->env_ring.push();
+    safe_cond_signal( &rx->stage[1].ready, &rx->stage[1].mutex );
+
+    return;
   }
 
-  return 0;
-}
+  rx->msg_sample = fm->sample_clock;
+  rx->msg_freq   = fm->freqs[fm->freq_now];
 
+  acars_decode( fm );
 
-void am_demod(struct fm_state *fm)
-// todo, fix this extreme laziness
-{
-  int i, pcm;
-  for (i = 0; i < (fm->signal_len); i += 2) {
-    // hypot uses floats but won't overflow
-    //fm->signal2[i/2] = (int16_t)hypot(fm->signal[i], fm->signal[i+1]);
-    pcm = fm->signal[i] * fm->signal[i];
-    pcm += fm->signal[i+1] * fm->signal[i+1];
-    fm->signal2[i/2] = (int16_t)sqrt(pcm) * fm->output_scale;
-    // Milen: add some gain to signal
-    fm->signal2[i/2] *= 8;
+  for( auto& held : fm->wb_held ) {
+    for( const auto& m : held )
+      queue_mesg( rx, m, fm->sample_clock );
+    held.clear();
   }
-  fm->signal2_len = fm->signal_len/2;
-  // lowpass? (3khz)  highpass?  (dc)
+
+  rx->out_clock = fm->sample_clock;
 }
 
 
-void deemph_filter(struct fm_state *fm)
-{
-  static int avg;  // cheating...
-  int i, d;
-  // de-emph IIR
-  // avg = avg * (1 - alpha) + sample * alpha;
-  for (i = 0; i < fm->signal2_len; i++) {
-    d = fm->signal2[i] - avg;
-    if (d > 0) {
-      avg += (d + fm->deemph_a/2) / fm->deemph_a;
-    } else {
-      avg += (d - fm->deemph_a/2) / fm->deemph_a;
-    }
-    fm->signal2[i] = (int16_t)avg;
+// What the scan heard: the channels it heard bursts on, busiest first,
+// and how much of its time it gave them.
+
+static void
+scan_report( receiver* rx ) {
+
+  const struct fm_state* fm = rx->fm.get();
+  const ScanScheduler&   s  = *fm->scan;
+  std::vector<size_t>    heard;
+
+  for( size_t i = 0; i < s.channels(); ++i )
+    if( s.stats( i ).bursts )
+      heard.push_back( i );
+
+  std::stable_sort( heard.begin(), heard.end(), [&s]( size_t a, size_t b ) {
+      return s.stats( a ).bursts > s.stats( b ).bursts;
+    });
+
+  fprintf( stderr, "Device %d heard bursts on %zu of %zu channel(s).\n",
+	   rx->index, heard.size(), s.channels());
+
+  for( size_t k = 0; ( k < heard.size()) && ( k < 10 ); ++k ) {
+
+    const size_t                i  = heard[k];
+    const ScanScheduler::Stats& st = s.stats( i );
+
+    fprintf( stderr, "  %0.3f MHz: %lu burst(s) of %0.2fs, %lu visit(s), "
+	     "%0.1fs listened, %0.1f%% of the visits.\n",
+	     fm->freqs[i] / 1e6, (unsigned long)st.bursts,
+	     st.airtime / st.bursts, (unsigned long)st.visits, st.heard,
+	     100.0 * s.share( i ));
   }
 }
 
 
-void dc_block_filter(struct fm_state *fm)
-{
-  int i, avg;
-  int64_t sum = 0;
-  for (i=0; i < fm->signal2_len; i++) {
-    sum += fm->signal2[i];
-  }
-  avg = sum / fm->signal2_len;
-  avg = (avg + fm->dc_avg * 9) / 10;
-  for (i=0; i < fm->signal2_len; i++) {
-    fm->signal2[i] -= avg;
+// Decode a recording instead of a device. The file is mapped rather
+// than read and each block is run through the same full_demod() and
+// acars_decode() path the demodulator thread uses, in the calling
+// thread and with no pacing, so it runs as fast as the CPU allows. The
+// blocks are copied into the scratch buffer first because rotate_90()
+// works in place and the mapping is read only.
+
+static int
+replay_file( receiver* rx, const char* path, Buffer<uint8_t>& scratch ) {
+
+  struct fm_state* fm = rx->fm.get();
+
+  const int fd = open( path, O_RDONLY );
+
+  if( fd < 0 ) {
+    fprintf( stderr, "Failed to open %s: %s\n", path, strerror( errno ));
+    return 1;
   }
-  fm->dc_avg = avg;
-}
 
+  struct stat st;
 
-int mad(const int *samples, int len, int step)
-/* mean average deviation */
-{
-  int i=0, sum=0, ave=0;
-  if (len == 0)
-    {return 0;}
-  for (i=0; i<len; i+=step) {
-    sum += samples[i];
+  if(( fstat( fd, &st ) < 0 ) || ( st.st_size == 0 )) {
+    fprintf( stderr, "Nothing to replay in %s.\n", path );
+    close( fd );
+    return 1;
   }
-  ave = sum / (len * step);
-  sum = 0;
-  for (i=0; i<len; i+=step) {
-    sum += abs(samples[i] - ave);
+
+  const size_t   sz  = size_t( st.st_size );
+  const uint8_t* map = (const uint8_t*)mmap( NULL, sz, PROT_READ,
+					     MAP_PRIVATE, fd, 0 );
+  close( fd );
+
+  if( map == MAP_FAILED ) {
+    fprintf( stderr, "Failed to map %s: %s\n", path, strerror( errno ));
+    return 1;
   }
-  return sum / (len / step);
-}
+  madvise(( void* )map, sz, MADV_SEQUENTIAL );
 
+  const double capture_rate = double( fm->downsample ) * fm->sample_rate;
+  const size_t block        = scratch.size();
 
-int post_squelch(struct fm_state *fm)
-/* returns 1 for active signal, 0 for no signal */
-{
-  int dev_r, dev_j, len, sq_l;
-  /* only for small samples, big samples need chunk processing */
-  len = fm->signal_len;
-  sq_l = fm->squelch_level;
-  dev_r = mad(&(fm->signal[0]), len, 2);
-  dev_j = mad(&(fm->signal[1]), len, 2);
-  //fprintf(stderr,"shits: %d dr: %d dj: %d sql: %d\n ",fm->squelch_hits,dev_r,dev_j,sq_l);
+  fprintf( stderr, "Replaying %s: %zu samples, %0.2fs at %0.0f Hz.\n",
+	   path, sz / 2, ( sz / 2 ) / capture_rate, capture_rate );
 
-  if ((dev_r > sq_l) || (dev_j > sq_l)) {
-    fm->squelch_hits = 0;
-    return 1;
+  struct timespec t0, t1;
+  clock_gettime( CLOCK_MONOTONIC, &t0 );
+
+  size_t off = 0;
+
+  while( !do_exit && ( off < sz )) {
+
+    _check_profile_dump();
+
+    // rotate_90() works on whole groups of four IQ pairs.
+
+    const size_t n = ( std::min( block, sz - off ) & ~size_t( 7 ));
+
+    if( n == 0 )
+      break;
+
+    memcpy( scratch.get(), map + off, n );
+    scratch.check();
+
+    fm->buf          = scratch.get();
+    fm->buf_len      = uint32_t( n );
+    fm->sample_clock = ( off + n ) / 2;
+
+    const uint64_t t0 = _ns();
+
+    full_demod( fm );
+    decode_block( rx );
+
+    rx->stage[0].busy_ns += _ns() - t0;
+
+    off += n;
   }
-  fm->squelch_hits++;
+
+  // The pipeline has to finish the recording before it's done.
+
+  if( rx->piped )
+    pipe_stop( rx );
+
+  clock_gettime( CLOCK_MONOTONIC, &t1 );
+  munmap(( void* )map, sz );
+
+  fm->buf = NULL;
+
+  const double
+    wall   = ( t1.tv_sec - t0.tv_sec ) + ( t1.tv_nsec - t0.tv_nsec ) * 1e-9,
+    signal = ( off / 2 ) / capture_rate;
+
+  fprintf( stderr,
+	   "Replayed %0.2fs of signal in %0.2fs: %0.1fx real time, "
+	   "%0.2f Msps.\n",
+	   signal, wall, ( wall > 0 ) ? signal / wall : 0.0,
+	   ( wall > 0 ) ? ( off / 2 ) / wall / 1e6 : 0.0 );
+
+  if( fm->gate && fm->gate->seen())
+    fprintf( stderr, "The decoder was awake for %0.1f%% of it.\n",
+	     100.0 * fm->gate->live() / fm->gate->seen());
+
+  if( fm->scan )
+    scan_report( rx );
+
   return 0;
 }
 
 
-static void optimal_settings(struct fm_state *fm, int freq, int hopping)
-{
-  int r, capture_freq, capture_rate;
-  fm->downsample = (1000000 / fm->sample_rate) + 1;
-
-  fm->freq_now = freq;
-  capture_rate = fm->downsample * fm->sample_rate;
-  capture_freq = fm->freqs[freq] + capture_rate/4;
-  capture_freq += fm->edge * fm->sample_rate / 2;
-  fm->output_scale = (1<<15) / (128 * fm->downsample);
-  if (fm->output_scale < 1) 
-    fm->output_scale = 1;
-  /* Set the frequency */
-  r = rtlsdr_set_center_freq(dev, (uint32_t)capture_freq);
-  if (hopping) {
-    return;}
-		
-  // Milen: don't need 48khz signal, set cutoff at ~16khz
-  //fm->downsample /=2;
-  //fm->post_downsample*=2;
+static double
+_now( void ) {
 
-		
-  fprintf(stderr, "Oversampling input by: %ix.\n", fm->downsample);
-  fprintf(stderr, "Oversampling output by: %ix.\n", fm->post_downsample);
-  fprintf(stderr, "Buffer size: %0.2fms\n",
-	  1000 * 0.5 * (float)ACTUAL_BUF_LENGTH / (float)capture_rate);
-  if (r < 0) {
-    fprintf(stderr, "WARNING: Failed to set center freq.\n");}
-  else {
-    fprintf(stderr, "Tuned to %u Hz.\n", capture_freq);}
+  struct timespec t;
 
-  /* Set the sample rate */
-  fprintf(stderr, "Sampling at %u Hz.\n", capture_rate);
-  if (fm->output_rate > 0) {
-    fprintf(stderr, "Output at %u Hz.\n", fm->output_rate);
-  } else {
-    fprintf(stderr, "Output at %u Hz.\n", fm->sample_rate/fm->post_downsample);}
-  r = rtlsdr_set_sample_rate(dev, (uint32_t)capture_rate);
-  if (r < 0) {
-    fprintf(stderr, "WARNING: Failed to set sample rate.\n");}
+  clock_gettime( CLOCK_REALTIME, &t );
 
+  return double( t.tv_sec ) + double( t.tv_nsec ) * 1e-9;
 }
 
+// When a message a device decoded at sample went out.
 
-void full_demod(struct fm_state *fm)
+static double
+_out_time( const receiver* rx, uint64_t sample ) {
+
+  return rx->out_epoch + double( sample ) / rx->out_rate;
+}
+
+static void *out_thread_fn(void *arg)
 {
-  uint8_t dump[BUFFER_DUMP];
-  int i, sr, freq_next, n_read, hop = 0;
-  pthread_rwlock_wrlock(&data_rw);
-  rotate_90(fm->buf, fm->buf_len);
-  if (fm->fir_enable) {
-    low_pass_fir(fm, fm->buf, fm->buf_len);
-  } else {
-    low_pass(fm, fm->buf, fm->buf_len);
-  }
-  pthread_rwlock_unlock(&data_rw);
+  // Nothing is printed until the datasets are loaded.
+  pthread_mutex_lock(&dataset_mutex);
+  pthread_mutex_unlock(&dataset_mutex);
 
-  sr = post_squelch(fm);
-  if (!sr && fm->squelch_hits > 1/*fm->conseq_squelch*/) {
-    //if (fm->terminate_on_squelch) {
-    //	fm->exit_flag = 1;}
-    if (fm->freq_len == 1) {  /* mute */
-      for (i=0; i<fm->signal_len; i++) {
-	fm->signal2[i] = 0;}
-    }  else {
-      hop = 1;
+  for (;;) {
+
+    // The earliest message waiting on any device's ring. It can be
+    // printed once every other device with nothing waiting has
+    // decoded past it, since their next messages can't be any
+    // earlier, or once it has waited too long for them.
+
+    receiver*   first = nullptr;
+    out_record* r     = nullptr;
+    double      at    = 0.0;
+
+    for( auto& rx : receivers ) {
+
+      out_record* head = rx->out_ring.read_slot();
+
+      if( head && ( !first || ( _out_time( rx.get(), head->sample ) < at ))) {
+	first = rx.get();
+	r     = head;
+	at    = _out_time( rx.get(), head->sample );
+      }
+    }
+
+    bool ready = ( r != nullptr );
+
+    if( ready && !out_done && ( _now() - at < OUT_MAX_LAG ))
+      for( auto& rx : receivers )
+	if(( rx.get() != first ) && rx->out_ring.empty() &&
+	   ( _out_time( rx.get(), rx->out_clock ) < at ))
+	  ready = false;
+
+    if( ready ) {
+      print_mesg( &r->msg, time_t( at ));
+      first->out_ring.pop();
+      continue;
+    }
+
+    // As the demodulator does, but when there's nothing left to print
+    // and nothing more is coming, stop. A message held for another
+    // device is looked at again now and then.
+
+    if( !r && out_done )
+      break;
+
+    pthread_mutex_lock( &out_mutex );
+
+    if( r ) {
+
+      struct timespec until;
+
+      clock_gettime( CLOCK_REALTIME, &until );
+      until.tv_nsec += 50 * 1000000;
+      if( until.tv_nsec >= 1000000000 ) {
+	until.tv_sec  += 1;
+	until.tv_nsec -= 1000000000;
+      }
+
+      pthread_cond_timedwait( &out_ready, &out_mutex, &until );
+
+    } else {
+
+      bool empty = true;
+
+      for( auto& rx : receivers )
+	empty = empty && rx->out_ring.empty();
+
+      if( !out_done && empty )
+	pthread_cond_wait( &out_ready, &out_mutex );
     }
+
+    pthread_mutex_unlock( &out_mutex );
   }
-  if (fm->post_downsample > 1)
-    fm->signal2_len = low_pass_simple( fm->signal2, fm->signal2_len,
-				       fm->post_downsample);
-  if (fm->output_rate > 0) 
-    low_pass_real(fm);
-  if (fm->deemph) 
-    deemph_filter(fm);
-  if (fm->dc_block) 
-    dc_block_filter(fm);
-  
-  /* ignore under runs for now */
 
-  //fwrite(fm->signal2, 2, fm->signal2_len, fm->file);
-  if (hop) {
-    if (debug_hop) fprintf(stderr,"Hopping freq!\n");
-    freq_next = (fm->freq_now + 1) % fm->freq_len;
-    optimal_settings(fm, freq_next, 1);
-    current_freq = fm->freqs[freq_next];
-    fm->squelch_hits = fm->conseq_squelch + 1;  /* hair trigger */
-    /* wait for settling and flush buffer */
-    //usleep(5000);
-    usleep(1000);
-    rtlsdr_read_sync(dev, &dump, BUFFER_DUMP, &n_read);
-    if (n_read != BUFFER_DUMP) {
-      fprintf(stderr, "Error: bad retune.\n");}
-  } else
-    am_demod(fm);
-  
+  fflush(stdout);
+  return 0;
 }
 
 
-void acars_decode(struct fm_state *fm) {
+// Start the writer, and stop it once everything queued is printed.
+// Each device's stream starts, as far as the time on its messages
+// goes, when out_start() is called for it.
 
-  int16_t* sample = fm->signal2;
+static void
+out_start( receiver* rx ) {
 
-  for( int ind = 0; ind < fm->signal2_len; ++ind ) {
-    if( _getbit( sample[ind], rl )) {
-      if( ++nbitl >= 8 ) {
-	do { 
+  rx->out_rate  = double( rx->fm->downsample ) * rx->fm->sample_rate;
+  rx->out_epoch = _now();
 
-	  msg_t     msgl;
-	  const int bitsConsumed = _getmesg( rl, &msgl );
-	  
-	  if( bitsConsumed == -1 ) {
+}
 
-	    print_mesg( &msgl );
-	    nbitl  = 0;
+static void
+out_start( void ) {
 
-	  } else
-	    nbitl -= bitsConsumed;
+  out_done = false;
+
+  pthread_cond_init( &out_ready, NULL );
+  pthread_mutex_init( &out_mutex, NULL );
+  pthread_create( &out_thread, NULL, out_thread_fn, NULL );
 
-	} while( nbitl >= 8 );
-      }
-    }
-  }
 }
 
+static void
+out_stop( void ) {
 
-void
-rtlsdr_callback(unsigned char *buf, uint32_t len, void *ctx)
-{
-  struct fm_state *fm2 = (struct fm_state *)ctx;
-  if (do_exit) {
-    return;}
-  if (!ctx) {
-    return;}
-  pthread_rwlock_wrlock(&data_rw);
-  memcpy(fm2->buf, buf, len);
-  fm2->buf_len = len;
-  pthread_rwlock_unlock(&data_rw);
-  safe_cond_signal(&data_ready, &data_mutex);
-  /* single threaded uses 25% less CPU? */
-  /* full_demod(fm2); */
-}
+  out_done = true;
+  safe_cond_signal(&out_ready, &out_mutex);
+  pthread_join( out_thread, NULL );
 
+  pthread_cond_destroy( &out_ready );
+  pthread_mutex_destroy( &out_mutex );
+
+  for( auto& rx : receivers )
+    if( rx->out_overruns )
+      fprintf( stderr, "%lu message(s) from device %d dropped because the "
+	       "output fell behind.\n", rx->out_overruns, rx->index );
 
-static void sync_read(unsigned char *buf, uint32_t len, struct fm_state *fm)
-{
-  int r, n_read;
-  r = rtlsdr_read_sync(dev, buf, len, &n_read);
-  if (r < 0) {
-    fprintf(stderr, "WARNING: sync read failed.\n");
-    return;
-  }
-  pthread_rwlock_wrlock(&data_rw);
-  memcpy(fm->buf, buf, len);
-  fm->buf_len = len;
-  pthread_rwlock_unlock(&data_rw);
-  safe_cond_signal(&data_ready, &data_mutex);
-  //full_demod(fm);
 }
 
 
 static void *demod_thread_fn(void *arg)
 {
-  struct fm_state *fm2 = (struct fm_state *)arg;
+  receiver *rx = (receiver *)arg;
+  struct fm_state *fm2 = rx->fm.get();
   // So that DBs will be loaded, we'd better use a mutex here
   pthread_mutex_lock(&dataset_mutex);
   pthread_mutex_unlock(&dataset_mutex);
 
   while (!do_exit) {
-    safe_cond_wait(&data_ready, &data_mutex);
+
+    _check_profile_dump();
+
+    iq_block* b = rx->iq_ring.read_slot();
+
+    // Sleep only when there is nothing to do. The ring is checked
+    // again under the mutex so a push that lands between the check
+    // above and the wait below can't be missed.
+
+    if( b == nullptr ) {
+
+      pthread_mutex_lock( &rx->data_mutex );
+      while( !do_exit && rx->iq_ring.empty())
+	pthread_cond_wait( &rx->data_ready, &rx->data_mutex );
+      pthread_mutex_unlock( &rx->data_mutex );
+
+      continue;
+    }
+
+    const uint64_t t0 = _ns();
+
+    rx->stage[0].takes += 1;
+    rx->stage[0].depth += rx->iq_ring.size() - 1;
+
+    // A block read before the last hop was done is from the old
+    // channel and one read while the tuner settled is noise.
+
+    if (b->tune != fm2->tune_gen || b->settle == b->len) {
+      rx->tune_skipped += (b->tune != fm2->tune_gen);
+      rx->iq_ring.pop();
+      rx->stage[0].busy_ns += _ns() - t0;
+      continue;
+    }
+
+    fm2->buf          = b->data.get() + b->settle;
+    fm2->buf_len      = b->len - b->settle;
+    fm2->sample_clock = b->sample + b->len / 2;
+
     full_demod(fm2);
-    acars_decode(fm2);
+
+    fm2->buf = NULL;
+    b->data.check();
+    rx->iq_ring.pop();
+
+    decode_block(rx);
+
+    rx->stage[0].busy_ns += _ns() - t0;
     if (fm2->exit_flag) {
       do_exit = 1;
       //rtlsdr_cancel_async(dev);
@@ -2343,6 +2198,27 @@ static void *demod_thread_fn(void *arg)
 }
 
 
+// Read a device until it's time to stop, and then wake its
+// demodulator so it sees that too.
+
+static void *read_thread_fn(void *arg)
+{
+  receiver *rx = (receiver *)arg;
+  Buffer<uint8_t> scratch( ACTUAL_BUF_LENGTH );
+
+  while (!do_exit) {
+
+    scratch.check();
+
+    sync_read( rx, scratch, ACTUAL_BUF_LENGTH );
+
+  }
+
+  safe_cond_signal(&rx->data_ready, &rx->data_mutex);
+  return 0;
+}
+
+
 double atofs(char *f)
 /* standard suffixes */
 {
@@ -2392,7 +2268,7 @@ void frequency_range(struct fm_state *fm, char *arg)
 }
 
 
-int nearest_gain(int target_gain)
+int nearest_gain(rtlsdr_dev_t *dev, int target_gain)
 {
   int err1, err2, count, close_gain;
 
@@ -2427,6 +2303,8 @@ void fm_init(struct fm_state *fm)
   fm->freq_len = 0;
   fm->edge = 0;
   fm->fir_enable = 0;
+  fm->fir_taps = FIR_TAPS;
+  fm->decimation = 0;
   fm->prev_index = 0;
   fm->post_downsample = 1;  // once this works, default = 4
   fm->custom_atan = 0;
@@ -2438,7 +2316,246 @@ void fm_init(struct fm_state *fm)
   fm->now_lpr = 0;
   fm->dc_block = 0;
   fm->dc_avg = 0;
+  fm->deemph_avg = 0;
+  fm->decoder = NULL;
+  fm->gate_db = GATE_OPEN_DB;
+  fm->wb_center = 0;
+  fm->buf = NULL;
+  fm->buf_len = 0;
+  fm->sample_clock = 0;
+  fm->dev = NULL;
+  fm->tune_gen = 0;
+  fm->tune_ask = 0;
+
+}
+
+
+// The receive chain for the benchmarks: the front end a replay of one
+// channel would have, with the command line's options, and a decoder
+// of its own, fresh for every call.
+
+static std::unique_ptr<fm_state>
+bench_front_end(const struct fm_state *opts, int fir_enable)
+{
+  std::unique_ptr<fm_state> fm(new fm_state);
+
+  fm_init(fm.get());
+  fm->fir_enable = fir_enable;
+  fm->fir_taps = opts->fir_taps;
+  fm->decimation = opts->decimation;
+  fm->post_downsample = opts->post_downsample;
+  fm->sample_rate *= opts->post_downsample;
+  fm->freqs[0] = 0;
+  fm->freq_len = 1;
+
+  optimal_settings(fm.get(), 0, 1);  /* hopping, so it's quiet */
+  build_fir(fm.get());
+
+  return fm;
+}
+
+static void
+bench_decode(const struct fm_state *opts, int crc_bits, bool gated,
+	     const std::vector<uint8_t>& iq, std::vector<msg_t>& msgs)
+{
+  std::unique_ptr<fm_state> fm = bench_front_end(opts, opts->fir_enable);
+  AcarsDecoder decoder([&msgs](msg_t& msg) { msgs.push_back(msg); });
+  SquelchGate gate(decoder, opts->gate_db);
+
+  gated = gated && (opts->gate_db > 0);
+
+  const size_t block = lcm_post[fm->post_downsample] * DEFAULT_BUF_LENGTH;
+  Buffer<uint8_t> scratch(block);
+
+  decoder.crc_correct(crc_bits);
+
+  for (size_t off = 0; off + 8 <= iq.size(); off += block) {
+
+    const size_t n = (std::min(block, iq.size() - off) & ~size_t(7));
+
+    memcpy(scratch.get(), iq.data() + off, n);
+    fm->buf = scratch.get();
+    fm->buf_len = uint32_t(n);
+
+    full_demod(fm.get());
+    if (gated)
+      gate.push(fm->signal2, fm->signal2_len);
+    else
+      decoder.push(fm->signal2, fm->signal2_len);
+  }
+}
+
+// Wideband mode's chain for the benchmarks: a channelizer with a
+// channel a quarter of the rate either side of the tuned frequency,
+// where the Modulator puts its signal, and a decoder (and gate) of
+// its own for each, fresh for every call.
+
+static void
+bench_wideband(const struct fm_state *opts, int crc_bits, bool gated,
+	       const std::vector<uint8_t>& iq, std::vector<msg_t>& msgs)
+{
+  const double rate = double(WIDEBAND_DECIMATION_MIN) * uint32_t(Fe);
+  const size_t block = DEFAULT_BUF_LENGTH;
+
+  Channelizer channelizer(rate, WIDEBAND_DECIMATION_MIN,
+			  { -0.25 * rate, 0.25 * rate }, block);
+  std::vector<std::unique_ptr<AcarsDecoder>> decoders;
+  std::vector<std::unique_ptr<SquelchGate>> gates;
+
+  gated = gated && (opts->gate_db > 0);
+
+  for (size_t i = 0; i < channelizer.channels(); ++i) {
+    decoders.emplace_back
+      (new AcarsDecoder([&msgs](msg_t& msg) { msgs.push_back(msg); }));
+    decoders.back()->crc_correct(crc_bits);
+    gates.emplace_back(new SquelchGate(*decoders.back(), opts->gate_db));
+  }
+
+  for (size_t off = 0; off + 8 <= iq.size(); off += block) {
+
+    channelizer.push(iq.data() + off,
+		     std::min(block, iq.size() - off) & ~size_t(7));
+
+    for (size_t i = 0; i < channelizer.channels(); ++i)
+      if (gated)
+	gates[i]->push(channelizer.output(i), channelizer.output_len());
+      else
+	decoders[i]->push(channelizer.output(i), channelizer.output_len());
+  }
+}
+
+static void
+bench_envelope(const struct fm_state *opts, bool fused,
+	       const std::vector<uint8_t>& iq, std::vector<int16_t>& out)
+{
+  std::unique_ptr<fm_state> fm = bench_front_end(opts, 0);
+
+  const size_t block = lcm_post[fm->post_downsample] * DEFAULT_BUF_LENGTH;
+  Buffer<uint8_t> scratch(block);
+
+  for (size_t off = 0; off + 8 <= iq.size(); off += block) {
+
+    const size_t n = (std::min(block, iq.size() - off) & ~size_t(7));
+
+    memcpy(scratch.get(), iq.data() + off, n);
+
+    if (fused)
+      fm->signal2_len = int(am_front_end(scratch.get(), n, fm->downsample,
+					 fm->output_scale, fm->now_r, fm->now_j,
+					 fm->prev_index, fm->signal2));
+    else {
+      rotate_90(scratch.get(), uint32_t(n));
+      low_pass(fm.get(), scratch.get(), uint32_t(n));
+      am_demod(fm.get());
+    }
 
+    out.insert(out.end(), fm->signal2, fm->signal2 + fm->signal2_len);
+  }
+}
+
+
+
+// One device's state from the command line's: its channels are
+// opts->freqs[first, last) and the rest of the options are everyone's.
+
+static void
+fm_group(const struct fm_state *opts, int first, int last, struct fm_state *fm)
+{
+  fm_init(fm);
+  fm->sample_rate = opts->sample_rate;
+  fm->squelch_level = opts->squelch_level;
+  fm->conseq_squelch = opts->conseq_squelch;
+  fm->terminate_on_squelch = (last - first > 1) ? 0 : opts->terminate_on_squelch;
+  fm->post_downsample = opts->post_downsample;
+  fm->fir_enable = opts->fir_enable;
+  fm->fir_taps = opts->fir_taps;
+  fm->decimation = opts->decimation;
+  fm->deemph = opts->deemph;
+  fm->deemph_a = opts->deemph_a;
+  fm->output_rate = opts->output_rate;
+  fm->gate_db = opts->gate_db;
+  for (int i = first; i < last; i++)
+    fm->freqs[fm->freq_len++] = opts->freqs[i];
+}
+
+
+// A device's decoders: one for a single channel or for scanning, or
+// one per channel in wideband mode, fed by the channelizer. The
+// messages are queued for the writer on the device's ring.
+
+static void
+receiver_init(receiver *rx, int crc_bits, int wideband)
+{
+  struct fm_state *fm = rx->fm.get();
+
+  for (size_t i = 0; i < rx->iq_ring.capacity(); ++i) {
+    rx->iq_ring[i].data.set(ACTUAL_BUF_LENGTH);
+    rx->iq_ring[i].len = 0;
+  }
+
+  rx->decoder.reset(new AcarsDecoder([rx](msg_t& msg) {
+	msg.freq = rx->msg_freq;
+	queue_mesg(rx, msg, rx->msg_sample);
+      }, verbose));
+
+  rx->decoder->crc_correct(crc_bits);
+  fm->decoder = rx->decoder.get();
+
+  // Scanning has its own squelch (-l) and one decoder for every
+  // channel, so only a single channel or wideband gets a gate.
+
+  if (fm->gate_db > 0 && fm->freq_len == 1 && !wideband)
+    fm->gate.reset(new SquelchGate(*rx->decoder, fm->gate_db));
+
+  // Scanning goes where it has heard traffic, unless it's asked to go
+  // round the channels in order.
+
+  if (fm->freq_len > 1 && !wideband && !round_robin)
+    fm->scan.reset(new ScanScheduler(fm->freq_len));
+
+  // In wideband mode every channel gets its own decoder, fed by the
+  // channelizer, and the single decoder above goes unused.
+
+  if (!wideband)
+    return;
+
+  if (!wideband_settings(fm, 0)) {
+    fprintf(stderr, "Device %d's channels don't fit in %0.3f MHz.\n",
+	    rx->index, WIDEBAND_DECIMATION_MAX * fm->sample_rate / 1e6);
+    exit(1);
+  }
+
+  std::vector<double> offsets;
+
+  for (int i = 0; i < fm->freq_len; ++i) {
+
+    const uint32_t f = fm->freqs[i];
+
+    offsets.push_back(double(f) - double(fm->wb_center));
+    fm->wb_held.emplace_back();
+    fm->wb_decoders.emplace_back
+      (new AcarsDecoder([f, fm, i](msg_t& msg) {
+	  msg.freq = f;
+	  fm->wb_held[i].push_back(msg);
+	}, verbose));
+    fm->wb_decoders.back()->crc_correct(crc_bits);
+    if (fm->gate_db > 0)
+      fm->wb_gates.emplace_back
+	(new SquelchGate(*fm->wb_decoders.back(), fm->gate_db));
+
+    fm->wb_tasks.push_back([fm, i] {
+	if (fm->wb_gates.empty())
+	  fm->wb_decoders[i]->push(fm->channelizer->output(i),
+				   fm->channelizer->output_len());
+	else
+	  fm->wb_gates[i]->push(fm->channelizer->output(i),
+				fm->channelizer->output_len());
+      });
+  }
+
+  fm->channelizer.reset
+    (new Channelizer(double(fm->downsample) * fm->sample_rate,
+		     fm->downsample, offsets, ACTUAL_BUF_LENGTH));
 }
 
 
@@ -2450,9 +2567,14 @@ main( int argc, char** argv ) {
 #endif
   struct fm_state fm; 
   char *filename = NULL;
-  int r, opt, wb_mode = 0;
+  const char *replay = NULL;
+  const char *bench = NULL;
+  const char *compile = NULL;
+  const char *synth = NULL;
+  const char *image = "datasets/acars.img";
+  int r, opt, wb_mode = 0, wideband = 0, piped = 0, crc_bits = 1;
   int gain = AUTO_GAIN; // tenths of a dB
-  uint32_t dev_index = 0;
+  std::vector<std::pair<int, int>> groups;  /* -d and its first -f */
   int device_count;
   int ppm_error = 0;
 
@@ -2466,17 +2588,61 @@ main( int argc, char** argv ) {
   n_omp = (( omp_get_max_threads() * 5 ) / 8 );
   n_omp = ( std::max( n_omp, 2 ));
     
-  pthread_cond_init(&data_ready, NULL);
-  pthread_rwlock_init(&data_rw, NULL);
-  pthread_mutex_init(&data_mutex, NULL);
   pthread_mutex_init(&dataset_mutex, NULL);
 
   fm.sample_rate = uint32_t(Fe);
 
-  while ((opt = getopt(argc, argv, "d:f:g:l:o:t:p:Frhv")) != -1) {
+  while ((opt = getopt(argc, argv, "B:C:D:G:T:X:c:d:e:f:g:i:l:o:t:p:q:FPRSWrhv")) != -1) {
     switch (opt) {
+    case 'B':
+      bench = optarg;
+      break;
+    case 'C':
+      compile = optarg;
+      break;
+    case 'D':
+      image = optarg;
+      break;
+    case 'G':
+      synth = optarg;
+      break;
+    case 'T':
+      fm.fir_taps = atoi(optarg);
+      if (fm.fir_taps < 1 || fm.fir_taps > 256) {
+	fprintf(stderr, "FIR taps per phase must be between 1 and 256\n");
+	exit(1);
+      }
+      break;
+    case 'X':
+      fm.decimation = atoi(optarg);
+      if (fm.decimation < 2 || fm.decimation > MAXIMUM_DECIMATION) {
+	fprintf(stderr, "Decimation must be between 2 and %i\n", MAXIMUM_DECIMATION);
+	exit(1);
+      }
+      break;
+    case 'c': {
+      bool ok = false;
+      if (!strcmp(optarg, "table"))
+	ok = crc_engine(CrcEngine::TABLE);
+      else if (!strcmp(optarg, "slice8"))
+	ok = crc_engine(CrcEngine::SLICE8);
+      else if (!strcmp(optarg, "clmul"))
+	ok = crc_engine(CrcEngine::CLMUL);
+      if (!ok) {
+	fprintf(stderr, "CRC engine %s is unknown or not on this CPU\n", optarg);
+	exit(1);
+      }
+      break;
+    }
     case 'd':
-      dev_index = atoi(optarg);
+      groups.push_back(std::make_pair(atoi(optarg), fm.freq_len));
+      break;
+    case 'e':
+      crc_bits = atoi(optarg);
+      if (crc_bits < 0 || crc_bits > 2) {
+	fprintf(stderr, "Bit errors to correct must be between 0 and 2\n");
+	exit(1);
+      }
       break;
     case 'f':
       if (fm.freq_len >= FREQUENCIES_LIMIT) 
@@ -2491,6 +2657,9 @@ main( int argc, char** argv ) {
     case 'g':
       gain = (int)(atof(optarg) * 10);
       break;
+    case 'i':
+      replay = optarg;
+      break;
     case 'l':
       fm.squelch_level = (int)atof(optarg);
       break;
@@ -2512,9 +2681,28 @@ main( int argc, char** argv ) {
     case 'p':
       ppm_error = atoi(optarg);
       break;
+    case 'q':
+      fm.gate_db = atof(optarg);
+      if (fm.gate_db < 0) {
+	fprintf(stderr, "The gate can't be under the noise floor\n");
+	exit(1);
+      }
+      break;
     case 'F':
       fm.fir_enable = 1;
       break;
+    case 'P':
+      profile_enable(true);
+      break;
+    case 'R':
+      round_robin = 1;
+      break;
+    case 'S':
+      piped = 1;
+      break;
+    case 'W':
+      wideband = 1;
+      break;
     case 'v':
       ++verbose;
       break;
@@ -2560,9 +2748,60 @@ main( int argc, char** argv ) {
     
   }
   
+  if (bench || synth) {
+
+    Receiver rx;
+
+    std::unique_ptr<fm_state> proto =
+      bench_front_end(&fm, fm.fir_enable);
+
+    rx.rate = double(proto->downsample) * proto->sample_rate;
+    rx.taps = fm.fir_taps;
+    rx.decode = [&](const std::vector<uint8_t>& iq, bool gated,
+		    std::vector<msg_t>& msgs) {
+      bench_decode(&fm, crc_bits, gated, iq, msgs);
+    };
+    rx.wb_rate = double(WIDEBAND_DECIMATION_MIN) * uint32_t(Fe);
+    rx.wideband = [&](const std::vector<uint8_t>& iq, bool gated,
+		      std::vector<msg_t>& msgs) {
+      bench_wideband(&fm, crc_bits, gated, iq, msgs);
+    };
+    rx.envelope = [&](const std::vector<uint8_t>& iq, bool fused,
+		      std::vector<int16_t>& out) {
+      bench_envelope(&fm, fused, iq, out);
+    };
+
+    if (bench)
+      return run_bench(bench, verbose, rx);
+
+    if (!synth_recording(synth, rx.rate, 20.0, 10, 1)) {
+      fprintf(stderr, "Can't write %s: %s\n", synth, strerror(errno));
+      return 1;
+    }
+    printf("Wrote %s: 10 messages at 20 dB, %0.0f Hz.\n", synth, rx.rate);
+    return 0;
+  }
+
+  if (compile) {
+    dataset.load_text("datasets");
+    if (!dataset.save(compile)) {
+      fprintf(stderr, "Can't write %s: %s\n", compile, strerror(errno));
+      return 1;
+    }
+    printf("Wrote %s.\n", compile);
+    return 0;
+  }
+
   /* quadruple sample_rate to limit to Δθ to ±π/2 */
   fm.sample_rate *= fm.post_downsample;
 
+  // A recording doesn't need to be tuned, so any frequency will do.
+
+  if (fm.freq_len == 0 && replay) {
+    fm.freqs[0] = 0;
+    fm.freq_len = 1;
+  }
+
   if (fm.freq_len == 0) {
     fprintf(stderr, "Please specify a frequency.\n");
     exit(1);
@@ -2573,23 +2812,121 @@ main( int argc, char** argv ) {
     exit(1);
   }
 
-  if (fm.freq_len > 1 && fm.squelch_level == 0) {
-    fprintf(stderr, "Please specify a squelch level.  Required for scanning multiple frequencies.\n");
+  if (wideband && fm.post_downsample != 1) {
+    fprintf(stderr, "Oversampling isn't supported in wideband mode.\n");
+    exit(1);
+  }
+
+  // Wideband mode's channels are already spread over the pool.
+
+  if (wideband && piped) {
+    fprintf(stderr, "The pipeline (-S) isn't supported in wideband mode.\n");
     exit(1);
   }
 
-  if (fm.freq_len > 1) 
-    fm.terminate_on_squelch = 0;
+  if (fm.deemph) 
+    fm.deemph_a = (int)round(1.0/((1.0-exp(-1.0/(fm.output_rate * 75e-6)))));
 
   if (argc <= optind) 
     filename = "-";
   else 
     filename = argv[optind];
 
-  ACTUAL_BUF_LENGTH = lcm_post[fm.post_downsample] * DEFAULT_BUF_LENGTH;
+  ACTUAL_BUF_LENGTH = wideband ?
+    WIDEBAND_BUF_LENGTH : lcm_post[fm.post_downsample] * DEFAULT_BUF_LENGTH;
 
   buffer.set( ACTUAL_BUF_LENGTH );
-  
+
+  // Every -d starts a device's channels and any -f before the first
+  // one are the first device's. A recording is one stream, so all of
+  // its channels are decoded together.
+
+  if (groups.empty())
+    groups.push_back(std::make_pair(0, 0));
+  if (replay)
+    groups.resize(1);
+  groups[0].second = 0;
+
+  for (size_t g = 0; g < groups.size(); g++) {
+
+    const int first = groups[g].second;
+    const int last = (g + 1 < groups.size()) ? groups[g + 1].second : fm.freq_len;
+
+    for (size_t h = 0; h < g; h++)
+      if (groups[h].first == groups[g].first) {
+	fprintf(stderr, "Device %d is given more than once.\n", groups[g].first);
+	exit(1);
+      }
+
+    if (first == last) {
+      fprintf(stderr, "Please specify a frequency for device %d.\n",
+	      groups[g].first);
+      exit(1);
+    }
+
+    if (last - first > 1 && fm.squelch_level == 0 && !wideband) {
+      fprintf(stderr, "Please specify a squelch level.  Required for scanning multiple frequencies.\n");
+      exit(1);
+    }
+
+    receivers.emplace_back(new receiver);
+    receivers.back()->index = groups[g].first;
+    receivers.back()->fm.reset(new fm_state);
+    fm_group(&fm, first, last, receivers.back()->fm.get());
+    receiver_init(receivers.back().get(), crc_bits, wideband);
+    receivers.back()->piped = piped;
+  }
+
+  if (wideband && fm.freq_len > 1)
+    pool.reset(new WorkPool(n_omp));
+
+#ifndef _WIN32
+  sigact.sa_handler = sighandler;
+  sigemptyset(&sigact.sa_mask);
+  sigact.sa_flags = 0;
+  sigaction(SIGINT, &sigact, NULL);
+  sigaction(SIGTERM, &sigact, NULL);
+  sigaction(SIGQUIT, &sigact, NULL);
+  sigaction(SIGPIPE, &sigact, NULL);
+  if (profile_enabled()) {
+    sigact.sa_handler = profile_sighandler;
+    sigaction(SIGUSR1, &sigact, NULL);
+  }
+#else
+  SetConsoleCtrlHandler( (PHANDLER_ROUTINE) sighandler, TRUE );
+#endif
+
+  if( replay ) {
+
+    receiver* rx = receivers[0].get();
+
+    if( wideband )
+      wideband_settings(rx->fm.get(), 1);
+    else {
+      optimal_settings(rx->fm.get(), 0, 0);
+      build_fir(rx->fm.get());
+    }
+
+    load_datasets(image);
+
+    // A recording can wait for the writer; nothing is lost by it.
+
+    out_wait = true;
+    out_start( rx );
+    out_start();
+    if( rx->piped )
+      pipe_start( rx );
+
+    r = replay_file( rx, replay, buffer );
+
+    out_stop();
+
+    if( profile_enabled())
+      profile_dump( stderr );
+
+    return r;
+  }
+
   device_count = rtlsdr_get_device_count();
   if (!device_count) {
     fprintf(stderr, "No supported devices found.\n");
@@ -2614,55 +2951,62 @@ main( int argc, char** argv ) {
     serial.check();
     
   }
-  fprintf(stderr, "Using device %d: %s\n",
-	  dev_index, rtlsdr_get_device_name(dev_index));
 
-  r = rtlsdr_open(&dev, dev_index);
-  if (r < 0) {
-    fprintf(stderr, "Failed to open rtlsdr device #%d.\n", dev_index);
-    exit(1);
-  }
-#ifndef _WIN32
-  sigact.sa_handler = sighandler;
-  sigemptyset(&sigact.sa_mask);
-  sigact.sa_flags = 0;
-  sigaction(SIGINT, &sigact, NULL);
-  sigaction(SIGTERM, &sigact, NULL);
-  sigaction(SIGQUIT, &sigact, NULL);
-  sigaction(SIGPIPE, &sigact, NULL);
-#else
-  SetConsoleCtrlHandler( (PHANDLER_ROUTINE) sighandler, TRUE );
-#endif
+  for (auto& rx : receivers) {
 
-  /* WBFM is special */
-  // I really should loop over everything
-  // but you are more wrong for scanning broadcast FM
+    struct fm_state *dfm = rx->fm.get();
+    int dgain = gain;
 
-  if (wb_mode) 
-    fm.freqs[0] += 16000;
+    if (rx->index < 0 || rx->index >= device_count) {
+      fprintf(stderr, "There is no device #%d.\n", rx->index);
+      exit(1);
+    }
 
-  if (fm.deemph) 
-    fm.deemph_a = (int)round(1.0/((1.0-exp(-1.0/(fm.output_rate * 75e-6)))));
+    fprintf(stderr, "Using device %d: %s\n",
+	    rx->index, rtlsdr_get_device_name(rx->index));
 
-  optimal_settings(&fm, 0, 0);
-  build_fir(&fm);
+    r = rtlsdr_open(&dfm->dev, rx->index);
+    if (r < 0) {
+      fprintf(stderr, "Failed to open rtlsdr device #%d.\n", rx->index);
+      exit(1);
+    }
 
-  /* Set the tuner gain */
-  if (gain == AUTO_GAIN) {
-    r = rtlsdr_set_tuner_gain_mode(dev, 0);
-  } else {
-    r = rtlsdr_set_tuner_gain_mode(dev, 1);
-    gain = nearest_gain(gain);
-    r = rtlsdr_set_tuner_gain(dev, gain);
+    /* WBFM is special */
+    // I really should loop over everything
+    // but you are more wrong for scanning broadcast FM
+
+    if (wb_mode) 
+      dfm->freqs[0] += 16000;
+
+    if (wideband)
+      wideband_settings(dfm, 1);
+    else {
+      optimal_settings(dfm, 0, 0);
+      build_fir(dfm);
+    }
+
+    /* Set the tuner gain */
+    if (dgain == AUTO_GAIN) {
+      r = rtlsdr_set_tuner_gain_mode(dfm->dev, 0);
+    } else {
+      r = rtlsdr_set_tuner_gain_mode(dfm->dev, 1);
+      dgain = nearest_gain(dfm->dev, dgain);
+      r = rtlsdr_set_tuner_gain(dfm->dev, dgain);
+    }
+    if (r != 0) 
+      fprintf(stderr, "WARNING: Failed to set tuner gain.\n");
+    else
+      if (dgain == AUTO_GAIN) 
+	fprintf(stderr, "Tuner gain set to automatic.\n");
+      else 
+	fprintf(stderr, "Tuner gain set to %0.2f dB.\n", dgain/10.0);
+    r = rtlsdr_set_freq_correction(dfm->dev, ppm_error);
+
+    /* Reset endpoint before we start reading from it (mandatory) */
+    r = rtlsdr_reset_buffer(dfm->dev);
+    if (r < 0) {
+      fprintf(stderr, "WARNING: Failed to reset buffers.\n");}
   }
-  if (r != 0) 
-    fprintf(stderr, "WARNING: Failed to set tuner gain.\n");
-  else
-    if (gain == AUTO_GAIN) 
-      fprintf(stderr, "Tuner gain set to automatic.\n");
-    else 
-      fprintf(stderr, "Tuner gain set to %0.2f dB.\n", gain/10.0);
-  r = rtlsdr_set_freq_correction(dev, ppm_error);
 
   if (strcmp(filename, "-") == 0) { /* Write samples to stdout */
     fm.file = stdout;
@@ -2680,56 +3024,74 @@ main( int argc, char** argv ) {
     */
   }
 
-  /* Reset endpoint before we start reading from it (mandatory) */
-  r = rtlsdr_reset_buffer(dev);
-  if (r < 0) {
-    fprintf(stderr, "WARNING: Failed to reset buffers.\n");}
+  // Each device gets a reader and a demodulator of its own and they
+  // all share the writer, which is the only thing that touches the
+  // datasets.
+
   pthread_mutex_lock(&dataset_mutex);
-  pthread_create(&demod_thread, NULL, demod_thread_fn, (void *)(&fm));
+  out_start();
+  for (auto& rx : receivers) {
+    pthread_cond_init(&rx->data_ready, NULL);
+    pthread_mutex_init(&rx->data_mutex, NULL);
+    out_start(rx.get());
+    if (rx->piped)
+      pipe_start(rx.get());
+    pthread_create(&rx->demod_thread, NULL, demod_thread_fn, (void *)(rx.get()));
+    pthread_create(&rx->read_thread, NULL, read_thread_fn, (void *)(rx.get()));
+  }
   /*rtlsdr_read_async(dev, rtlsdr_callback, (void *)(&fm),
     DEFAULT_ASYNC_BUF_NUMBER,
     ACTUAL_BUF_LENGTH);*/
   fprintf(stderr, "\n");
-  load_aircrafts();
-  load_airports();
-  load_flights();
-  load_message_labels();
-  
-  init_bits();
-  _reset_bit_state_machine();
-  _reset_message_state_machine();
+  load_datasets(image);
   
   printf("Listening for ACARS traffic...\n");
   fprintf(stderr, "\n");
   pthread_mutex_unlock(&dataset_mutex);
 
-  while (!do_exit) {
+  for (auto& rx : receivers)
+    pthread_join(rx->read_thread, NULL);
+
+  fprintf(stderr, "\nUser cancel, exiting...\n");
+  
+  //rtlsdr_cancel_async(dev);
+  for (auto& rx : receivers) {
+    safe_cond_signal(&rx->data_ready, &rx->data_mutex);
+    pthread_join(rx->demod_thread, NULL);
+    if (rx->piped)
+      pipe_stop(rx.get());
+  }
+  out_stop();
+
+  for (auto& rx : receivers) {
 
-    buffer.check();
+    pthread_cond_destroy(&rx->data_ready);
+    pthread_mutex_destroy(&rx->data_mutex);
 
-    sync_read( buffer.get(), ACTUAL_BUF_LENGTH, &fm);
+    if( rx->iq_overruns )
+      fprintf( stderr, "%lu IQ block(s) from device %d dropped because "
+	       "the demodulator fell behind.\n", rx->iq_overruns, rx->index );
 
+    if( rx->fm->tune_gen )
+      fprintf( stderr, "Device %d hopped %u time(s); %lu block(s) read "
+	       "before a hop were skipped.\n", rx->index, rx->fm->tune_gen,
+	       rx->tune_skipped );
+
+    if( rx->fm->scan )
+      scan_report( rx.get());
   }
-  if (do_exit) {
-    fprintf(stderr, "\nUser cancel, exiting...\n");}
-  else
-    fprintf(stderr, "\nLibrary error %d, exiting...\n", r);
-  
-  //rtlsdr_cancel_async(dev);
-  safe_cond_signal(&data_ready, &data_mutex);
-  pthread_join(demod_thread, NULL);
 
-  pthread_cond_destroy(&data_ready);
-  pthread_rwlock_destroy(&data_rw);
-  pthread_mutex_destroy(&data_mutex);
+  if( profile_enabled())
+    profile_dump( stderr );
 
   /*
     if (fm.file != stdout) {
     fclose(fm.file);}
   */
-  rtlsdr_close(dev);
+  for (auto& rx : receivers)
+    rtlsdr_close(rx->fm->dev);
 
-  return r >= 0 ? r : -r;
+  return 0;
 }
 
 
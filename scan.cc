@@ -0,0 +1,216 @@
+/* -*- c++ -*- */
+
+/*
+ * Copyright 2016 Dennis Glatting
+ *
+ *
+ * Which channel a single tuner scans next.
+ *
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ *
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+#include <acars/scan.h>
+
+
+static const std::string my_ident = "$Id: scan.cc,v 1.1 2016/07/23 18:40:11 dennisg Exp $";
+
+
+namespace gr {
+  namespace acars {
+
+    // What a channel that hasn't been heard from is taken to have: a
+    // burst every 100 s, but only as much as two seconds' listening
+    // says. A quiet channel is visited for a block at a time, so it
+    // takes a while to find out it's quiet; a stronger prior keeps
+    // the dead channels' shares up for much longer. Without one, a
+    // burst on a channel listened to for a moment would give it
+    // nearly all the visits.
+
+    static const double prior_bursts = 0.02;
+    static const double prior_heard  = 2.0;
+
+    // How much more a channel that just had a burst is expected to
+    // have, fading over SCAN_RECENT.
+
+    static const double recent_boost = 3.0;
+
+    ScanScheduler::ScanScheduler( size_t the_channels, double the_floor,
+				  double the_memory )
+      : my_channels( std::max( the_channels, size_t( 1 ))),
+	my_floor( std::min( std::max( the_floor, 0.0 ), 1.0 )),
+	my_memory( the_memory ), my_current( 0 ), my_carrier( false ),
+	my_hold( -1.0 ), my_refresh( 0.0 ), my_heard( false ) {
+
+      for( auto& c : my_channels ) {
+
+	c.stats   = Stats{ 0, 0, 0.0, 0.0, -1.0 };
+	c.when    = 0.0;
+	c.heard   = 0.0;
+	c.bursts  = 0.0;
+	c.airtime = 0.0;
+	c.share   = 1.0 / my_channels.size();
+	c.due     = 0.0;
+      }
+
+      my_channels[0].stats.visits = 1;
+
+    }
+
+    void
+    ScanScheduler::_fade( Channel& the_channel, double the_now ) const noexcept {
+
+      if( the_now <= the_channel.when )
+	return;
+
+      const double f = exp(( the_channel.when - the_now ) / my_memory );
+
+      the_channel.heard   *= f;
+      the_channel.bursts  *= f;
+      the_channel.airtime *= f;
+      the_channel.when     = the_now;
+
+    }
+
+    double
+    ScanScheduler::_weight( const Channel& the_channel,
+			    double the_now ) const noexcept {
+
+      double w = ( the_channel.bursts + prior_bursts ) /
+	( the_channel.heard + prior_heard );
+
+      if( the_channel.stats.last >= 0.0 )
+	w *= 1.0 + recent_boost *
+	  exp(( the_channel.stats.last - the_now ) / SCAN_RECENT );
+
+      return w;
+    }
+
+    void
+    ScanScheduler::observe( double the_now, double the_dt, bool the_carrier ) {
+
+      Channel& c = my_channels[ my_current ];
+
+      _fade( c, the_now );
+
+      c.heard       += the_dt;
+      c.stats.heard += the_dt;
+
+      if( the_carrier ) {
+
+	c.airtime       += the_dt;
+	c.stats.airtime += the_dt;
+
+	if( !my_carrier ) {
+	  c.bursts       += 1.0;
+	  c.stats.bursts += 1;
+	  c.stats.last    = the_now - the_dt;
+	  my_heard        = true;
+	}
+      }
+
+      my_carrier = the_carrier;
+
+    }
+
+    bool
+    ScanScheduler::leave( double the_now, bool the_in_message ) {
+
+      if( !the_in_message ) {
+	my_hold = -1.0;
+	return true;
+      }
+
+      if( my_hold < 0.0 )
+	my_hold = the_now;
+
+      const Stats& s    = my_channels[ my_current ].stats;
+      const double mean = s.bursts ? ( s.airtime / s.bursts ) : SCAN_HOLD_MIN;
+
+      return ( the_now - my_hold ) >=
+	std::min( std::max( 2.0 * mean, SCAN_HOLD_MIN ), SCAN_HOLD_MAX );
+    }
+
+    void
+    ScanScheduler::_shares( double the_now ) {
+
+      const size_t n = my_channels.size();
+
+      std::vector<double> w( n );
+      double              total = 0.0;
+
+      for( size_t i = 0; i < n; ++i ) {
+	_fade( my_channels[i], the_now );
+	w[i]   = _weight( my_channels[i], the_now );
+	total += w[i];
+      }
+
+      for( size_t i = 0; i < n; ++i )
+	my_channels[i].share =
+	  ( 1.0 - my_floor ) * w[i] / total + my_floor / n;
+
+      my_refresh = the_now;
+      my_heard   = false;
+
+    }
+
+    size_t
+    ScanScheduler::next( double the_now ) {
+
+      const size_t n = my_channels.size();
+
+      if( my_heard || (( the_now - my_refresh ) >= SCAN_REFRESH ))
+	_shares( the_now );
+
+      // The current channel was picked when it was due; it's due
+      // again one over its (new) share on from then. Ties go to the
+      // first channel after the current one, so channels with the
+      // same share are gone round in order.
+
+      Channel& c = my_channels[ my_current ];
+
+      c.due += 1.0 / c.share;
+
+      size_t pick = my_current;
+
+      for( size_t k = 1; k <= n; ++k ) {
+
+	const size_t i = ( my_current + k ) % n;
+
+	if( my_channels[i].due < my_channels[ pick ].due )
+	  pick = i;
+      }
+
+      if( pick != my_current ) {
+	my_current = pick;
+	my_carrier = false;
+	my_hold    = -1.0;
+	my_channels[ pick ].stats.visits++;
+      }
+
+      return my_current;
+    }
+
+  }
+}
+
+
+//  LocalWords:  ACARS